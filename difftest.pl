@@ -0,0 +1,200 @@
+#!/usr/bin/perl
+
+# Differential test of the simulator: runs generated traces through every
+# queue backend and stepping mode, and checks that each combination makes
+# exactly the same scheduling decisions as the reference (the first backend,
+# ticking through every time unit).  A trace that shows a difference is shrunk
+# to a minimal reproducer, saved as difftest-failure.csv.
+#
+# Usage: ./difftest.pl [traces] [seed]
+
+use strict;
+use warnings;
+
+my $traces = $ARGV[0] // 20;
+my $seed = $ARGV[1] // 1;
+
+# Extra simulator options selecting each implementation under test.  The
+# first entry of each list is the reference.
+my @backends = ('--queue list', '--queue keyed', '--queue ring', '--queue heap');
+my @steps = ('--step tick', '--step event');
+
+my @schemes = ('fcfs', 'sjf', 'psjf', 'pri', 'ppri', 'rr1', 'rr3', 'stride2', 'lottery2');
+my @cores = (1, 2, 4);
+my @overheads = ('', '--switch-cost 1 --migration-cost 1', '--affinity 2');
+# Points the run must stop at, whichever step it takes; each trace is checked with one of them in turn
+my @stops = ('', '--checkpoint difftest-checkpoint --checkpoint-at 3', '--checkpoint difftest-checkpoint --checkpoint-every 4',
+             '--fork psjf,rr2 --fork-at 5');
+
+my $trace_file = 'difftest-trace.csv';
+my $events_file = 'difftest-events.json';
+my $checkpoint_file = 'difftest-checkpoint';
+
+
+# A random trace with bursts of simultaneous arrivals, as [arrival, run time, priority, group] rows.  Half
+# of the traces spread their jobs over three tenant groups, the others keep every job in group 0.
+sub generate_trace {
+	my @jobs;
+	my $time = 0;
+	my $count = 1 + int(rand(24));
+	my $groups = rand() < 0.5 ? 3 : 1;
+
+	for (1 .. $count) {
+		$time += int(rand(3)) * int(rand(3));
+		push @jobs, [$time, 1 + int(rand(8)), int(rand(6)), int(rand($groups))];
+	}
+
+	return \@jobs;
+}
+
+# Writes a Group column only when some job is outside group 0
+sub write_trace {
+	my ($file, $jobs) = @_;
+	my $grouped = grep { $_->[3] } @$jobs;
+
+	open(my $out, '>', $file) or die "Unable to write $file: $!\n";
+	print $out "\"Arrival time\",\"Run time\",\"Priority\"", ($grouped ? ",\"Group\"" : ""), "\n";
+	print $out join(',', $grouped ? @$_ : @$_[0 .. 2]), "\n" for @$jobs;
+	close($out);
+}
+
+# Everything a run decided: every scheduling event followed by the final timing diagram and statistics, or by
+# the branches it forked into, and the last checkpoint it saved
+sub run {
+	my ($jobs, $options) = @_;
+
+	write_trace($trace_file, $jobs);
+	unlink($checkpoint_file);
+	my $output = `./simulator $options --stats --events $events_file $trace_file 2>&1`;
+	my $status = $? >> 8;
+	$output =~ s/.*(?=FINAL TIMING DIAGRAM:|FORKED AT TIME)//s;
+	if (open(my $checkpoint, '<:raw', $checkpoint_file)) {
+		local $/;
+		$output .= unpack('H*', <$checkpoint>) . "\n";
+		close($checkpoint);
+	}
+	# Latencies written by a build with INSTRUMENT=1 differ from run to run
+	$output =~ s/Scheduler instrumentation:.*\n(?:  \w+ +\d+ call\(s\).*\n    .*\n)*//g;
+
+	open(my $in, '<', $events_file) or return "exit $status\n$output";
+	local $/;
+	my $events = <$in>;
+	close($in);
+
+	return "exit $status\n$events$output";
+}
+
+# The final averages of a run, for the modes that print their results in a format of their own
+sub averages {
+	my ($jobs, $options) = @_;
+
+	write_trace($trace_file, $jobs);
+	my @averages = grep { /^Average (Waiting|Turnaround|Response) Time:/ } `./simulator $options $trace_file 2>&1`;
+	return join('', @averages[-3 .. -1]) if @averages >= 3;
+	return "exit " . ($? >> 8) . "\n";
+}
+
+sub differs {
+	my ($jobs, $reference, $variant) = @_;
+
+	return run($jobs, $reference) ne run($jobs, $variant);
+}
+
+# Shrinks a failing trace: drops jobs, then lowers run times, priorities and arrival gaps while the difference remains
+sub shrink {
+	my ($jobs, $reference, $variant) = @_;
+	my $progress = 1;
+
+	while ($progress) {
+		$progress = 0;
+
+		for (my $i = 0; $i < @$jobs && @$jobs > 1; $i++) {
+			my @candidate = @$jobs;
+			splice(@candidate, $i, 1);
+			if (differs(\@candidate, $reference, $variant)) {
+				$jobs = \@candidate;
+				$progress = 1;
+				$i--;
+			}
+		}
+
+		for my $i (0 .. $#$jobs) {
+			for my $field (1, 2) {
+				while ($jobs->[$i][$field] > ($field == 1 ? 1 : 0)) {
+					my @candidate = map { [@$_] } @$jobs;
+					$candidate[$i][$field]--;
+					last unless differs(\@candidate, $reference, $variant);
+					$jobs = \@candidate;
+					$progress = 1;
+				}
+			}
+
+			while ($jobs->[$i][0] > ($i ? $jobs->[$i - 1][0] : 0)) {
+				my @candidate = map { [@$_] } @$jobs;
+				$_->[0]-- for @candidate[$i .. $#candidate];
+				last unless differs(\@candidate, $reference, $variant);
+				$jobs = \@candidate;
+				$progress = 1;
+			}
+		}
+	}
+
+	return $jobs;
+}
+
+
+srand($seed);
+
+my ($runs, $failures) = (0, 0);
+TRACE: for my $trace (1 .. $traces) {
+	my $jobs = generate_trace();
+	my $stop = $stops[($trace - 1) % @stops];
+
+	for my $scheme (@schemes) {
+		for my $cores (@cores) {
+			for my $overhead (@overheads) {
+				my $reference = "-c $cores -s $scheme $overhead $stop $backends[0] $steps[0]";
+				my $expected = run($jobs, $reference);
+
+				for my $backend (@backends) {
+					for my $step (@steps) {
+						my $variant = "-c $cores -s $scheme $overhead $stop $backend $step";
+						next if $variant eq $reference;
+
+						$runs++;
+						next if run($jobs, $variant) eq $expected;
+
+						$failures++;
+						my $minimal = shrink($jobs, $reference, $variant);
+						write_trace('difftest-failure.csv', $minimal);
+						print "Trace $trace differs between\n  ./simulator $reference\n  ./simulator $variant\n";
+						print "Minimal reproducer of " . scalar(@$minimal) . " job(s) saved as difftest-failure.csv\n";
+						last TRACE;
+					}
+				}
+			}
+
+			# Fed the same jobs as they arrive, a stream, and a cluster of one node, must end with the averages of
+			# the whole trace
+			next if grep { $_->[3] } @$jobs;
+			my $reference = "-c $cores -s $scheme";
+			my $expected = averages($jobs, $reference);
+			for my $variant ("$reference --stream", "$reference --cluster 1 --threads 1") {
+				$runs++;
+				next if averages($jobs, $variant) eq $expected;
+
+				$failures++;
+				write_trace('difftest-failure.csv', $jobs);
+				print "Trace $trace ends with other averages under\n  ./simulator $reference\n  ./simulator $variant\n";
+				print "Trace of " . scalar(@$jobs) . " job(s) saved as difftest-failure.csv\n";
+				last TRACE;
+			}
+		}
+	}
+}
+
+print "$runs comparison(s) over $traces trace(s) (seed $seed), $failures difference(s)\n";
+
+#cleanup
+unlink($trace_file, $events_file, $checkpoint_file);
+exit($failures ? 1 : 0);
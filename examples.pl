@@ -4,15 +4,20 @@
 # Adopted from CS 241 @ The University of Illinois
 
 for $file (<examples/*>){
-	if( $file =~ /proc(\d+)-c(\d+)-(\w+)\.out/){
-	#	print "Proc $1 CORE $2 Proc $3\n";
-		`./simulator -c $2 -s $3 examples/proc$1.csv | tail -7 > output1`;
-		`tail -7 $file > output2`;
+	# procN-c<cores>-<scheme>.out, or procN-t<topology>-<scheme>.out for heterogeneous cores
+	if( $file =~ /proc(\d+)-(c|t)([\d.x@,]+)-(\w+)\.out/){
+	#	print "Proc $1 CORE $3 Proc $4\n";
+		$cores = $2 eq "t" ? "--topology $3" : "-c $3";
+		# Everything from the final timing diagram on, whatever the number of cores
+		`./simulator $cores -s $4 examples/proc$1.csv | sed -n '/^FINAL TIMING DIAGRAM:/,\$p' > output1`;
+		`sed -n '/^FINAL TIMING DIAGRAM:/,\$p' $file > output2`;
 		$diff = `diff output1 output2`;
 		if($diff){
 			print "Test file $file differs\n$diff";
+			$failed = 1;
 		}
 	}
 }
 #cleanup
 `rm output1 output2`;
+exit($failed ? 1 : 0);
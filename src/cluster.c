@@ -0,0 +1,431 @@
+/** @file cluster.c
+
+  Simulates a cluster of identical nodes behind a central dispatcher. Every
+  node is a simulation of its own, with its own scheduler, that starts empty;
+  the dispatcher sends each job of the trace to one node as it arrives, by
+  the state the nodes are in at that moment.
+
+  Time is kept in step across the nodes: between two arrival times the nodes
+  run side by side on a pool of threads, each up to the next arrival time,
+  and the dispatcher only places the jobs arriving then once every node has
+  reached it. Nodes never share anything while they run, so the results do
+  not depend on the number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "cluster.h"
+
+
+typedef struct _cluster_node_t
+{
+	simulation_t sim;          // first, so that the finish callback can find its node
+	scheduler_t *scheduler;
+	int status;
+	int jobs;                  // jobs dispatched to the node
+	int finished_at;           // time the node's last job finished
+	int *trace_job;            // job of the trace behind each of the node's job ids
+	int trace_capacity;
+	double turnaround;         // total turnaround time of the node's finished jobs
+} cluster_node_t;
+
+/**
+  Threads that run the nodes up to the same time, one epoch at a time. The
+  thread that starts an epoch runs nodes too.
+*/
+typedef struct _cluster_pool_t
+{
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	int generation;    // epochs started so far
+	int busy;          // workers still running nodes in the current epoch
+	int stop;
+	int next;          // next node to run, taken atomically
+	int until;         // time the current epoch runs the nodes up to
+	cluster_node_t *nodes;
+	int node_count;
+} cluster_pool_t;
+
+static cluster_pool_t pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static float *cluster_waiting, *cluster_turnaround, *cluster_response;  // by job of the trace
+
+
+static void cluster_job_finished(const simulation_t *sim, int job_id, int time)
+{
+	cluster_node_t *node = (cluster_node_t *)sim;
+	int job = node->trace_job[job_id];
+	scheduler_job_stats_t stats;
+
+	scheduler_last_finished(&stats);
+	cluster_waiting[job] = stats.waiting_time;
+	cluster_turnaround[job] = stats.turnaround_time;
+	cluster_response[job] = stats.response_time;
+	node->turnaround += cluster_turnaround[job];
+	node->finished_at = time;
+}
+
+
+/**
+  Runs a node up to time until, idling through the time it has no jobs. Until
+  INT_MAX runs the node's jobs to completion.
+*/
+static void advance_node(cluster_node_t *node, int until)
+{
+	scheduler_attach(node->scheduler);
+	while (node->status != SIMULATION_FAILED && node->sim.time < until && !(until == INT_MAX && node->sim.active_jobs == 0))
+	{
+		node->sim.horizon = until;
+
+		if (node->sim.active_jobs == 0)
+			node->sim.time = until;
+		else if (simulation_step(&node->sim) == SIMULATION_FAILED)
+			node->status = SIMULATION_FAILED;
+	}
+}
+
+
+static void advance_nodes()
+{
+	int i;
+
+	while ((i = __atomic_fetch_add(&pool.next, 1, __ATOMIC_RELAXED)) < pool.node_count)
+		advance_node(&pool.nodes[i], pool.until);
+}
+
+
+static void *pool_worker(void *arg)
+{
+	int generation = 0;
+
+	pthread_mutex_lock(&pool.lock);
+	while (1)
+	{
+		while (pool.generation == generation && !pool.stop)
+			pthread_cond_wait(&pool.start, &pool.lock);
+		if (pool.stop)
+			break;
+		generation = pool.generation;
+		pthread_mutex_unlock(&pool.lock);
+
+		advance_nodes();
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.busy == 0)
+			pthread_cond_signal(&pool.done);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+
+/**
+  Runs every node up to time until, and returns once all of them are there.
+*/
+static void run_epoch(int workers, int until)
+{
+	pthread_mutex_lock(&pool.lock);
+	pool.until = until;
+	pool.next = 0;
+	pool.busy = workers;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.lock);
+
+	advance_nodes();
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.busy > 0)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+
+static uint64_t next_random(uint64_t *state)
+{
+	// xorshift64*
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1DULL;
+}
+
+
+static long remaining_work(const cluster_node_t *node)
+{
+	long work = 0;
+
+	for (int i = 0; i < node->sim.active_jobs; i++)
+		work += node->sim.jobs[i].work;
+	return work;
+}
+
+
+/**
+  Picks the node the next job goes to. Ties go to the lowest numbered node.
+*/
+static int pick_node(const cluster_node_t *nodes, int count, dispatch_t dispatch, uint64_t *random)
+{
+	int i, best = 0;
+
+	if (dispatch == DISPATCH_RANDOM)
+		return next_random(random) % count;
+
+	if (dispatch == DISPATCH_TWO_CHOICES)
+	{
+		if (count == 1)
+			return 0;
+
+		int a = next_random(random) % count;
+		int b = next_random(random) % (count - 1);
+		if (b >= a)
+			b++;
+		return nodes[b].sim.active_jobs < nodes[a].sim.active_jobs ? b : a;
+	}
+
+	if (dispatch == DISPATCH_LEAST_LOADED)
+	{
+		long least = remaining_work(&nodes[0]);
+		for (i = 1; i < count; i++)
+		{
+			long work = remaining_work(&nodes[i]);
+			if (work < least)
+			{
+				best = i;
+				least = work;
+			}
+		}
+		return best;
+	}
+
+	for (i = 1; i < count; i++)
+		if (nodes[i].sim.active_jobs < nodes[best].sim.active_jobs)
+			best = i;
+	return best;
+}
+
+
+static int compare_floats(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+
+static int compare_arrivals(const void *a, const void *b)
+{
+	const simulator_job_list_t *x = *(simulator_job_list_t * const *)a, *y = *(simulator_job_list_t * const *)b;
+
+	if (x->arrival_time != y->arrival_time)
+		return x->arrival_time - y->arrival_time;
+	return x->job_id - y->job_id;
+}
+
+
+static void print_percentiles(const char *name, float *values, int count)
+{
+	qsort(values, count, sizeof(float), compare_floats);
+	printf("%s Percentiles: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n", name,
+			count ? values[(50 * count + 99) / 100 - 1] : 0, count ? values[(90 * count + 99) / 100 - 1] : 0,
+			count ? values[(99 * count + 99) / 100 - 1] : 0, count ? values[count - 1] : 0);
+}
+
+
+/**
+  Prints the nodes' share of the jobs and of the work, the cluster-wide
+  averages and percentiles, and how evenly the load was spread: the busiest
+  node against the mean, in jobs and in busy time.
+*/
+static void print_cluster(cluster_node_t *nodes, int count, int job_count)
+{
+	double waiting = 0, turnaround = 0, response = 0;
+	double busy_total = 0, busy_squares = 0;
+	int busy_max = 0, jobs_max = 0, end = 0, i;
+
+	for (i = 0; i < count; i++)
+		if (nodes[i].finished_at > end)
+			end = nodes[i].finished_at;
+
+	printf("Node   Jobs   Busy Time   Utilization   Finished At   Mean Turnaround\n");
+	for (i = 0; i < count; i++)
+	{
+		scheduler_stats_t stats;
+
+		scheduler_attach(nodes[i].scheduler);
+		scheduler_stats(nodes[i].finished_at, &stats);
+		printf("%4d %6d %11d %12.2f%% %13d %17.2f\n", i, nodes[i].jobs, stats.busy_time,
+				end ? 100.0 * stats.busy_time / ((double)nodes[i].sim.cores * end) : 0.0, nodes[i].finished_at,
+				nodes[i].jobs ? nodes[i].turnaround / nodes[i].jobs : 0.0);
+
+		busy_total += stats.busy_time;
+		busy_squares += (double)stats.busy_time * stats.busy_time;
+		if (stats.busy_time > busy_max)
+			busy_max = stats.busy_time;
+		if (nodes[i].jobs > jobs_max)
+			jobs_max = nodes[i].jobs;
+	}
+
+	for (i = 0; i < job_count; i++)
+	{
+		waiting += cluster_waiting[i];
+		turnaround += cluster_turnaround[i];
+		response += cluster_response[i];
+	}
+
+	double busy_mean = busy_total / count;
+	double busy_deviation = sqrt(fmax(busy_squares / count - busy_mean * busy_mean, 0));
+
+	printf("\n");
+	printf("Jobs Finished: %d by time %d\n", job_count, end);
+	printf("Average Waiting Time: %.2f\n", job_count ? waiting / job_count : 0);
+	printf("Average Turnaround Time: %.2f\n", job_count ? turnaround / job_count : 0);
+	printf("Average Response Time: %.2f\n", job_count ? response / job_count : 0);
+	print_percentiles("Waiting Time", cluster_waiting, job_count);
+	print_percentiles("Turnaround Time", cluster_turnaround, job_count);
+	print_percentiles("Response Time", cluster_response, job_count);
+	printf("Imbalance: jobs max/mean %.2f, busy time max/mean %.2f, busy time coefficient of variation %.2f\n",
+			job_count ? jobs_max / ((double)job_count / count) : 0.0, busy_mean > 0 ? busy_max / busy_mean : 0.0,
+			busy_mean > 0 ? busy_deviation / busy_mean : 0.0);
+}
+
+
+/**
+  Runs the jobs of sim on a cluster of nodes, each a copy of sim's cores,
+  scheme and overheads with a scheduler of its own, and prints a summary of
+  the cluster.
+
+  @param sim a simulation at time 0 holding the trace, with the current scheduler.
+  @param nodes the number of nodes.
+  @param dispatch how the dispatcher picks a node for each job.
+  @param threads the number of threads running the nodes, including the calling one.
+  @param seed seed of the dispatcher's random choices, and of every node's scheduler.
+  @return 0 on success
+  @return 3 if a node's scheduler made an invalid decision
+ */
+int cluster_run(const simulation_t *sim, int nodes, dispatch_t dispatch, int threads, unsigned long seed)
+{
+	scheduler_t *original = scheduler_current();
+	cluster_node_t *node = calloc(nodes, sizeof(cluster_node_t));
+	const simulator_job_list_t **arrivals = malloc((sim->active_jobs + 1) * sizeof(simulator_job_list_t *));
+	pthread_t *workers;
+	uint64_t random = seed * 0x9E3779B97F4A7C15ULL + 1;
+	int job_count = sim->active_jobs, heterogeneous = 0;
+	int i, j, c, failed = 0;
+
+	if (threads > nodes)
+		threads = nodes;
+	workers = malloc(threads * sizeof(pthread_t));
+
+	for (c = 0; c < sim->cores; c++)
+		if (sim->core_speed[c] != 100 || sim->core_socket[c] != 0)
+			heterogeneous = 1;
+
+	for (i = 0; i < nodes; i++)
+	{
+		scheduler_start_up(sim->cores, sim->scheme);
+		scheduler_set_affinity(sim->affinity_window);
+		scheduler_set_seed(seed);
+		if (heterogeneous)
+			scheduler_set_topology(sim->core_speed, sim->core_socket);
+		node[i].scheduler = scheduler_current();
+
+		simulation_init(&node[i].sim, sim->cores, sim->scheme, sim->quantum, NULL, 0, sim->core_speed, sim->core_socket);
+		node[i].sim.switch_cost_fixed = sim->switch_cost_fixed;
+		node[i].sim.switch_cost_migration = sim->switch_cost_migration;
+		node[i].sim.affinity_window = sim->affinity_window;
+		node[i].sim.event_driven = sim->event_driven;
+		node[i].sim.quiet = 1;
+		node[i].sim.record_diagram = 0;
+		node[i].sim.finished = cluster_job_finished;
+		simulation_set_io_devices(&node[i].sim, 1);
+	}
+
+	// A single node gets every job, and lays them out as the plain run does to end as it does
+	if (nodes == 1)
+		simulation_reserve_jobs(&node[0].sim, job_count);
+
+	cluster_waiting = malloc((job_count + 1) * sizeof(float));
+	cluster_turnaround = malloc((job_count + 1) * sizeof(float));
+	cluster_response = malloc((job_count + 1) * sizeof(float));
+
+	for (i = 0; i < job_count; i++)
+		arrivals[i] = &sim->jobs[i];
+	qsort(arrivals, job_count, sizeof(simulator_job_list_t *), compare_arrivals);
+
+	pool.nodes = node;
+	pool.node_count = nodes;
+	pool.generation = 0;
+	pool.stop = 0;
+	for (i = 1; i < threads; i++)
+		if (pthread_create(&workers[i], NULL, pool_worker, NULL) != 0)
+			break;
+	threads = i;
+
+	for (i = 0; i < job_count && !failed; i = j)
+	{
+		int now = arrivals[i]->arrival_time;
+
+		run_epoch(threads - 1, now);
+		for (c = 0; c < nodes; c++)
+			if (node[c].status == SIMULATION_FAILED)
+				failed = 1;
+
+		// Every node has reached the arrival time, so the dispatcher sees them as they are then
+		for (j = i; j < job_count && arrivals[j]->arrival_time == now && !failed; j++)
+		{
+			cluster_node_t *target = &node[pick_node(node, nodes, dispatch, &random)];
+
+			if (target->sim.next_job_id == target->trace_capacity)
+			{
+				target->trace_capacity = target->trace_capacity * 2 + 8;
+				target->trace_job = realloc(target->trace_job, target->trace_capacity * sizeof(int));
+			}
+			target->trace_job[target->sim.next_job_id] = arrivals[j] - sim->jobs;
+			target->jobs++;
+			simulation_add_job(&target->sim, now, arrivals[j]->run_time, arrivals[j]->priority);
+		}
+	}
+
+	if (!failed)
+		run_epoch(threads - 1, INT_MAX);
+	for (c = 0; c < nodes; c++)
+		if (node[c].status == SIMULATION_FAILED)
+		{
+			printf("Node %d: the scheduler made an invalid decision at time %d.\n", c, node[c].sim.time);
+			failed = 1;
+		}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.stop = 1;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.lock);
+	for (i = 1; i < threads; i++)
+		pthread_join(workers[i], NULL);
+
+	if (!failed)
+		print_cluster(node, nodes, job_count);
+
+	for (i = 0; i < nodes; i++)
+	{
+		scheduler_attach(node[i].scheduler);
+		scheduler_clean_up();
+		simulation_destroy(&node[i].sim);
+		free(node[i].trace_job);
+	}
+	scheduler_attach(original);
+
+	free(cluster_waiting);
+	free(cluster_turnaround);
+	free(cluster_response);
+	free(arrivals);
+	free(workers);
+	free(node);
+
+	return failed ? 3 : 0;
+}
@@ -0,0 +1,16 @@
+/** @file cluster.h
+ */
+
+#ifndef CLUSTER_H_
+#define CLUSTER_H_
+
+#include "simulation.h"
+
+/**
+  How the dispatcher of a cluster picks the node an arriving job goes to
+*/
+typedef enum {DISPATCH_RANDOM = 0, DISPATCH_TWO_CHOICES, DISPATCH_LEAST_LOADED, DISPATCH_SHORTEST_QUEUE} dispatch_t;
+
+int cluster_run(const simulation_t *sim, int nodes, dispatch_t dispatch, int threads, unsigned long seed);
+
+#endif /* CLUSTER_H_ */
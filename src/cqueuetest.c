@@ -0,0 +1,117 @@
+/** @file cqueuetest.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "libpriqueue/libcpriqueue.h"
+
+#define THREADS 8
+#define VALUES_PER_THREAD 20000
+
+int compare1(const void * a, const void * b)
+{
+	return ( *(int*)a - *(int*)b );
+}
+
+cpriqueue_t shared;
+int *values;
+int *seen;
+
+/* Offers this thread's values, polling after every other offer. */
+void *stress(void *arg)
+{
+	int first = *(int *)arg * VALUES_PER_THREAD;
+	int i;
+
+	for (i = first; i < first + VALUES_PER_THREAD; i++)
+	{
+		cpriqueue_offer(&shared, &values[i]);
+
+		if (i % 2)
+		{
+			int *val = cpriqueue_poll(&shared);
+			if (val != NULL)
+				__atomic_add_fetch(&seen[*val], 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	return NULL;
+}
+
+int main()
+{
+	cpriqueue_t q, q1;
+	int total = THREADS * VALUES_PER_THREAD;
+	int i;
+
+	values = malloc(total * sizeof(int));
+	seen = calloc(total, sizeof(int));
+	for (i = 0; i < total; i++)
+		values[i] = i;
+
+	/* A single lane behaves exactly like priqueue_t. */
+	cpriqueue_init(&q1, 1, compare1);
+	cpriqueue_offer(&q1, &values[30]);
+	cpriqueue_offer(&q1, &values[10]);
+	cpriqueue_offer(&q1, &values[20]);
+	printf("Single lane poll order (expected 10 20 30): ");
+	for (i = 0; i < 3; i++)
+		printf("%d ", *((int *)cpriqueue_poll(&q1)) );
+	printf("\n");
+	cpriqueue_destroy(&q1);
+
+	/* Indexed operations see the merged order of every lane. */
+	cpriqueue_init(&q, 4, compare1);
+	for (i = 9; i >= 0; i--)
+		cpriqueue_offer(&q, &values[i]);
+
+	printf("Merged order over 4 lanes (expected 0 1 2 3 4 5 6 7 8 9): ");
+	for (i = 0; i < cpriqueue_size(&q); i++)
+		printf("%d ", *((int *)cpriqueue_at(&q, i)) );
+	printf("\n");
+
+	void *snapshot[10];
+	int copied = cpriqueue_to_array(&q, snapshot);
+	printf("Copied out in merged order (expected 0 1 2 3 4 5 6 7 8 9): ");
+	for (i = 0; i < copied; i++)
+		printf("%d ", *((int *)snapshot[i]) );
+	printf("\n");
+
+	printf("Removed at index 3: %d (expected 3).\n", *((int *)cpriqueue_remove_at(&q, 3)));
+	printf("Elements removed: %d (expected 1).\n", cpriqueue_remove(&q, &values[7]));
+	printf("Total elements: %d (expected 8).\n", cpriqueue_size(&q));
+	cpriqueue_destroy(&q);
+
+	/* Many threads offering and polling at once lose and duplicate nothing. */
+	pthread_t threads[THREADS];
+	int ids[THREADS];
+
+	cpriqueue_init(&shared, 2 * THREADS, compare1);
+	for (i = 0; i < THREADS; i++)
+	{
+		ids[i] = i;
+		pthread_create(&threads[i], NULL, stress, &ids[i]);
+	}
+	for (i = 0; i < THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	int *val;
+	while ((val = cpriqueue_poll(&shared)) != NULL)
+		seen[*val]++;
+
+	int wrong = 0;
+	for (i = 0; i < total; i++)
+		if (seen[i] != 1)
+			wrong++;
+
+	printf("Stress: %d thread(s), %d value(s), %d polled other than exactly once (expected 0).\n", THREADS, total, wrong);
+	printf("Total elements: %d (expected 0).\n", cpriqueue_size(&shared));
+	cpriqueue_destroy(&shared);
+
+	free(seen);
+	free(values);
+
+	return wrong != 0;
+}
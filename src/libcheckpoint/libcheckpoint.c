@@ -0,0 +1,172 @@
+/** @file libcheckpoint.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libcheckpoint.h"
+
+
+/**
+  Writes value as a zigzag LEB128 varint.
+
+  @param file the snapshot being written
+  @param value the integer to write
+ */
+void checkpoint_write_int(FILE *file, long value)
+{
+	unsigned long zigzag = ((unsigned long)value << 1) ^ (unsigned long)(value >> (sizeof(long) * 8 - 1));
+
+	while(zigzag >= 0x80){
+		fputc((int)(zigzag & 0x7f) | 0x80, file);
+		zigzag >>= 7;
+	}
+	fputc((int)zigzag, file);
+}
+
+
+/**
+  Reads an integer written by checkpoint_write_int.
+
+  @param file the snapshot being read
+  @param value set to the integer read
+  @return 0 on success
+  @return -1 if the file ends early or the varint is too long
+ */
+int checkpoint_read_int(FILE *file, long *value)
+{
+	unsigned long zigzag = 0;
+	int shift = 0;
+	int c;
+
+	do{
+		c = fgetc(file);
+		if(c == EOF || shift >= (int)sizeof(long) * 8){
+			return -1;
+		}
+		zigzag |= (unsigned long)(c & 0x7f) << shift;
+		shift = shift + 7;
+	} while(c & 0x80);
+
+	*value = (long)(zigzag >> 1) ^ -(long)(zigzag & 1);
+	return 0;
+}
+
+
+/**
+  Writes n integers, one varint each.
+ */
+void checkpoint_write_ints(FILE *file, const int *values, int n)
+{
+	for(int i=0; i<n; i++){
+		checkpoint_write_int(file, values[i]);
+	}
+}
+
+
+/**
+  Reads n integers written by checkpoint_write_ints.
+
+  @return 0 on success
+  @return -1 if the file ends early
+ */
+int checkpoint_read_ints(FILE *file, int *values, int n)
+{
+	long value;
+
+	for(int i=0; i<n; i++){
+		if(checkpoint_read_int(file, &value) != 0){
+			return -1;
+		}
+		values[i] = (int)value;
+	}
+
+	return 0;
+}
+
+
+/**
+  Writes the raw bytes of a float.
+ */
+void checkpoint_write_float(FILE *file, float value)
+{
+	fwrite(&value, sizeof(float), 1, file);
+}
+
+
+/**
+  Reads a float written by checkpoint_write_float.
+
+  @return 0 on success
+  @return -1 if the file ends early
+ */
+int checkpoint_read_float(FILE *file, float *value)
+{
+	return fread(value, sizeof(float), 1, file) == 1 ? 0 : -1;
+}
+
+
+/**
+  Writes a string run-length encoded: the number of runs, then a count and
+  a byte for each run. Timing diagrams are mostly long runs of one job or of
+  idle ticks, so they shrink by orders of magnitude.
+ */
+void checkpoint_write_string(FILE *file, const char *string)
+{
+	int length = strlen(string);
+	int runs = 0;
+
+	for(int i=0; i<length; i++){
+		if(i == 0 || string[i] != string[i-1]){
+			runs = runs +1;
+		}
+	}
+	checkpoint_write_int(file, runs);
+
+	for(int i=0; i<length; ){
+		int run = 1;
+		while(i + run < length && string[i + run] == string[i]){
+			run = run +1;
+		}
+		checkpoint_write_int(file, run);
+		fputc(string[i], file);
+		i = i + run;
+	}
+}
+
+
+/**
+  Reads a string written by checkpoint_write_string into a heap buffer,
+  growing it as needed.
+
+  @param string the buffer, reallocated if it is too small
+  @param capacity the usable size of the buffer, excluding the terminator
+  @return 0 on success
+  @return -1 if the file ends early
+ */
+int checkpoint_read_string(FILE *file, char **string, int *capacity)
+{
+	long runs, run;
+	int length = 0;
+
+	if(checkpoint_read_int(file, &runs) != 0){
+		return -1;
+	}
+
+	for(long i=0; i<runs; i++){
+		int c;
+		if(checkpoint_read_int(file, &run) != 0 || run < 0 || (c = fgetc(file)) == EOF){
+			return -1;
+		}
+
+		while(length + run > *capacity){
+			*capacity = *capacity * 2;
+			*string = realloc(*string, *capacity + 1);
+		}
+		memset(*string + length, c, run);
+		length = length + run;
+	}
+
+	(*string)[length] = '\0';
+	return 0;
+}
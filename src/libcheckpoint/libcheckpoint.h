@@ -0,0 +1,24 @@
+/** @file libcheckpoint.h
+ */
+
+#ifndef LIBCHECKPOINT_H_
+#define LIBCHECKPOINT_H_
+
+#include <stdio.h>
+
+/**
+  Compact binary encoding shared by the simulator and scheduler snapshots.
+  Integers are written as zigzag LEB128 varints, so the small values that
+  make up most of a snapshot take one byte. The read functions return 0 on
+  success and -1 on a short or malformed file.
+*/
+void checkpoint_write_int   (FILE *file, long value);
+int  checkpoint_read_int    (FILE *file, long *value);
+void checkpoint_write_ints  (FILE *file, const int *values, int n);
+int  checkpoint_read_ints   (FILE *file, int *values, int n);
+void checkpoint_write_float (FILE *file, float value);
+int  checkpoint_read_float  (FILE *file, float *value);
+void checkpoint_write_string(FILE *file, const char *string);
+int  checkpoint_read_string (FILE *file, char **string, int *capacity);
+
+#endif /* LIBCHECKPOINT_H_ */
@@ -0,0 +1,207 @@
+/** @file libeventlog.c
+
+  Events are appended to one of two buffers. When a buffer fills up it is
+  handed to a writer thread, which formats and writes it while the caller
+  fills the other one, so the caller only waits when the disk cannot keep up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "libeventlog.h"
+#include "../libcheckpoint/libcheckpoint.h"
+
+#define EVENTLOG_MAGIC "SCHEDEVT"
+#define EVENTLOG_VERSION 1
+#define EVENTLOG_BUFFER 4096
+
+
+struct _eventlog_t
+{
+	FILE* file;
+	eventlog_format_t format;
+
+	event_t* buffers[2];
+	int current;
+	int fill;
+
+	event_t* pending;
+	int pending_count;
+	int closing;
+	int last_time;
+
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	pthread_cond_t drained;
+};
+
+
+static const char* event_names[] = { "arrival", "dispatch", "preempt", "quantum_expired", "finish", "block", "unblock" };
+
+
+static void write_events(eventlog_t* log, const event_t* events, int count){
+	for(int i=0; i<count; i++){
+		const event_t* event = &events[i];
+
+		if(log->format == EVENTLOG_BINARY){
+			checkpoint_write_int(log->file, event->type);
+			checkpoint_write_int(log->file, event->time - log->last_time);
+			checkpoint_write_int(log->file, event->core_id);
+			checkpoint_write_int(log->file, event->job_id);
+			checkpoint_write_int(log->file, event->queue_depth);
+			log->last_time = event->time;
+		}
+		else{
+			fprintf(log->file, "{\"time\":%d,\"event\":\"%s\",\"core\":%d,\"job\":%d,\"queue\":%d}\n",
+					event->time, event_names[event->type], event->core_id, event->job_id, event->queue_depth);
+		}
+	}
+}
+
+
+static void* writer_main(void* arg){
+	eventlog_t* log = arg;
+
+	pthread_mutex_lock(&log->lock);
+	while(1){
+		while(log->pending == NULL && !log->closing){
+			pthread_cond_wait(&log->ready, &log->lock);
+		}
+		if(log->pending == NULL){
+			break;
+		}
+
+		event_t* events = log->pending;
+		int count = log->pending_count;
+		pthread_mutex_unlock(&log->lock);
+
+		write_events(log, events, count);
+
+		pthread_mutex_lock(&log->lock);
+		log->pending = NULL;
+		pthread_cond_signal(&log->drained);
+	}
+	pthread_mutex_unlock(&log->lock);
+
+	return NULL;
+}
+
+
+/**
+  Hands the buffer being filled to the writer thread, waiting for it to
+  finish with the previous one first.
+ */
+static void hand_off(eventlog_t* log){
+	pthread_mutex_lock(&log->lock);
+	while(log->pending != NULL){
+		pthread_cond_wait(&log->drained, &log->lock);
+	}
+	log->pending = log->buffers[log->current];
+	log->pending_count = log->fill;
+	pthread_cond_signal(&log->ready);
+	pthread_mutex_unlock(&log->lock);
+
+	log->current = !log->current;
+	log->fill = 0;
+}
+
+
+/**
+  Creates an event log writing to file_name, replacing any existing file.
+
+  @param file_name the file to write the events to.
+  @param format the format to write them in.
+  @return the event log
+  @return NULL if the file could not be created or the writer thread could not be started
+ */
+eventlog_t* eventlog_open(const char* file_name, eventlog_format_t format)
+{
+	eventlog_t* log = calloc(1, sizeof(eventlog_t));
+
+	log->file = fopen(file_name, format == EVENTLOG_BINARY ? "wb" : "w");
+	if(log->file == NULL){
+		free(log);
+		return NULL;
+	}
+
+	log->format = format;
+	log->buffers[0] = malloc(EVENTLOG_BUFFER * sizeof(event_t));
+	log->buffers[1] = malloc(EVENTLOG_BUFFER * sizeof(event_t));
+	pthread_mutex_init(&log->lock, NULL);
+	pthread_cond_init(&log->ready, NULL);
+	pthread_cond_init(&log->drained, NULL);
+
+	if(format == EVENTLOG_BINARY){
+		fputs(EVENTLOG_MAGIC, log->file);
+		checkpoint_write_int(log->file, EVENTLOG_VERSION);
+	}
+
+	if(pthread_create(&log->writer, NULL, writer_main, log) != 0){
+		fclose(log->file);
+		free(log->buffers[0]);
+		free(log->buffers[1]);
+		free(log);
+		return NULL;
+	}
+
+	return log;
+}
+
+
+/**
+  Records an event. The event is written out later by the writer thread.
+
+  @param type what happened.
+  @param time the time it happened at.
+  @param core_id the core involved, or -1 if none.
+  @param job_id the job involved, or -1 if none.
+  @param queue_depth the number of jobs waiting in the queue after the event.
+ */
+void eventlog_write(eventlog_t* log, event_type_t type, int time, int core_id, int job_id, int queue_depth)
+{
+	event_t* event = &log->buffers[log->current][log->fill];
+	event->type = type;
+	event->time = time;
+	event->core_id = core_id;
+	event->job_id = job_id;
+	event->queue_depth = queue_depth;
+
+	log->fill = log->fill + 1;
+	if(log->fill == EVENTLOG_BUFFER){
+		hand_off(log);
+	}
+}
+
+
+/**
+  Writes out every recorded event, stops the writer thread and closes the
+  file.
+
+  @return 0 on success
+  @return -1 if the events could not all be written
+ */
+int eventlog_close(eventlog_t* log)
+{
+	if(log->fill > 0){
+		hand_off(log);
+	}
+
+	pthread_mutex_lock(&log->lock);
+	log->closing = 1;
+	pthread_cond_signal(&log->ready);
+	pthread_mutex_unlock(&log->lock);
+	pthread_join(log->writer, NULL);
+
+	int status = (ferror(log->file) | fclose(log->file)) ? -1 : 0;
+
+	pthread_mutex_destroy(&log->lock);
+	pthread_cond_destroy(&log->ready);
+	pthread_cond_destroy(&log->drained);
+	free(log->buffers[0]);
+	free(log->buffers[1]);
+	free(log);
+
+	return status;
+}
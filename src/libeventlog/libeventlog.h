@@ -0,0 +1,43 @@
+/** @file libeventlog.h
+ */
+
+#ifndef LIBEVENTLOG_H_
+#define LIBEVENTLOG_H_
+
+/**
+  The scheduling events an event log records
+*/
+typedef enum {EVENT_ARRIVAL = 0, EVENT_DISPATCH, EVENT_PREEMPT, EVENT_QUANTUM_EXPIRED, EVENT_FINISH, EVENT_BLOCK, EVENT_UNBLOCK} event_type_t;
+
+/**
+  The formats an event log can be written in.
+
+  EVENTLOG_JSON writes one JSON object per line:
+    {"time":3,"event":"dispatch","core":0,"job":2,"queue":1}
+
+  EVENTLOG_BINARY writes the magic "SCHEDEVT", a format version, then one
+  record per event: the event type, the time elapsed since the previous
+  event, the core, the job and the queue depth, each as a zigzag LEB128
+  varint as written by checkpoint_write_int. A core or job of -1 means none.
+*/
+typedef enum {EVENTLOG_JSON = 0, EVENTLOG_BINARY} eventlog_format_t;
+
+/**
+  One recorded event
+*/
+typedef struct _event_t
+{
+	int type;
+	int time;
+	int core_id;
+	int job_id;
+	int queue_depth;
+} event_t;
+
+typedef struct _eventlog_t eventlog_t;
+
+eventlog_t *eventlog_open (const char *file_name, eventlog_format_t format);
+void        eventlog_write(eventlog_t *log, event_type_t type, int time, int core_id, int job_id, int queue_depth);
+int         eventlog_close(eventlog_t *log);
+
+#endif /* LIBEVENTLOG_H_ */
@@ -0,0 +1,176 @@
+/** @file libinstrument.c
+
+  Every thread records into its own histograms, so timing a call never takes
+  a lock. A thread's histograms are registered once, on its first record, and
+  are folded into a shared total when the thread exits, so the latencies of
+  worker threads that have been joined are not lost.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libinstrument.h"
+
+
+static const char* point_names[] = {
+	"scheduler_new_job", "scheduler_new_job_in_group", "scheduler_new_jobs", "scheduler_job_finished",
+	"scheduler_quantum_expired", "scheduler_job_blocked", "scheduler_job_unblocked", "scheduler_gang_dispatch",
+	"priqueue_offer", "priqueue_offer_all", "priqueue_peek", "priqueue_poll", "priqueue_at", "priqueue_remove",
+	"priqueue_remove_at", "priqueue_size", "priqueue_iterator", "priqueue_next", "priqueue_to_array"
+};
+
+static __thread instrument_histogram_t* histograms;
+
+static instrument_histogram_t exited[INSTRUMENT_POINTS];   // threads that exited since the last dump
+static pthread_mutex_t exited_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+
+static void merge(instrument_histogram_t* into, const instrument_histogram_t* from){
+	for(int i=0; i<INSTRUMENT_POINTS; i++){
+		if(from[i].calls == 0){
+			continue;
+		}
+		if(into[i].calls == 0 || from[i].min < into[i].min){
+			into[i].min = from[i].min;
+		}
+		if(from[i].max > into[i].max){
+			into[i].max = from[i].max;
+		}
+		into[i].calls = into[i].calls + from[i].calls;
+		into[i].total = into[i].total + from[i].total;
+		for(int b=0; b<INSTRUMENT_BUCKETS; b++){
+			into[i].buckets[b] = into[i].buckets[b] + from[i].buckets[b];
+		}
+	}
+}
+
+
+static void thread_exit(void* block){
+	pthread_mutex_lock(&exited_lock);
+	merge(exited, block);
+	pthread_mutex_unlock(&exited_lock);
+	free(block);
+}
+
+
+static void make_thread_key(){
+	pthread_key_create(&thread_key, thread_exit);
+}
+
+
+/**
+  Reads the monotonic clock.
+
+  @return the time in nanoseconds
+*/
+uint64_t instrument_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/**
+  Records a call that started at start and has just returned in the calling
+  thread's histogram of point.
+
+  @param point the call.
+  @param start the time the call started, from instrument_now.
+ */
+void instrument_record(instrument_point_t point, uint64_t start)
+{
+	uint64_t latency = instrument_now() - start;
+
+	if(histograms == NULL){
+		pthread_once(&thread_key_once, make_thread_key);
+		histograms = calloc(INSTRUMENT_POINTS, sizeof(instrument_histogram_t));
+		pthread_setspecific(thread_key, histograms);
+	}
+
+	int bucket = latency ? 64 - __builtin_clzll(latency) : 0;
+	if(bucket >= INSTRUMENT_BUCKETS){
+		bucket = INSTRUMENT_BUCKETS - 1;
+	}
+
+	instrument_histogram_t* h = &histograms[point];
+	if(h->calls == 0 || latency < h->min){
+		h->min = latency;
+	}
+	if(latency > h->max){
+		h->max = latency;
+	}
+	h->calls = h->calls +1;
+	h->total = h->total + latency;
+	h->buckets[bucket] = h->buckets[bucket] +1;
+}
+
+
+/**
+  Upper bound of the bucket the call at fraction p of the calls falls in.
+*/
+static uint64_t percentile(const instrument_histogram_t* h, double p){
+	uint64_t rank = h->calls * p, seen = 0;
+	for(int b=0; b<INSTRUMENT_BUCKETS; b++){
+		seen = seen + h->buckets[b];
+		if(seen > rank){
+			return b ? 1ULL << b : 1;
+		}
+	}
+	return h->max;
+}
+
+
+/**
+  Writes the latencies recorded by the calling thread, and by every thread
+  that exited since the last dump, then clears them. Calls that were never
+  made are left out, and nothing is written if no call was recorded.
+
+  @param file where to write.
+  @param title the first line, naming what was measured.
+ */
+void instrument_dump(FILE *file, const char *title)
+{
+	instrument_histogram_t total[INSTRUMENT_POINTS];
+	memset(total, 0, sizeof(total));
+
+	if(histograms != NULL){
+		merge(total, histograms);
+		memset(histograms, 0, INSTRUMENT_POINTS * sizeof(instrument_histogram_t));
+	}
+	pthread_mutex_lock(&exited_lock);
+	merge(total, exited);
+	memset(exited, 0, sizeof(exited));
+	pthread_mutex_unlock(&exited_lock);
+
+	int recorded = 0;
+	for(int i=0; i<INSTRUMENT_POINTS; i++){
+		recorded = recorded || total[i].calls > 0;
+	}
+	if(!recorded){
+		return;
+	}
+
+	fprintf(file, "%s (latency in ns):\n", title);
+	for(int i=0; i<INSTRUMENT_POINTS; i++){
+		const instrument_histogram_t* h = &total[i];
+		if(h->calls == 0){
+			continue;
+		}
+
+		fprintf(file, "  %-26s %10llu call(s)  mean %8.1f  p50 <%-7llu p99 <%-7llu min %-6llu max %llu\n", point_names[i],
+				(unsigned long long)h->calls, (double)h->total / h->calls, (unsigned long long)percentile(h, 0.5),
+				(unsigned long long)percentile(h, 0.99), (unsigned long long)h->min, (unsigned long long)h->max);
+		fprintf(file, "   ");
+		for(int b=0; b<INSTRUMENT_BUCKETS; b++){
+			if(h->buckets[b] > 0){
+				fprintf(file, " [%llu,%llu) %llu", b ? 1ULL << (b - 1) : 0ULL, b ? 1ULL << b : 1ULL, (unsigned long long)h->buckets[b]);
+			}
+		}
+		fprintf(file, "\n");
+	}
+}
@@ -0,0 +1,78 @@
+/** @file libinstrument.h
+ */
+
+#ifndef LIBINSTRUMENT_H_
+#define LIBINSTRUMENT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+  The calls whose latency is recorded when the tree is built with
+  -DSCHED_INSTRUMENT (make INSTRUMENT=1). Without it the wrappers in
+  libscheduler.h and libpriqueue.h are not defined and nothing is recorded.
+*/
+typedef enum
+{
+	INSTRUMENT_NEW_JOB = 0,
+	INSTRUMENT_NEW_JOB_IN_GROUP,
+	INSTRUMENT_NEW_JOBS,
+	INSTRUMENT_JOB_FINISHED,
+	INSTRUMENT_QUANTUM_EXPIRED,
+	INSTRUMENT_JOB_BLOCKED,
+	INSTRUMENT_JOB_UNBLOCKED,
+	INSTRUMENT_GANG_DISPATCH,
+	INSTRUMENT_PRIQUEUE_OFFER,
+	INSTRUMENT_PRIQUEUE_OFFER_ALL,
+	INSTRUMENT_PRIQUEUE_PEEK,
+	INSTRUMENT_PRIQUEUE_POLL,
+	INSTRUMENT_PRIQUEUE_AT,
+	INSTRUMENT_PRIQUEUE_REMOVE,
+	INSTRUMENT_PRIQUEUE_REMOVE_AT,
+	INSTRUMENT_PRIQUEUE_SIZE,
+	INSTRUMENT_PRIQUEUE_ITERATOR,
+	INSTRUMENT_PRIQUEUE_NEXT,
+	INSTRUMENT_PRIQUEUE_TO_ARRAY,
+	INSTRUMENT_POINTS
+} instrument_point_t;
+
+/**
+  Latencies are kept in power of two buckets: bucket 0 holds 0 ns, bucket b
+  holds [2^(b-1), 2^b) ns.
+*/
+#define INSTRUMENT_BUCKETS 64
+
+/**
+  Latency histogram of a single call
+*/
+typedef struct _instrument_histogram_t
+{
+	uint64_t calls;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[INSTRUMENT_BUCKETS];
+} instrument_histogram_t;
+
+uint64_t instrument_now   ();
+void     instrument_record(instrument_point_t point, uint64_t start);
+void     instrument_dump  (FILE *file, const char *title);
+
+/**
+  Evaluates call, a call returning a value, and records its latency under point.
+*/
+#define INSTRUMENT_CALL(point, call) __extension__ ({ \
+	uint64_t instrument_start_ = instrument_now(); \
+	__typeof__(call) instrument_result_ = (call); \
+	instrument_record((point), instrument_start_); \
+	instrument_result_; })
+
+/**
+  Evaluates call, a call returning void, and records its latency under point.
+*/
+#define INSTRUMENT_VOID_CALL(point, call) do { \
+	uint64_t instrument_start_ = instrument_now(); \
+	(call); \
+	instrument_record((point), instrument_start_); } while (0)
+
+#endif /* LIBINSTRUMENT_H_ */
@@ -0,0 +1,391 @@
+/** @file libcpriqueue.c
+
+  A concurrent priority queue in the style of a MultiQueue: the elements are
+  spread over several lanes, each an ordinary priqueue_t behind its own lock.
+  Offers go to a random lane. Polls lock two random lanes and take the better
+  of their heads, so threads rarely wait on the same lock. Polls are relaxed:
+  the element returned is the best of two lanes rather than the exact
+  minimum, although with a single lane the queue behaves exactly like
+  priqueue_t. Indexed operations (at, remove_at) lock every lane and see the
+  exact merged order.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "libcpriqueue.h"
+
+
+static __thread unsigned int lane_seed;
+
+/**
+  Picks a lane with a per-thread xorshift generator.
+ */
+static int random_lane(cpriqueue_t *q)
+{
+	if(lane_seed == 0){
+		lane_seed = (unsigned int)(uintptr_t)&lane_seed | 1;
+	}
+	lane_seed ^= lane_seed << 13;
+	lane_seed ^= lane_seed >> 17;
+	lane_seed ^= lane_seed << 5;
+
+	return lane_seed % q->lane_count;
+}
+
+
+/**
+  Locks a random lane, trying other lanes while the chosen ones are busy and
+  blocking only after every attempt failed.
+ */
+static cpriqueue_lane_t* lock_random_lane(cpriqueue_t *q)
+{
+	cpriqueue_lane_t* lane;
+
+	for(int attempts = 0; attempts < q->lane_count; attempts++){
+		lane = &q->lanes[random_lane(q)];
+		if(pthread_mutex_trylock(&lane->lock) == 0){
+			return lane;
+		}
+	}
+
+	lane = &q->lanes[random_lane(q)];
+	pthread_mutex_lock(&lane->lock);
+	return lane;
+}
+
+
+/**
+  Publishes the head of a locked lane, so pollers can skip empty lanes
+  without taking their lock.
+ */
+static void update_top(cpriqueue_lane_t *lane)
+{
+	__atomic_store_n(&lane->top, priqueue_peek(&lane->queue), __ATOMIC_RELEASE);
+}
+
+
+static void lock_all(cpriqueue_t *q)
+{
+	for(int i=0; i<q->lane_count; i++){
+		pthread_mutex_lock(&q->lanes[i].lock);
+	}
+}
+
+
+static void unlock_all(cpriqueue_t *q)
+{
+	for(int i=q->lane_count-1; i>=0; i--){
+		pthread_mutex_unlock(&q->lanes[i].lock);
+	}
+}
+
+
+/**
+  Walks every lane in merged priority order. All lanes must be locked.
+
+  @param lane set to the lane holding the index'th element.
+  @param lane_index set to the position of that element within its lane.
+  @param ptrs if not NULL, receives every element walked past on the way.
+  @return the index'th element in merged order
+  @return NULL if the queue does not contain an index'th element
+ */
+static void* merged_at(cpriqueue_t *q, int index, int *lane, int *lane_index, void **ptrs)
+{
+	priqueue_iterator_t cursor[q->lane_count];
+	void* head[q->lane_count];
+
+	if(index < 0){
+		return NULL;
+	}
+
+	for(int i=0; i<q->lane_count; i++){
+		priqueue_iterator(&q->lanes[i].queue, &cursor[i]);
+		head[i] = priqueue_next(&cursor[i]);
+	}
+
+	for(int i=0; ; i++){
+		int best = -1;
+		for(int l=0; l<q->lane_count; l++){
+			if(head[l] != NULL && (best == -1 || q->compare(head[l], head[best]) < 0)){
+				best = l;
+			}
+		}
+
+		if(best == -1){
+			return NULL;
+		}
+		if(i == index){
+			*lane = best;
+			*lane_index = cursor[best].index - 1;
+			return head[best];
+		}
+
+		if(ptrs != NULL){
+			ptrs[i] = head[best];
+		}
+		head[best] = priqueue_next(&cursor[best]);
+	}
+}
+
+
+/**
+  Initializes the cpriqueue_t data structure.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param lanes the number of independently locked lanes. Twice the number of
+  threads sharing the queue is a good choice; a single lane gives exact order.
+  @param comparer a function pointer that compares two elements.
+  See also @ref comparer-page
+ */
+void cpriqueue_init(cpriqueue_t *q, int lanes, int(*comparer)(const void *, const void *))
+{
+	if(lanes < 1){
+		lanes = 1;
+	}
+
+	q->lanes = aligned_alloc(64, lanes * sizeof(cpriqueue_lane_t));
+	q->lane_count = lanes;
+	q->size = 0;
+	q->compare = comparer;
+
+	for(int i=0; i<lanes; i++){
+		pthread_mutex_init(&q->lanes[i].lock, NULL);
+		priqueue_init(&q->lanes[i].queue, comparer);
+		q->lanes[i].top = NULL;
+	}
+}
+
+
+/**
+  Inserts the specified element into a random lane of the queue.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @return The zero-based index where ptr is stored within its lane.
+ */
+int cpriqueue_offer(cpriqueue_t *q, void *ptr)
+{
+	cpriqueue_lane_t* lane = lock_random_lane(q);
+	int index = priqueue_offer(&lane->queue, ptr);
+	update_top(lane);
+	pthread_mutex_unlock(&lane->lock);
+
+	__atomic_add_fetch(&q->size, 1, __ATOMIC_RELAXED);
+	return index;
+}
+
+
+/**
+  Retrieves, but does not remove, the head of this queue, returning NULL if
+  this queue is empty. Under concurrent use the head may be polled by another
+  thread as soon as this returns.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @return pointer to element at the head of the queue
+  @return NULL if the queue is empty
+ */
+void *cpriqueue_peek(cpriqueue_t *q)
+{
+	int lane, lane_index;
+
+	lock_all(q);
+	void* to_return = merged_at(q, 0, &lane, &lane_index, NULL);
+	unlock_all(q);
+
+	return to_return;
+}
+
+
+/**
+  Retrieves and removes an element close to the head of this queue: the
+  better of the heads of two random lanes. Returns NULL only if every lane
+  was found empty.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @return an element from the front of this queue
+  @return NULL if this queue is empty
+ */
+void *cpriqueue_poll(cpriqueue_t *q)
+{
+	void* to_return = NULL;
+
+	for(int attempts = 0; attempts < 2 * q->lane_count && __atomic_load_n(&q->size, __ATOMIC_RELAXED) > 0; attempts++){
+		cpriqueue_lane_t* first = &q->lanes[random_lane(q)];
+		cpriqueue_lane_t* second = &q->lanes[random_lane(q)];
+
+		if(__atomic_load_n(&first->top, __ATOMIC_ACQUIRE) == NULL){
+			first = second;
+		}
+		if(__atomic_load_n(&first->top, __ATOMIC_ACQUIRE) == NULL){
+			continue;
+		}
+		if(first == second || __atomic_load_n(&second->top, __ATOMIC_ACQUIRE) == NULL){
+			second = NULL;
+		}
+
+		if(pthread_mutex_trylock(&first->lock) != 0){
+			continue;
+		}
+		if(second != NULL && pthread_mutex_trylock(&second->lock) != 0){
+			second = NULL;
+		}
+
+		cpriqueue_lane_t* best = first;
+		if(second != NULL && priqueue_peek(&second->queue) != NULL &&
+				(priqueue_peek(&first->queue) == NULL || q->compare(priqueue_peek(&second->queue), priqueue_peek(&first->queue)) < 0)){
+			best = second;
+		}
+
+		to_return = priqueue_poll(&best->queue);
+		update_top(best);
+
+		if(second != NULL){
+			pthread_mutex_unlock(&second->lock);
+		}
+		pthread_mutex_unlock(&first->lock);
+
+		if(to_return != NULL){
+			__atomic_sub_fetch(&q->size, 1, __ATOMIC_RELAXED);
+			return to_return;
+		}
+	}
+
+	// Nearly empty or heavily contended: sweep every lane before reporting empty
+	for(int i=0; i<q->lane_count && to_return == NULL; i++){
+		cpriqueue_lane_t* lane = &q->lanes[i];
+		pthread_mutex_lock(&lane->lock);
+		to_return = priqueue_poll(&lane->queue);
+		update_top(lane);
+		pthread_mutex_unlock(&lane->lock);
+	}
+
+	if(to_return != NULL){
+		__atomic_sub_fetch(&q->size, 1, __ATOMIC_RELAXED);
+	}
+	return to_return;
+}
+
+
+/**
+  Returns the element at the specified position in the merged order of all
+  lanes, or NULL if the queue does not contain an index'th element.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param index position of retrieved element
+  @return the index'th element in the queue
+  @return NULL if the queue does not contain the index'th element
+ */
+void *cpriqueue_at(cpriqueue_t *q, int index)
+{
+	int lane, lane_index;
+
+	lock_all(q);
+	void* to_return = merged_at(q, index, &lane, &lane_index, NULL);
+	unlock_all(q);
+
+	return to_return;
+}
+
+
+/**
+  Copies every element of the queue, in merged order, into ptrs. Each lane
+  is walked once, so this is much cheaper than cpriqueue_at over every
+  index.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param ptrs an array with room for cpriqueue_size(q) elements
+  @return the number of elements copied
+ */
+int cpriqueue_to_array(cpriqueue_t *q, void **ptrs)
+{
+	int lane, lane_index;
+	int count = 0;
+
+	lock_all(q);
+	for(int i=0; i<q->lane_count; i++){
+		count = count + priqueue_size(&q->lanes[i].queue);
+	}
+	merged_at(q, count, &lane, &lane_index, ptrs);
+	unlock_all(q);
+
+	return count;
+}
+
+
+/**
+  Removes all instances of ptr from the queue.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param ptr address of element to be removed
+  @return the number of entries removed
+ */
+int cpriqueue_remove(cpriqueue_t *q, void *ptr)
+{
+	int hits = 0;
+
+	for(int i=0; i<q->lane_count; i++){
+		cpriqueue_lane_t* lane = &q->lanes[i];
+		pthread_mutex_lock(&lane->lock);
+		hits = hits + priqueue_remove(&lane->queue, ptr);
+		update_top(lane);
+		pthread_mutex_unlock(&lane->lock);
+	}
+
+	__atomic_sub_fetch(&q->size, hits, __ATOMIC_RELAXED);
+	return hits;
+}
+
+
+/**
+  Removes the element at the specified position in the merged order of all
+  lanes.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param index position of element to be removed
+  @return the element removed from the queue
+  @return NULL if the specified index does not exist
+ */
+void *cpriqueue_remove_at(cpriqueue_t *q, int index)
+{
+	int lane, lane_index;
+
+	lock_all(q);
+	void* to_return = merged_at(q, index, &lane, &lane_index, NULL);
+	if(to_return != NULL){
+		priqueue_remove_at(&q->lanes[lane].queue, lane_index);
+		update_top(&q->lanes[lane]);
+		__atomic_sub_fetch(&q->size, 1, __ATOMIC_RELAXED);
+	}
+	unlock_all(q);
+
+	return to_return;
+}
+
+
+/**
+  Returns the number of elements in the queue.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @return the number of elements in the queue
+ */
+int cpriqueue_size(cpriqueue_t *q)
+{
+	return __atomic_load_n(&q->size, __ATOMIC_RELAXED);
+}
+
+
+/**
+  Destroys and frees all the memory associated with q. No other thread may be
+  using the queue.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+ */
+void cpriqueue_destroy(cpriqueue_t *q)
+{
+	for(int i=0; i<q->lane_count; i++){
+		priqueue_destroy(&q->lanes[i].queue);
+		pthread_mutex_destroy(&q->lanes[i].lock);
+	}
+	free(q->lanes);
+}
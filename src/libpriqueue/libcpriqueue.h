@@ -0,0 +1,51 @@
+/** @file libcpriqueue.h
+ */
+
+#ifndef LIBCPRIQUEUE_H_
+#define LIBCPRIQUEUE_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "libpriqueue.h"
+
+/**
+  One lane of a concurrent priqueue: an ordinary priqueue_t behind its own
+  lock, padded out to a cache line so neighbouring lanes do not share one.
+*/
+typedef struct _cpriqueue_lane_t
+{
+  pthread_mutex_t lock;
+  priqueue_t queue;
+  void* top;
+
+} __attribute__((aligned(64))) cpriqueue_lane_t;
+
+
+/**
+  Concurrent Priqueue Data Structure
+*/
+typedef struct _cpriqueue_t
+{
+  cpriqueue_lane_t* lanes;
+  int lane_count;
+  int size;
+  compare_function_t compare;
+
+} cpriqueue_t;
+
+
+void   cpriqueue_init     (cpriqueue_t *q, int lanes, int(*comparer)(const void *, const void *));
+
+int    cpriqueue_offer    (cpriqueue_t *q, void *ptr);
+void * cpriqueue_peek     (cpriqueue_t *q);
+void * cpriqueue_poll     (cpriqueue_t *q);
+void * cpriqueue_at       (cpriqueue_t *q, int index);
+int    cpriqueue_remove   (cpriqueue_t *q, void *ptr);
+void * cpriqueue_remove_at(cpriqueue_t *q, int index);
+int    cpriqueue_size     (cpriqueue_t *q);
+int    cpriqueue_to_array (cpriqueue_t *q, void **ptrs);
+
+void   cpriqueue_destroy  (cpriqueue_t *q);
+
+#endif /* LIBCPRIQUEUE_H_ */
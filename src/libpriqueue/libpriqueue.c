@@ -3,8 +3,10 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "stdbool.h"
+#define LIBPRIQUEUE_IMPLEMENTATION
 #include "libpriqueue.h"
 
 
@@ -24,6 +26,309 @@ void priqueue_init(priqueue_t *q, int(*comparer)(const void *, const void *))
   q->tail = NULL;
   q->size = 0;
   q->compare = comparer;
+  q->backend = PRIQUEUE_LIST;
+  q->key = NULL;
+  q->entries = NULL;
+  q->ring = NULL;
+  q->heap = NULL;
+  q->next_seq = 0;
+  q->sorted = 1;
+  q->first = 0;
+  q->capacity = 0;
+}
+
+
+/**
+  Initializes the priqueue_t data structure to order its elements by a
+  precomputed 64-bit key instead of a comparer.
+
+  The elements are kept in a sorted array along with their keys, so ordering
+  them takes integer comparisons rather than calls through a function
+  pointer, and priqueue_at is constant time. The key of an element is
+  computed once, when it is offered, so it must not change while the element
+  is in the queue.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param key a function pointer that maps an element to its key.
+ */
+void priqueue_init_keyed(priqueue_t *q, uint64_t(*key)(const void *))
+{
+	priqueue_init(q, NULL);
+	q->backend = PRIQUEUE_KEYED;
+	q->key = key;
+	q->capacity = 16;
+	q->entries = malloc(q->capacity * sizeof(priqueue_entry_t));
+}
+
+
+static int keyed_offer(priqueue_t *q, void *ptr){
+	uint64_t key = q->key(ptr);
+
+	// Find the first entry with a greater key, so equal keys stay in the order they were offered
+	const priqueue_entry_t* base = q->entries + q->first;
+	int length = q->size;
+	while(length > 0){
+		int half = length / 2;
+		int greater = base[half].key > key;
+		base = greater ? base : base + half + 1;
+		length = greater ? half : length - half - 1;
+	}
+	int low = base - q->entries;
+
+	// Make room by shifting whichever side of the insertion point is shorter
+	if(q->first > 0 && low - q->first < (int)q->size / 2){
+		memmove(q->entries + q->first - 1, q->entries + q->first, (low - q->first) * sizeof(priqueue_entry_t));
+		q->first = q->first - 1;
+		low = low - 1;
+	}
+	else{
+		if(q->first + (int)q->size == q->capacity){
+			if((int)q->size * 2 > q->capacity){
+				q->capacity = q->capacity * 2;
+				q->entries = realloc(q->entries, q->capacity * sizeof(priqueue_entry_t));
+			}
+
+			// Recentre the entries, leaving room to grow at both ends
+			int first = (q->capacity - q->size) / 2;
+			memmove(q->entries + first, q->entries + q->first, q->size * sizeof(priqueue_entry_t));
+			low = low - q->first + first;
+			q->first = first;
+		}
+		memmove(q->entries + low + 1, q->entries + low, (q->first + q->size - low) * sizeof(priqueue_entry_t));
+	}
+
+	q->entries[low].key = key;
+	q->entries[low].value = ptr;
+	q->size = q->size + 1;
+
+	return low - q->first;
+}
+
+
+static void* keyed_remove_at(priqueue_t *q, int index){
+	void* to_return = q->entries[q->first + index].value;
+
+	if(index == 0){
+		q->first = q->first + 1;
+	}
+	else{
+		memmove(q->entries + q->first + index, q->entries + q->first + index + 1, (q->size - index - 1) * sizeof(priqueue_entry_t));
+	}
+
+	q->size = q->size - 1;
+	if(q->size == 0){
+		q->first = 0;
+	}
+	return to_return;
+}
+
+
+/**
+  Initializes the priqueue_t data structure as a growable ring buffer, for
+  comparers under which elements are mostly offered in order, such as
+  first-come first-served or round robin. An element that belongs at the
+  tail is appended in constant time, polling the head is constant time, and
+  priqueue_at is constant time. An element offered out of order is placed
+  exactly where the list would place it, at linear cost.
+
+  The comparer must order elements consistently, so that an element that
+  does not belong before the tail does not belong before any other element.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+ */
+void priqueue_init_ring(priqueue_t *q, int(*comparer)(const void *, const void *))
+{
+	priqueue_init(q, comparer);
+	q->backend = PRIQUEUE_RING;
+	q->capacity = 16;
+	q->ring = malloc(q->capacity * sizeof(void*));
+}
+
+
+/**
+  Position of the index'th element in the ring. The capacity is always a
+  power of two.
+ */
+static inline int ring_slot(priqueue_t *q, int index){
+	return (q->first + index) & (q->capacity - 1);
+}
+
+
+static int ring_offer(priqueue_t *q, void *ptr){
+	if((int)q->size == q->capacity){
+		void** ring = malloc(2 * q->capacity * sizeof(void*));
+		for(int i=0; i<(int)q->size; i++){
+			ring[i] = q->ring[ring_slot(q, i)];
+		}
+		free(q->ring);
+		q->ring = ring;
+		q->first = 0;
+		q->capacity = q->capacity * 2;
+	}
+
+	// Same place as the list would pick: before the first element ptr belongs before
+	int index = q->size;
+	if(q->size > 0 && q->compare(ptr, q->ring[ring_slot(q, q->size - 1)]) < 0){
+		index = 0;
+		while(!(q->compare(ptr, q->ring[ring_slot(q, index)]) < 0)){
+			index = index + 1;
+		}
+	}
+
+	// Make room by shifting whichever side of the insertion point is shorter
+	if(index < (int)q->size / 2){
+		q->first = (q->first - 1) & (q->capacity - 1);
+		for(int i=0; i<index; i++){
+			q->ring[ring_slot(q, i)] = q->ring[ring_slot(q, i + 1)];
+		}
+	}
+	else{
+		for(int i=q->size; i>index; i--){
+			q->ring[ring_slot(q, i)] = q->ring[ring_slot(q, i - 1)];
+		}
+	}
+
+	q->ring[ring_slot(q, index)] = ptr;
+	q->size = q->size + 1;
+
+	return index;
+}
+
+
+static void* ring_remove_at(priqueue_t *q, int index){
+	void* to_return = q->ring[ring_slot(q, index)];
+
+	if(index < (int)q->size / 2){
+		for(int i=index; i>0; i--){
+			q->ring[ring_slot(q, i)] = q->ring[ring_slot(q, i - 1)];
+		}
+		q->first = ring_slot(q, 1);
+	}
+	else{
+		for(int i=index; i<(int)q->size - 1; i++){
+			q->ring[ring_slot(q, i)] = q->ring[ring_slot(q, i + 1)];
+		}
+	}
+
+	q->size = q->size - 1;
+	return to_return;
+}
+
+
+/**
+  Initializes the priqueue_t data structure as a binary min-heap of
+  precomputed 64-bit keys, for queues that are mostly offered to and polled,
+  in no particular order. Offering and polling are logarithmic. Looking at
+  any element but the head (priqueue_at, iterating, removing) first sorts
+  the heap in place, which leaves a valid heap, so visiting the queue in
+  order costs one sort until it next changes.
+
+  As with priqueue_init_keyed, the key of an element must not change while
+  it is in the queue, and equal keys keep the order they were offered in.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param key a function pointer that maps an element to its key.
+ */
+void priqueue_init_heap(priqueue_t *q, uint64_t(*key)(const void *))
+{
+	priqueue_init(q, NULL);
+	q->backend = PRIQUEUE_HEAP;
+	q->key = key;
+	q->capacity = 16;
+	q->heap = malloc(q->capacity * sizeof(priqueue_heap_entry_t));
+}
+
+
+static inline int heap_less(const priqueue_heap_entry_t *a, const priqueue_heap_entry_t *b){
+	return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+
+static int heap_entry_compare(const void *a, const void *b){
+	return heap_less(a, b) ? -1 : heap_less(b, a);
+}
+
+
+static void heap_sift_down(priqueue_t *q, int index){
+	priqueue_heap_entry_t entry = q->heap[index];
+
+	while(2 * index + 1 < (int)q->size){
+		int child = 2 * index + 1;
+		if(child + 1 < (int)q->size && heap_less(&q->heap[child + 1], &q->heap[child])){
+			child = child + 1;
+		}
+		if(!heap_less(&q->heap[child], &entry)){
+			break;
+		}
+		q->heap[index] = q->heap[child];
+		index = child;
+	}
+	q->heap[index] = entry;
+}
+
+
+/**
+  Sorts the heap, so the index'th entry is the index'th element in order.
+ */
+static void heap_sort(priqueue_t *q){
+	if(!q->sorted){
+		qsort(q->heap, q->size, sizeof(priqueue_heap_entry_t), heap_entry_compare);
+		q->sorted = 1;
+	}
+}
+
+
+static int heap_offer(priqueue_t *q, void *ptr){
+	if((int)q->size == q->capacity){
+		q->capacity = q->capacity * 2;
+		q->heap = realloc(q->heap, q->capacity * sizeof(priqueue_heap_entry_t));
+	}
+
+	priqueue_heap_entry_t entry = { q->key(ptr), q->next_seq++, ptr };
+	int index = q->size;
+
+	// An entry that belongs after every other one keeps a sorted heap sorted
+	if(index > 0 && heap_less(&entry, &q->heap[index - 1])){
+		q->sorted = 0;
+	}
+
+	while(index > 0 && heap_less(&entry, &q->heap[(index - 1) / 2])){
+		q->heap[index] = q->heap[(index - 1) / 2];
+		index = (index - 1) / 2;
+	}
+	q->heap[index] = entry;
+	q->size = q->size + 1;
+
+	return index;
+}
+
+
+static void* heap_poll(priqueue_t *q){
+	void* to_return = q->heap[0].value;
+
+	q->size = q->size - 1;
+	if(q->size > 0){
+		if(q->sorted){
+			memmove(q->heap, q->heap + 1, q->size * sizeof(priqueue_heap_entry_t));
+		}
+		else{
+			q->heap[0] = q->heap[q->size];
+			heap_sift_down(q, 0);
+		}
+	}
+	return to_return;
+}
+
+
+static void* heap_remove_at(priqueue_t *q, int index){
+	heap_sort(q);
+
+	// Closing the gap in a sorted array leaves it sorted
+	void* to_return = q->heap[index].value;
+	memmove(q->heap + index, q->heap + index + 1, (q->size - index - 1) * sizeof(priqueue_heap_entry_t));
+	q->size = q->size - 1;
+	return to_return;
 }
 
 
@@ -32,10 +337,20 @@ void priqueue_init(priqueue_t *q, int(*comparer)(const void *, const void *))
 
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr a pointer to the data to be inserted into the priority queue
-  @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue.
+  @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue. A heap returns the position in the heap, which is only the position in the queue when it is 0.
  */
 int priqueue_offer(priqueue_t *q, void *ptr)
 {
+	if(q->backend == PRIQUEUE_KEYED){
+		return keyed_offer(q, ptr);
+	}
+	if(q->backend == PRIQUEUE_HEAP){
+		return heap_offer(q, ptr);
+	}
+	if(q->backend == PRIQUEUE_RING){
+		return ring_offer(q, ptr);
+	}
+
 	node_t* new_node = malloc(sizeof(node_t));
 	new_node->prev_node = NULL;
 	new_node->next_node = NULL;
@@ -85,6 +400,103 @@ int priqueue_offer(priqueue_t *q, void *ptr)
 }
 
 
+/**
+  Stable merge sort of ptrs that only asks whether an element belongs
+  strictly before another, the same question priqueue_offer asks, so equal
+  elements keep the order they were given in.
+ */
+static void sort_offers(priqueue_t *q, void **ptrs, void **scratch, int n)
+{
+	if(n < 2){
+		return;
+	}
+
+	int half = n / 2;
+	sort_offers(q, ptrs, scratch, half);
+	sort_offers(q, ptrs + half, scratch, n - half);
+
+	int left = 0, right = half, out = 0;
+	while(left < half && right < n){
+		if(q->compare(ptrs[right], ptrs[left]) < 0){
+			scratch[out++] = ptrs[right++];
+		}
+		else{
+			scratch[out++] = ptrs[left++];
+		}
+	}
+	while(left < half){
+		scratch[out++] = ptrs[left++];
+	}
+	while(right < n){
+		scratch[out++] = ptrs[right++];
+	}
+
+	for(int i=0; i<n; i++){
+		ptrs[i] = scratch[i];
+	}
+}
+
+
+/**
+  Inserts n elements into this priority queue at once. The elements are
+  sorted, then merged into the queue in a single pass, leaving the queue in
+  the same order as n calls to priqueue_offer in array order would.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptrs the elements to be inserted. The array is reordered.
+  @param n the number of elements in ptrs
+ */
+void priqueue_offer_all(priqueue_t *q, void **ptrs, int n)
+{
+	if(q->backend == PRIQUEUE_KEYED || q->backend == PRIQUEUE_HEAP){
+		for(int i=0; i<n; i++){
+			priqueue_offer(q, ptrs[i]);
+		}
+		return;
+	}
+
+	void** scratch = malloc(n * sizeof(void*));
+	sort_offers(q, ptrs, scratch, n);
+	free(scratch);
+
+	if(q->backend == PRIQUEUE_RING){
+		for(int i=0; i<n; i++){
+			ring_offer(q, ptrs[i]);
+		}
+		return;
+	}
+
+	node_t* temp_node = q->head;
+	for(int i=0; i<n; i++){
+		node_t* new_node = malloc(sizeof(node_t));
+		new_node->value = ptrs[i];
+
+		// Elements of ptrs are sorted, so each insertion point is at or after the previous one
+		while(temp_node != NULL && !(q->compare(new_node->value, temp_node->value) < 0)){
+			temp_node = temp_node->next_node;
+		}
+
+		new_node->next_node = temp_node;
+		if(temp_node == NULL){
+			new_node->prev_node = q->tail;
+			q->tail = new_node;
+		}
+		else{
+			new_node->prev_node = temp_node->prev_node;
+			temp_node->prev_node = new_node;
+		}
+		if(new_node->prev_node == NULL){
+			q->head = new_node;
+		}
+		else{
+			new_node->prev_node->next_node = new_node;
+		}
+	}
+
+	q->size = q->size + n;
+}
+
+
 /**
   Retrieves, but does not remove, the head of this queue, returning NULL if
   this queue is empty.
@@ -95,6 +507,16 @@ int priqueue_offer(priqueue_t *q, void *ptr)
  */
 void *priqueue_peek(priqueue_t *q)
 {
+	if(q->backend == PRIQUEUE_KEYED){
+		return q->size ? q->entries[q->first].value : NULL;
+	}
+	if(q->backend == PRIQUEUE_RING){
+		return q->size ? q->ring[q->first] : NULL;
+	}
+	if(q->backend == PRIQUEUE_HEAP){
+		return q->size ? q->heap[0].value : NULL;
+	}
+
 	if(q->head == NULL){
 		return NULL;
 	}
@@ -114,6 +536,16 @@ void *priqueue_peek(priqueue_t *q)
  */
 void *priqueue_poll(priqueue_t *q)
 {
+	if(q->backend == PRIQUEUE_KEYED){
+		return q->size ? keyed_remove_at(q, 0) : NULL;
+	}
+	if(q->backend == PRIQUEUE_RING){
+		return q->size ? ring_remove_at(q, 0) : NULL;
+	}
+	if(q->backend == PRIQUEUE_HEAP){
+		return q->size ? heap_poll(q) : NULL;
+	}
+
 	void* to_return = NULL;
 	if(q->head == NULL){
 			// to_return = NULL;
@@ -148,6 +580,20 @@ void *priqueue_poll(priqueue_t *q)
  */
 void *priqueue_at(priqueue_t *q, int index)
 {
+	if(q->backend == PRIQUEUE_KEYED){
+		return (index >= 0 && index < (int)q->size) ? q->entries[q->first + index].value : NULL;
+	}
+	if(q->backend == PRIQUEUE_RING){
+		return (index >= 0 && index < (int)q->size) ? q->ring[ring_slot(q, index)] : NULL;
+	}
+	if(q->backend == PRIQUEUE_HEAP){
+		if(index < 0 || index >= (int)q->size){
+			return NULL;
+		}
+		heap_sort(q);
+		return q->heap[index].value;
+	}
+
 	void* to_return = NULL;
 	if(q->head == NULL || index >= q->size || index < 0){
 		// return NULL;
@@ -183,6 +629,35 @@ void *priqueue_at(priqueue_t *q, int index)
 int priqueue_remove(priqueue_t *q, void *ptr)
 {
 	int hits = 0;
+	if(q->backend == PRIQUEUE_KEYED){
+		for(int i=q->size-1; i>=0; i--){
+			if(q->entries[q->first + i].value == ptr){
+				keyed_remove_at(q, i);
+				hits = hits+1;
+			}
+		}
+		return hits;
+	}
+	if(q->backend == PRIQUEUE_RING){
+		for(int i=q->size-1; i>=0; i--){
+			if(q->ring[ring_slot(q, i)] == ptr){
+				ring_remove_at(q, i);
+				hits = hits+1;
+			}
+		}
+		return hits;
+	}
+	if(q->backend == PRIQUEUE_HEAP){
+		heap_sort(q);
+		for(int i=q->size-1; i>=0; i--){
+			if(q->heap[i].value == ptr){
+				heap_remove_at(q, i);
+				hits = hits+1;
+			}
+		}
+		return hits;
+	}
+
 	if(q->head == NULL){
 		//hits = 0;
 	}
@@ -204,10 +679,17 @@ int priqueue_remove(priqueue_t *q, void *ptr)
 				}
 				else{
 					temp_prev->next_node = temp_next;
-					temp_next->prev_node = temp_prev;
+					if(temp_next != NULL){
+						temp_next->prev_node = temp_prev;
+					}
+					else{
+						q->tail = temp_prev;
+					}
 				}
 
 				free(temp_node);
+				temp_node = temp_next;
+				continue;
 			}
 			temp_node = temp_node->next_node;
 		}
@@ -229,6 +711,16 @@ int priqueue_remove(priqueue_t *q, void *ptr)
  */
 void *priqueue_remove_at(priqueue_t *q, int index)
 {
+	if(q->backend == PRIQUEUE_KEYED){
+		return (index >= 0 && index < (int)q->size) ? keyed_remove_at(q, index) : NULL;
+	}
+	if(q->backend == PRIQUEUE_RING){
+		return (index >= 0 && index < (int)q->size) ? ring_remove_at(q, index) : NULL;
+	}
+	if(q->backend == PRIQUEUE_HEAP){
+		return (index >= 0 && index < (int)q->size) ? heap_remove_at(q, index) : NULL;
+	}
+
 	void* to_return = NULL;
 	if(q->head == NULL || index < 0 || index >= q->size){
 		//to_return = NULL;
@@ -252,10 +744,17 @@ void *priqueue_remove_at(priqueue_t *q, int index)
 				}
 				else{
 					temp_prev->next_node = temp_next;
-					temp_next->prev_node = temp_prev;
+					if(temp_next != NULL){
+						temp_next->prev_node = temp_prev;
+					}
+					else{
+						q->tail = temp_prev;
+					}
 				}
 
 				free(temp_node);
+				q->size = q->size -1;
+				break;
 			}
 			temp_node = temp_node->next_node;
 			i = i+1;
@@ -278,6 +777,68 @@ int priqueue_size(priqueue_t *q)
 }
 
 
+/**
+  Starts iterating over the queue from its head.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param it the iterator to position at the head of q
+ */
+void priqueue_iterator(priqueue_t *q, priqueue_iterator_t *it)
+{
+	it->queue = q;
+	it->node = q->head;
+	it->index = 0;
+}
+
+
+/**
+  Returns the element at the iterator's position and moves it on to the
+  next one, in the same order as priqueue_at.
+
+  @param it an iterator started with priqueue_iterator
+  @return the next element of the queue
+  @return NULL if every element has been visited
+ */
+void *priqueue_next(priqueue_iterator_t *it)
+{
+	priqueue_t* q = it->queue;
+	void* to_return = NULL;
+
+	if(it->index >= (int)q->size){
+		return NULL;
+	}
+
+	if(q->backend == PRIQUEUE_LIST){
+		to_return = it->node->value;
+		it->node = it->node->next_node;
+	}
+	else{
+		to_return = priqueue_at(q, it->index);
+	}
+	it->index = it->index + 1;
+
+	return to_return;
+}
+
+
+/**
+  Copies every element of the queue, in order, into ptrs.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptrs an array with room for priqueue_size(q) elements
+  @return the number of elements copied
+ */
+int priqueue_to_array(priqueue_t *q, void **ptrs)
+{
+	priqueue_iterator_t it;
+	priqueue_iterator(q, &it);
+	for(int i=0; i<(int)q->size; i++){
+		ptrs[i] = priqueue_next(&it);
+	}
+	return q->size;
+}
+
+
 /**
   Destroys and frees all the memory associated with q.
 
@@ -288,5 +849,12 @@ void priqueue_destroy(priqueue_t *q)
 	while(q->head != NULL){
 		priqueue_poll(q);
 	}
+	free(q->entries);
+	free(q->ring);
+	free(q->heap);
+	q->entries = NULL;
+	q->ring = NULL;
+	q->heap = NULL;
+	q->size = 0;
 	// free(q);
 }
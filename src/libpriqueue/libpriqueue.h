@@ -4,11 +4,40 @@
 #ifndef LIBPRIQUEUE_H_
 #define LIBPRIQUEUE_H_
 
+#include <stdint.h>
+#include <sys/types.h>
+
 /**
   Priqueue Data Structure
 */
 typedef int (*compare_function_t) ( const void *a, const void *b);
 
+/**
+  Maps an element to a 64-bit key, smaller keys first. Equal keys keep the
+  order they were offered in.
+*/
+typedef uint64_t (*key_function_t) ( const void *a);
+
+/**
+  How a priqueue stores its elements
+*/
+typedef enum {PRIQUEUE_LIST = 0, PRIQUEUE_KEYED, PRIQUEUE_RING, PRIQUEUE_HEAP} priqueue_backend_t;
+
+typedef struct _priqueue_entry_t
+{
+  uint64_t key;
+  void* value;
+
+} priqueue_entry_t;
+
+typedef struct _priqueue_heap_entry_t
+{
+  uint64_t key;
+  uint64_t seq;    // offer order, so equal keys leave in the order they came
+  void* value;
+
+} priqueue_heap_entry_t;
+
 typedef struct _node_t
 {
   struct _node_t* prev_node;
@@ -25,12 +54,40 @@ typedef struct _priqueue_t
   uint size;
   compare_function_t compare;
 
+  priqueue_backend_t backend;
+  key_function_t key;
+  priqueue_entry_t* entries;  // keyed: sorted by key in entries[first .. first+size)
+  void** ring;                // ring: in order from ring[first], wrapping around at capacity
+  priqueue_heap_entry_t* heap; // heap: binary min-heap, fully sorted while sorted is set
+  uint64_t next_seq;
+  int sorted;
+  int first;
+  int capacity;
+
 } priqueue_t;
 
 
+/**
+  A position in a priqueue, for visiting its elements in order without
+  finding each one from the head again. The queue must not change while it
+  is being visited.
+*/
+typedef struct _priqueue_iterator_t
+{
+  priqueue_t* queue;
+  node_t* node;
+  int index;
+
+} priqueue_iterator_t;
+
+
 void   priqueue_init     (priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_init_keyed(priqueue_t *q, uint64_t(*key)(const void *));
+void   priqueue_init_ring(priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_init_heap(priqueue_t *q, uint64_t(*key)(const void *));
 
 int    priqueue_offer    (priqueue_t *q, void *ptr);
+void   priqueue_offer_all(priqueue_t *q, void **ptrs, int n);
 void * priqueue_peek     (priqueue_t *q);
 void * priqueue_poll     (priqueue_t *q);
 void * priqueue_at       (priqueue_t *q, int index);
@@ -38,6 +95,31 @@ int    priqueue_remove   (priqueue_t *q, void *ptr);
 void * priqueue_remove_at(priqueue_t *q, int index);
 int    priqueue_size     (priqueue_t *q);
 
+void   priqueue_iterator (priqueue_t *q, priqueue_iterator_t *it);
+void * priqueue_next     (priqueue_iterator_t *it);
+int    priqueue_to_array (priqueue_t *q, void **ptrs);
+
 void   priqueue_destroy  (priqueue_t *q);
 
+/**
+  With -DSCHED_INSTRUMENT every queue operation made outside libpriqueue.c is
+  timed. A function-like macro is not expanded again inside its own
+  replacement, so each wrapper still calls the real function.
+*/
+#if defined(SCHED_INSTRUMENT) && !defined(LIBPRIQUEUE_IMPLEMENTATION)
+#include "../libinstrument/libinstrument.h"
+
+#define priqueue_offer(q, ptr)         INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_OFFER, priqueue_offer(q, ptr))
+#define priqueue_offer_all(q, ptrs, n) INSTRUMENT_VOID_CALL(INSTRUMENT_PRIQUEUE_OFFER_ALL, priqueue_offer_all(q, ptrs, n))
+#define priqueue_peek(q)               INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_PEEK, priqueue_peek(q))
+#define priqueue_poll(q)               INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_POLL, priqueue_poll(q))
+#define priqueue_at(q, index)          INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_AT, priqueue_at(q, index))
+#define priqueue_remove(q, ptr)        INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_REMOVE, priqueue_remove(q, ptr))
+#define priqueue_remove_at(q, index)   INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_REMOVE_AT, priqueue_remove_at(q, index))
+#define priqueue_size(q)               INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_SIZE, priqueue_size(q))
+#define priqueue_iterator(q, it)       INSTRUMENT_VOID_CALL(INSTRUMENT_PRIQUEUE_ITERATOR, priqueue_iterator(q, it))
+#define priqueue_next(it)              INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_NEXT, priqueue_next(it))
+#define priqueue_to_array(q, ptrs)     INSTRUMENT_CALL(INSTRUMENT_PRIQUEUE_TO_ARRAY, priqueue_to_array(q, ptrs))
+#endif
+
 #endif /* LIBPQUEUE_H_ */
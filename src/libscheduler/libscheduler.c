@@ -4,9 +4,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
+#define LIBSCHEDULER_IMPLEMENTATION
 #include "libscheduler.h"
+#include "libvictim.h"
 #include "../libpriqueue/libpriqueue.h"
+#include "../libcheckpoint/libcheckpoint.h"
+#include "../libinstrument/libinstrument.h"
 
 
 /**
@@ -26,27 +31,99 @@ typedef struct _job_t
 	int id;
 	int arrival_time;
 	int used_time;
+	int used_carry;       // hundredths of a time unit done beyond used_time, left over by cores of other speeds
 	int remaining_time;
 	int needed_time;
 	int last_start_time;
 	int time_to_schedule;
 	int priority;
+	int last_core;
+	int last_stop_time;
+	int cores_needed;
+	int ready_time;       // when the job last became ready: its arrival, or the end of its last I/O burst
+	int cpu_time_done;    // CPU time of the bursts finished before the current one
+	int io_time;          // time spent blocked on I/O
+	uint64_t pass;        // STRIDE: service so far, weighted by stride; the lowest pass runs next
+	uint64_t stride;      // STRIDE: pass added per time unit of service, inversely proportional to tickets
+	int slot;             // LOTTERY: position in the ticket tree while queued, -1 otherwise
+	uint64_t queued_seq;  // LOTTERY: order in which the job joined the queue, to list queued jobs by
+	int group;            // the tenant group the job belongs to, 0 when groups are off
 } job_t;
 
-typedef struct _scheduler_t
+/**
+  The pass a job with a single ticket advances by per time unit of service
+*/
+#define STRIDE_ONE (1 << 20)
+
+/**
+  A tenant group with its own ready queue. Groups share the cores by weight:
+  each group's vruntime advances by its service divided by its weight, and
+  the next job comes from the group with the lowest vruntime.
+*/
+typedef struct _group_t
+{
+	int id;
+	int weight;
+	uint64_t vruntime;    // service so far in units of STRIDE_ONE per time unit, divided by weight
+	priqueue_t queue;
+	int heap_index;       // position in group_heap while the group has queued jobs, -1 otherwise
+	scheduler_group_stats_t stats;
+} group_t;
+
+struct _scheduler_t
 {
 	int total_jobs;
 	int num_cores;
 	float total_wait;
 	float total_turnaround;
 	float total_response;
+	scheduler_job_stats_t last_finished;
 	scheme_t scheme;
 	priqueue_t* priqueue;
 	job_t** core_array;
-
-} scheduler_t;
-
-scheduler_t* scheduler;
+	scheduler_core_stats_t* core_stats;
+	int* busy_since;
+	int* work_since;            // when the job on each core starts working: busy_since, plus any switch stall
+	int* last_job;
+	int max_queue_depth;
+	int affinity_window;
+	int* core_speed;
+	int* core_socket;
+	int num_sockets;
+	backfill_t backfill;
+	int gang_time;
+	int fragmented_time;
+	int backfilled;
+	job_t** blocked;
+	int blocked_count;
+	int blocked_capacity;
+	uint64_t global_pass;
+	uint64_t rng;
+	int64_t* lottery_tree;      // Fenwick tree of the tickets held by each slot, 1-based
+	job_t** lottery_slot;
+	int* lottery_free;
+	int lottery_free_count;
+	int lottery_capacity;
+	int64_t lottery_total;
+	uint64_t lottery_seq;       // queued_seq of the next job to join the queue
+	int grouped;                // jobs are queued per group, and groups take turns by weight
+	group_t** groups;           // indexed by group id
+	int group_count;
+	group_t** group_heap;       // groups with queued jobs, a min-heap on vruntime
+	int group_heap_size;
+	int group_queued;           // jobs queued over every group
+	uint64_t group_clock;       // vruntime of the latest group to run a job
+	int* run_remaining;         // packed keys of the job on each core, for the victim kernels:
+	int* run_carry;             //   its remaining time when dispatched and its used_carry, priority,
+	int* run_priority;          //   arrival time and group, -1 on an idle core
+	int* run_arrival;
+	int* run_group;
+	int* victim_keys;           // per-core scratch for the victim kernels
+	int* victim_ties;
+
+};
+
+static __thread scheduler_t* scheduler;
 /**
   Initalizes the scheduler.
 
@@ -64,7 +141,7 @@ int fcfs_compare(const void* x, const void* y){
 	job_t* job1 = (job_t*) x;
 	job_t* job2 = (job_t*) y;
 
-	return job1->arrival_time - job2->arrival_time;
+	return job1->ready_time - job2->ready_time;
 }
 
 int rr_compare(const void* x, const void* y){
@@ -77,7 +154,7 @@ int sjf_compare(const void* x, const void* y){
 	int to_return = job1->remaining_time - job2->remaining_time;
 
 	if(to_return == 0){
-		return job1->arrival_time - job2->arrival_time;
+		return job1->ready_time - job2->ready_time;
 	}
 	else{
 		return to_return;
@@ -90,7 +167,7 @@ int pri_compare(const void* x, const void* y){
 	int to_return = job1->priority - job2->priority;
 
 	if(to_return == 0){
-		return job1->arrival_time - job2->arrival_time;
+		return job1->ready_time - job2->ready_time;
 	}
 	else{
 		return to_return;
@@ -98,6 +175,119 @@ int pri_compare(const void* x, const void* y){
 
 }
 
+/*
+  Keys for the keyed queue backend, ordering jobs exactly as the comparers
+  above do. Fields are biased into unsigned range so negative values still
+  sort first.
+*/
+static uint64_t key_field(int value){
+	return (uint64_t)((uint32_t)value ^ 0x80000000u);
+}
+
+uint64_t fcfs_key(const void* x){
+	return key_field(((const job_t*) x)->ready_time);
+}
+
+uint64_t rr_key(const void* x){
+	return 0;
+}
+
+uint64_t sjf_key(const void* x){
+	const job_t* job = (const job_t*) x;
+	return key_field(job->remaining_time) << 32 | key_field(job->ready_time);
+}
+
+uint64_t pri_key(const void* x){
+	const job_t* job = (const job_t*) x;
+	return key_field(job->priority) << 32 | key_field(job->ready_time);
+}
+
+int stride_compare(const void* x, const void* y){
+	const job_t* job1 = (const job_t*) x;
+	const job_t* job2 = (const job_t*) y;
+
+	return (job1->pass > job2->pass) - (job1->pass < job2->pass);
+}
+
+uint64_t stride_key(const void* x){
+	return ((const job_t*) x)->pass;
+}
+
+
+static queue_backend_t queue_backend = QUEUE_RING;
+
+/**
+  Chooses how schedulers started from now on store their queue. Every
+  backend schedules exactly the same way; they only differ in speed. The
+  default, QUEUE_RING, keeps the FCFS, RR and LOTTERY queues in a ring
+  buffer, since jobs join those at the tail, the STRIDE queue in a heap,
+  since it is only ever polled, and the other schemes' in a sorted list.
+
+  @param backend the queue backend to use.
+ */
+void scheduler_set_queue_backend(queue_backend_t backend)
+{
+	queue_backend = backend;
+}
+
+
+/**
+  Initializes a ready queue ordered for scheme on the selected backend.
+*/
+static void init_queue(priqueue_t* queue, scheme_t scheme){
+	if(queue_backend == QUEUE_KEYED || queue_backend == QUEUE_HEAP || (queue_backend == QUEUE_RING && scheme == STRIDE)){
+		key_function_t key = pri_key;
+		if(scheme == FCFS || scheme == LOTTERY){
+			key = fcfs_key;
+		}
+		else if(scheme == RR){
+			key = rr_key;
+		}
+		else if(scheme == SJF || scheme == PSJF){
+			key = sjf_key;
+		}
+		else if(scheme == STRIDE){
+			key = stride_key;
+		}
+
+		if(queue_backend == QUEUE_KEYED){
+			priqueue_init_keyed(queue, key);
+		}
+		else{
+			priqueue_init_heap(queue, key);
+		}
+	}
+	else if(scheme == FCFS || scheme == LOTTERY){
+		if(queue_backend == QUEUE_RING){
+			priqueue_init_ring(queue, fcfs_compare);
+		}
+		else{
+			priqueue_init(queue, fcfs_compare);
+		}
+	}
+	else if(scheme == RR){
+		if(queue_backend == QUEUE_RING){
+			priqueue_init_ring(queue, rr_compare);
+		}
+		else{
+			priqueue_init(queue, rr_compare);
+		}
+	}
+	else if(scheme == SJF || scheme == PSJF){
+		priqueue_init(queue, sjf_compare);
+	}
+	else if(scheme == STRIDE){
+		priqueue_init(queue, stride_compare);
+	}
+	else if(scheme == PRI || scheme || PPRI){
+		priqueue_init(queue, pri_compare);
+	}
+	else{
+		priqueue_init(queue, fcfs_compare);
+	}
+}
+
+
 void scheduler_start_up(int cores, scheme_t scheme)
 {
 	scheduler = malloc(sizeof(scheduler_t));
@@ -109,242 +299,1331 @@ void scheduler_start_up(int cores, scheme_t scheme)
 	scheduler->scheme = scheme;
 	scheduler->priqueue = malloc(sizeof(priqueue_t));
 	scheduler->core_array = (job_t**) calloc(cores, sizeof(job_t*));
+	scheduler->core_stats = calloc(cores, sizeof(scheduler_core_stats_t));
+	scheduler->busy_since = calloc(cores, sizeof(int));
+	scheduler->work_since = calloc(cores, sizeof(int));
+	scheduler->last_job = malloc(cores * sizeof(int));
+	scheduler->max_queue_depth = 0;
+	scheduler->affinity_window = -1;
+	scheduler->core_speed = malloc(cores * sizeof(int));
+	scheduler->core_socket = calloc(cores, sizeof(int));
+	scheduler->num_sockets = 1;
+	scheduler->backfill = BACKFILL_EASY;
+	scheduler->gang_time = 0;
+	scheduler->fragmented_time = 0;
+	scheduler->backfilled = 0;
+	scheduler->blocked = NULL;
+	scheduler->blocked_count = 0;
+	scheduler->blocked_capacity = 0;
+	scheduler->global_pass = 0;
+	scheduler->lottery_tree = NULL;
+	scheduler->lottery_slot = NULL;
+	scheduler->lottery_free = NULL;
+	scheduler->lottery_free_count = 0;
+	scheduler->lottery_capacity = 0;
+	scheduler->lottery_total = 0;
+	scheduler->lottery_seq = 0;
+	scheduler->grouped = 0;
+	scheduler->groups = NULL;
+	scheduler->group_count = 0;
+	scheduler->group_heap = NULL;
+	scheduler->group_heap_size = 0;
+	scheduler->group_queued = 0;
+	scheduler->group_clock = 0;
+	scheduler->run_remaining = calloc(cores, sizeof(int));
+	scheduler->run_carry = calloc(cores, sizeof(int));
+	scheduler->run_priority = calloc(cores, sizeof(int));
+	scheduler->run_arrival = calloc(cores, sizeof(int));
+	scheduler->run_group = malloc(cores * sizeof(int));
+	scheduler->victim_keys = malloc(cores * sizeof(int));
+	scheduler->victim_ties = malloc(cores * sizeof(int));
+	scheduler_set_seed(1);
 
 	for (int i = 0; i < scheduler->num_cores; i++)
 	{
-		scheduler->core_array[i] = malloc(sizeof(job_t));
 		scheduler->core_array[i] = NULL;
+		scheduler->last_job[i] = -1;
+		scheduler->core_speed[i] = 100;
+		scheduler->run_group[i] = -1;
 	}
 
-	if(scheme == FCFS){
-		priqueue_init(scheduler->priqueue, fcfs_compare);
-	}
-	else if(scheme == RR){
-		priqueue_init(scheduler->priqueue, rr_compare);
+	init_queue(scheduler->priqueue, scheme);
+}
+
+
+/**
+  Whether group a should run before group b: the lower vruntime first, the
+  lower id among equals.
+*/
+static int group_before(const group_t* a, const group_t* b){
+	return a->vruntime < b->vruntime || (a->vruntime == b->vruntime && a->id < b->id);
+}
+
+
+static void group_heap_set(int index, group_t* group){
+	scheduler->group_heap[index] = group;
+	group->heap_index = index;
+}
+
+
+/**
+  Moves group up or down the group heap until it is in order again, after
+  its vruntime changed or it was put in a new position, in O(log groups).
+*/
+static void group_sift(group_t* group){
+	group_t** heap = scheduler->group_heap;
+	int i = group->heap_index;
+
+	while(i > 0 && group_before(group, heap[(i-1)/2])){
+		group_heap_set(i, heap[(i-1)/2]);
+		i = (i-1)/2;
 	}
-	else if(scheme == SJF || scheme == PSJF){
-		priqueue_init(scheduler->priqueue, sjf_compare);
+	while(2*i+1 < scheduler->group_heap_size){
+		int child = 2*i+1;
+		if(child+1 < scheduler->group_heap_size && group_before(heap[child+1], heap[child])){
+			child = child +1;
+		}
+		if(!group_before(heap[child], group)){
+			break;
+		}
+		group_heap_set(i, heap[child]);
+		i = child;
 	}
-	else if(scheme == PRI || scheme || PPRI){
-		priqueue_init(scheduler->priqueue, pri_compare);
+	group_heap_set(i, group);
+}
+
+
+/**
+  Adds a group whose queue has just become non-empty to the group heap. It
+  starts from the vruntime of the latest group to run, so a group cannot bank
+  the time it had nothing to run.
+*/
+static void group_activate(group_t* group){
+	if(group->vruntime < scheduler->group_clock){
+		group->vruntime = scheduler->group_clock;
 	}
-	else{
-		priqueue_init(scheduler->priqueue, fcfs_compare);
+	group->heap_index = scheduler->group_heap_size;
+	scheduler->group_heap[scheduler->group_heap_size++] = group;
+	group_sift(group);
+}
+
+
+/**
+  Accounts for a job just taken out of group's queue, dropping the group from
+  the group heap when its queue is empty.
+*/
+static void group_taken(group_t* group){
+	scheduler->group_queued = scheduler->group_queued -1;
+	if(priqueue_size(&group->queue) > 0){
+		return;
 	}
 
+	group_t* last = scheduler->group_heap[--scheduler->group_heap_size];
+	if(last != group){
+		group_heap_set(group->heap_index, last);
+		group_sift(last);
+	}
+	group->heap_index = -1;
 }
 
 
-void updateRemainingTimes(int time){
-	for(int i=0; i < scheduler->num_cores; i++){
-		if(scheduler->core_array[i] != NULL){
-			scheduler->core_array[i]->used_time = scheduler->core_array[i]->used_time + (time - scheduler->core_array[i]->last_start_time);
-			scheduler->core_array[i]->remaining_time = scheduler->core_array[i]->needed_time - scheduler->core_array[i]->used_time;
-			scheduler->core_array[i]->last_start_time = time;
+/**
+  Returns group id, creating it and every lower id not seen yet with a weight
+  of 1. Negative ids are taken as group 0.
+*/
+static group_t* find_group(int id){
+	if(id < 0){
+		id = 0;
+	}
+
+	if(id >= scheduler->group_count){
+		scheduler->groups = realloc(scheduler->groups, (id + 1) * sizeof(group_t*));
+		scheduler->group_heap = realloc(scheduler->group_heap, (id + 1) * sizeof(group_t*));
+		for(int i=scheduler->group_count; i<=id; i++){
+			group_t* group = malloc(sizeof(group_t));
+			group->id = i;
+			group->weight = 1;
+			group->vruntime = scheduler->group_clock;
+			init_queue(&group->queue, scheduler->scheme);
+			group->heap_index = -1;
+			memset(&group->stats, 0, sizeof(scheduler_group_stats_t));
+			scheduler->groups[i] = group;
 		}
+		scheduler->group_count = id + 1;
 	}
+
+	return scheduler->groups[id];
 }
 
+
 /**
-  Called when a new job arrives.
+  Copies the keys of the job on core core_id, if any, into the packed arrays
+  the victim kernels read.
+*/
+static void core_keys(int core_id){
+	job_t* job = scheduler->core_array[core_id];
+	if(job == NULL){
+		scheduler->run_group[core_id] = -1;
+		return;
+	}
+	scheduler->run_remaining[core_id] = job->needed_time - job->used_time;
+	scheduler->run_carry[core_id] = job->used_carry;
+	scheduler->run_priority[core_id] = job->priority;
+	scheduler->run_arrival[core_id] = job->arrival_time;
+	scheduler->run_group[core_id] = job->group;
+}
 
-  If multiple cores are idle, the job should be assigned to the core with the
-  lowest id.
-  If the job arriving should be scheduled to run during the next
-  time cycle, return the zero-based index of the core the job should be
-  scheduled on. If another job is already running on the core specified,
-  this will preempt the currently running job.
-  Assumptions:
-    - You may assume that every job wil have a unique arrival time.
 
-  @param job_number a globally unique identification number of the job arriving.
-  @param time the current time of the simulator.
-  @param running_time the total number of time units this job will run before it will be finished.
-  @param priority the priority of the job. (The lower the value, the higher the priority.)
-  @return index of core job should be scheduled on
-  @return -1 if no scheduling changes should be made.
+/**
+  Places job on core core_id at the given time, counting a context switch
+  when the core last ran a different job and a migration when the job last
+  ran on a different core.
+*/
+static void core_dispatch(int core_id, job_t* job, int time){
+	scheduler_core_stats_t* stats = &scheduler->core_stats[core_id];
+	if(scheduler->last_job[core_id] != job->id){
+		stats->context_switches = stats->context_switches +1;
+	}
+	if(job->last_core != -1 && job->last_core != core_id){
+		stats->migrations = stats->migrations +1;
+	}
+
+	scheduler->core_array[core_id] = job;
+	scheduler->busy_since[core_id] = time;
+	scheduler->work_since[core_id] = time;
+	scheduler->last_job[core_id] = job->id;
+	job->last_core = core_id;
+	job->last_start_time = time;
+	core_keys(core_id);
+
+	// Jobs that become ready start from the pass of the latest job to run, so they cannot bank idle time
+	if(job->pass > scheduler->global_pass){
+		scheduler->global_pass = job->pass;
+	}
+	if(scheduler->grouped && scheduler->groups[job->group]->vruntime > scheduler->group_clock){
+		scheduler->group_clock = scheduler->groups[job->group]->vruntime;
+	}
+}
 
- */
 
+/**
+  Work the job on core core_id has done since it was dispatched, in
+  hundredths of a time unit and counting the hundredths it had left over from
+  before. The time the job starts working, work_since, is the core's epoch:
+  nothing about a running job is updated until it is compared, preempted or
+  requeued, so events leave the cores they do not involve untouched.
+*/
+static int core_work(int core_id, int time){
+	int elapsed = time - scheduler->work_since[core_id];
+	return scheduler->core_array[core_id]->used_carry + (elapsed > 0 ? elapsed : 0) * scheduler->core_speed[core_id];
+}
 
 
-int scheduler_new_job(int job_number, int time, int running_time, int priority)
+/**
+  Whole time units of work the job on core core_id has done since it was
+  dispatched.
+*/
+static int core_progress(int core_id, int time){
+	return core_work(core_id, time) / 100;
+}
+
+
+/**
+  Remaining time of the job running on core core_id, as of time.
+*/
+static int core_remaining(int core_id, int time){
+	job_t* job = scheduler->core_array[core_id];
+	return job->needed_time - job->used_time - core_progress(core_id, time);
+}
+
+
+/**
+  Takes the running job off core core_id, charging the busy interval and
+  folding the work done since dispatch into the job's used and remaining time.
+*/
+static void core_release(int core_id, int time){
+	job_t* job = scheduler->core_array[core_id];
+	int work = core_work(core_id, time);
+	int progress = work / 100;
+
+	scheduler->core_stats[core_id].busy_time += time - scheduler->busy_since[core_id];
+	job->used_time = job->used_time + progress;
+	job->used_carry = work % 100;
+	job->pass = job->pass + (uint64_t)progress * job->stride;
+	job->remaining_time = job->needed_time - job->used_time;
+	job->last_stop_time = time;
+	scheduler->core_array[core_id] = NULL;
+	scheduler->run_group[core_id] = -1;
+
+	if(scheduler->grouped){
+		group_t* group = scheduler->groups[job->group];
+		group->vruntime = group->vruntime + (uint64_t)progress * STRIDE_ONE / group->weight;
+		group->stats.cpu_time = group->stats.cpu_time + progress;
+		if(group->heap_index != -1){
+			group_sift(group);
+		}
+	}
+}
+
+
+/**
+  Seeds the random number generator LOTTERY draws its winning tickets from.
+  Schedulers start seeded with 1, and the same seed always draws the same
+  tickets.
+
+  @param seed any value.
+ */
+void scheduler_set_seed(unsigned long seed)
 {
-    job_t* new_job = malloc(sizeof(job_t));
-    new_job->id = job_number;
-    new_job->arrival_time = time;
-    new_job->used_time = 0;
-		new_job->remaining_time = running_time;
-		new_job->needed_time = running_time;
-    new_job->last_start_time = 0;
-    new_job->time_to_schedule = 0;
-		new_job->priority = priority;
+	scheduler->rng = (uint64_t)seed * 0x9E3779B97F4A7C15ULL | 1;
+}
 
-		int core = -1;
-		for(int i=0; i < scheduler->num_cores; i++){
-			if(scheduler->core_array[i] == NULL){
+
+/**
+  Next number of the xorshift64* sequence.
+*/
+static uint64_t next_random(){
+	uint64_t x = scheduler->rng;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	scheduler->rng = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+
+static int job_tickets(const job_t* job){
+	return job->priority > 0 ? job->priority : 1;
+}
+
+
+static void lottery_update(int slot, int64_t tickets){
+	for(int i=slot+1; i<=scheduler->lottery_capacity; i += i & -i){
+		scheduler->lottery_tree[i] = scheduler->lottery_tree[i] + tickets;
+	}
+	scheduler->lottery_total = scheduler->lottery_total + tickets;
+}
+
+
+/**
+  Doubles the number of slots in the ticket tree and rebuilds it in linear time.
+*/
+static void lottery_grow(){
+	int old_capacity = scheduler->lottery_capacity;
+	int capacity = old_capacity ? old_capacity * 2 : 16;
+
+	scheduler->lottery_slot = realloc(scheduler->lottery_slot, capacity * sizeof(job_t*));
+	scheduler->lottery_free = realloc(scheduler->lottery_free, capacity * sizeof(int));
+	scheduler->lottery_tree = realloc(scheduler->lottery_tree, (capacity + 1) * sizeof(int64_t));
+	scheduler->lottery_capacity = capacity;
+
+	// Lowest free slot first
+	for(int i=capacity-1; i>=old_capacity; i--){
+		scheduler->lottery_slot[i] = NULL;
+		scheduler->lottery_free[scheduler->lottery_free_count++] = i;
+	}
+
+	memset(scheduler->lottery_tree, 0, (capacity + 1) * sizeof(int64_t));
+	for(int i=1; i<=capacity; i++){
+		if(scheduler->lottery_slot[i-1] != NULL){
+			scheduler->lottery_tree[i] += job_tickets(scheduler->lottery_slot[i-1]);
+		}
+		if(i + (i & -i) <= capacity){
+			scheduler->lottery_tree[i + (i & -i)] += scheduler->lottery_tree[i];
+		}
+	}
+}
+
+
+static void lottery_add(job_t* job){
+	if(scheduler->lottery_free_count == 0){
+		lottery_grow();
+	}
+
+	job->slot = scheduler->lottery_free[--scheduler->lottery_free_count];
+	job->queued_seq = scheduler->lottery_seq++;
+	scheduler->lottery_slot[job->slot] = job;
+	lottery_update(job->slot, job_tickets(job));
+}
+
+
+static int lottery_compare(const void* x, const void* y){
+	const job_t* job1 = *(job_t* const*) x;
+	const job_t* job2 = *(job_t* const*) y;
+
+	if(job1->ready_time != job2->ready_time){
+		return job1->ready_time - job2->ready_time;
+	}
+	return (job1->queued_seq > job2->queued_seq) - (job1->queued_seq < job2->queued_seq);
+}
+
+
+/**
+  Copies the jobs held by the ticket tree into jobs in first-come,
+  first-served order: by ready time, then by when they joined the queue.
+
+  @return the number of jobs copied
+*/
+static int lottery_to_array(job_t** jobs){
+	int n = 0;
+	for(int i=0; i<scheduler->lottery_capacity; i++){
+		if(scheduler->lottery_slot[i] != NULL){
+			jobs[n++] = scheduler->lottery_slot[i];
+		}
+	}
+	qsort(jobs, n, sizeof(job_t*), lottery_compare);
+	return n;
+}
+
+
+/**
+  Draws a winning ticket among the queued jobs, each holding as many tickets
+  as its priority, and takes the job holding it out of the ticket tree. The
+  winner is found by descending the tree, in O(log n). The ticket tree is
+  the whole queue under LOTTERY, so this takes the job out of the queue.
+
+  @return the winning job
+  @return NULL if no job is queued
+*/
+static job_t* lottery_draw(){
+	if(scheduler->lottery_total == 0){
+		return NULL;
+	}
+
+	int64_t winner = next_random() % (uint64_t)scheduler->lottery_total;
+	int slot = 0;
+	for(int step=scheduler->lottery_capacity; step>0; step >>= 1){
+		if(slot + step <= scheduler->lottery_capacity && scheduler->lottery_tree[slot + step] <= winner){
+			slot = slot + step;
+			winner = winner - scheduler->lottery_tree[slot];
+		}
+	}
+
+	job_t* job = scheduler->lottery_slot[slot];
+	lottery_update(slot, -job_tickets(job));
+	scheduler->lottery_slot[slot] = NULL;
+	scheduler->lottery_free[scheduler->lottery_free_count++] = slot;
+	job->slot = -1;
+
+	return job;
+}
+
+
+/**
+  Number of jobs waiting, in the single queue or over every group.
+*/
+static int queued_jobs(){
+	if(scheduler->scheme == LOTTERY){
+		return scheduler->lottery_capacity - scheduler->lottery_free_count;
+	}
+	return scheduler->grouped ? scheduler->group_queued : priqueue_size(scheduler->priqueue);
+}
+
+
+/**
+  Inserts job into the ready queue, or its group's, and records the deepest
+  the queue has been. Under LOTTERY the ticket tree is the queue: a draw
+  picks any job, so keeping them in order as well would only cost a search
+  to take the winner out.
+*/
+static void queue_job(job_t* job){
+	if(scheduler->scheme == LOTTERY){
+		lottery_add(job);
+	}
+	else if(scheduler->grouped){
+		group_t* group = scheduler->groups[job->group];
+		priqueue_offer(&group->queue, job);
+		scheduler->group_queued = scheduler->group_queued +1;
+		if(group->heap_index == -1){
+			group_activate(group);
+		}
+	}
+	else{
+		priqueue_offer(scheduler->priqueue, job);
+	}
+	if(queued_jobs() > scheduler->max_queue_depth){
+		scheduler->max_queue_depth = queued_jobs();
+	}
+}
+
+
+/**
+  Inserts n jobs into the ready queue at once, as n calls to queue_job would.
+*/
+static void queue_jobs(job_t** jobs, int n){
+	if(scheduler->grouped || scheduler->scheme == LOTTERY){
+		for(int i=0; i<n; i++){
+			queue_job(jobs[i]);
+		}
+		return;
+	}
+
+	priqueue_offer_all(scheduler->priqueue, (void**)jobs, n);
+	if(priqueue_size(scheduler->priqueue) > scheduler->max_queue_depth){
+		scheduler->max_queue_depth = priqueue_size(scheduler->priqueue);
+	}
+}
+
+
+/**
+  Copies the queued jobs into jobs, in queue order, group by group when
+  groups are on.
+
+  @return the number of jobs copied
+*/
+static int queued_to_array(job_t** jobs){
+	if(scheduler->scheme == LOTTERY){
+		return lottery_to_array(jobs);
+	}
+	if(!scheduler->grouped){
+		priqueue_to_array(scheduler->priqueue, (void**)jobs);
+		return priqueue_size(scheduler->priqueue);
+	}
+
+	int n = 0;
+	for(int i=0; i<scheduler->group_count; i++){
+		priqueue_to_array(&scheduler->groups[i]->queue, (void**)(jobs + n));
+		n = n + priqueue_size(&scheduler->groups[i]->queue);
+	}
+	return n;
+}
+
+
+/**
+  Takes the next job to run out of the ready queue: the head, or under
+  LOTTERY the winner of a draw. When groups are on, the head of the queue of
+  the group with the lowest vruntime, found at the top of the group heap.
+
+  @return the job
+  @return NULL if the queue is empty
+*/
+static job_t* poll_job(){
+	if(scheduler->grouped){
+		if(scheduler->group_heap_size == 0){
+			return NULL;
+		}
+		group_t* group = scheduler->group_heap[0];
+		job_t* job = priqueue_poll(&group->queue);
+		group_taken(group);
+		return job;
+	}
+
+	if(scheduler->scheme == LOTTERY){
+		return lottery_draw();
+	}
+	return priqueue_poll(scheduler->priqueue);
+}
+
+
+/**
+  Picks the queued job that is cheapest to resume on core_id. Candidates are
+  ranked: a job that is still warm on core_id (it left the core no more than
+  affinity_window time units ago) first, then, on a multi-socket topology, a
+  job that would not leave its socket (it last ran on the same socket, or has
+  never run). Only the first num_cores entries are considered, since those
+  are the jobs about to be dispatched anyway, so a job can only be passed
+  over by jobs that were already close to the head of the queue.
+
+  @return the job to run on core_id, removed from the queue
+  @return NULL if the queue head should be taken
+*/
+static job_t* poll_placed_job(int core_id, int time){
+	// A lottery winner is drawn, not taken from the head, so there is no order to bend
+	if(scheduler->scheme == LOTTERY || (scheduler->affinity_window < 0 && scheduler->num_sockets < 2)){
+		return NULL;
+	}
+
+	// Groups take turns, so only the group whose turn it is has candidates
+	priqueue_t* queue = scheduler->priqueue;
+	group_t* group = NULL;
+	if(scheduler->grouped){
+		if(scheduler->group_heap_size == 0){
+			return NULL;
+		}
+		group = scheduler->group_heap[0];
+		queue = &group->queue;
+	}
+
+	int depth = priqueue_size(queue);
+	if(depth > scheduler->num_cores){
+		depth = scheduler->num_cores;
+	}
+
+	int best = -1;
+	int best_rank = 0;
+	priqueue_iterator_t it;
+	priqueue_iterator(queue, &it);
+	for(int i=0; i<depth && best_rank < 2; i++){
+		job_t* job = priqueue_next(&it);
+		int rank = 0;
+		if(scheduler->affinity_window >= 0 && job->last_core == core_id && time - job->last_stop_time <= scheduler->affinity_window){
+			rank = 2;
+		}
+		else if(scheduler->num_sockets > 1 && (job->last_core == -1 || scheduler->core_socket[job->last_core] == scheduler->core_socket[core_id])){
+			rank = 1;
+		}
+
+		if(rank > best_rank){
+			best = i;
+			best_rank = rank;
+		}
+	}
+
+	if(best == -1){
+		return NULL;
+	}
+
+	job_t* job = priqueue_remove_at(queue, best);
+	if(group != NULL){
+		group_taken(group);
+	}
+	return job;
+}
+
+
+/**
+  Enables affinity-aware placement. When a core frees up it resumes a job that
+  recently ran on it in preference to the head of the queue.
+
+  @param window the longest time, in time units, a job may have been off a
+  core and still be considered warm on it. A negative window disables affinity.
+ */
+void scheduler_set_affinity(int window)
+{
+	scheduler->affinity_window = window;
+}
+
+
+/**
+  Describes a heterogeneous machine. Placement of new jobs prefers the fastest
+  idle core, and when a core frees up, jobs that would stay on its socket are
+  preferred over jobs that would migrate across sockets.
+
+  @param speed relative speed of each core as a percentage (100 is the
+  speed the running times are expressed in), one entry per core.
+  @param socket socket id of each core, one entry per core.
+ */
+void scheduler_set_topology(const int *speed, const int *socket)
+{
+	scheduler->num_sockets = 0;
+	for(int i=0; i<scheduler->num_cores; i++){
+		scheduler->core_speed[i] = speed[i];
+		scheduler->core_socket[i] = socket[i];
+		if(socket[i] + 1 > scheduler->num_sockets){
+			scheduler->num_sockets = socket[i] + 1;
+		}
+	}
+}
+
+
+static job_t* create_job(int job_number, int time, int running_time, int priority, int group){
+    job_t* new_job = malloc(sizeof(job_t));
+    new_job->id = job_number;
+    new_job->arrival_time = time;
+    new_job->used_time = 0;
+    new_job->used_carry = 0;
+		new_job->remaining_time = running_time;
+		new_job->needed_time = running_time;
+    new_job->last_start_time = 0;
+    new_job->time_to_schedule = 0;
+		new_job->priority = priority;
+		new_job->last_core = -1;
+		new_job->last_stop_time = 0;
+		new_job->cores_needed = 1;
+		new_job->ready_time = time;
+		new_job->cpu_time_done = 0;
+		new_job->io_time = 0;
+		new_job->pass = scheduler->global_pass;
+		new_job->stride = STRIDE_ONE / job_tickets(new_job);
+		new_job->slot = -1;
+		new_job->group = scheduler->grouped ? find_group(group)->id : 0;
+
+		return new_job;
+}
+
+
+/**
+  Decides where new_job goes when no core is idle: under PSJF and PPRI it
+  preempts the running job it beats (of its own group when groups are on),
+  otherwise it waits. The job that has to wait (new_job or the preempted one)
+  is returned through queued for the caller to put in the queue.
+
+  @return index of the core new_job now runs on
+  @return -1 if new_job should wait
+ */
+static int preempt_for(job_t* new_job, int time, job_t** queued){
+		int core;
+		*queued = NULL;
+
+		// The candidates are the running jobs, only those of new_job's group when groups are on
+		int only_group = scheduler->grouped ? new_job->group : -1;
+		int* keys = scheduler->victim_keys;
+		int n = scheduler->num_cores;
+
+		if(scheduler->scheme == PSJF){
+			//find job with longest remaining time; among equals the first, unless a later one arrived after that time
+			int longest = victim_remaining(keys, scheduler->run_remaining, scheduler->run_carry, scheduler->work_since, scheduler->core_speed,
+					scheduler->run_group, only_group, time, n);
+			if(longest == VICTIM_NONE || longest <= new_job->remaining_time){
+				*queued = new_job;
+				return -1;
+			}
+
+			core = victim_find_last_above(keys, longest, scheduler->run_arrival, n);
+			if(core == -1){
+				core = victim_find(keys, longest, 0, n);
+			}
+
+			*queued = scheduler->core_array[core];
+			core_release(core, time);
+			scheduler->core_stats[core].preemptions = scheduler->core_stats[core].preemptions +1;
+			core_dispatch(core, new_job, time);
+
+			return core;
+		}
+
+		else if(scheduler->scheme == PPRI){
+			//find job with the lowest priority; among equals the first, then any later one that arrived after the chosen one's remaining time
+			int lowest = victim_keys(keys, scheduler->run_priority, scheduler->run_group, only_group, n);
+			if(lowest == VICTIM_NONE || lowest <= new_job->priority){
+				*queued = new_job;
+				return -1;
+			}
+
+			int* ties = scheduler->victim_ties;
+			int tie_count = victim_find_all(keys, lowest, ties, n);
+			core = ties[0];
+			int threshold = core_remaining(core, time);
+			for(int i=1; i<tie_count; i++){
+				if(scheduler->run_arrival[ties[i]] > threshold){
+					core = ties[i];
+					threshold = core_remaining(core, time);
+				}
+			}
+
+			*queued = scheduler->core_array[core];
+			core_release(core, time);
+			scheduler->core_stats[core].preemptions = scheduler->core_stats[core].preemptions +1;
+			core_dispatch(core, new_job, time);
+			return core;
+		}
+		else if(scheduler->scheme == FCFS || scheduler->scheme == RR || scheduler->scheme == PRI || scheduler->scheme == SJF ||
+				scheduler->scheme == STRIDE || scheduler->scheme == LOTTERY){
+			*queued = new_job;
+			return -1;
+		}
+
+		else{
+			return -1;
+		}
+}
+
+
+/**
+  Puts a job that has just become ready on the fastest idle core, or on the
+  core of the running job it preempts, or in the queue.
+
+  @return index of the core the job runs on
+  @return -1 if it waits
+*/
+static int place_job(job_t* new_job, int time)
+{
+		// Fastest idle core first, lowest id among equals
+		int core = -1;
+		for(int i=0; i < scheduler->num_cores; i++){
+			if(scheduler->core_array[i] == NULL && (core == -1 || scheduler->core_speed[i] > scheduler->core_speed[core])){
+				core = i;
+			}
+		}
+
+		if(core != -1)
+    {
+				// new_job->time_to_schedule = 0;
+        core_dispatch(core, new_job, time);
+        return core;
+    }
+
+		job_t* queued = NULL;
+		core = preempt_for(new_job, time, &queued);
+		if(queued != NULL){
+			queue_job(queued);
+		}
+
+		return core;
+}
+
+
+/**
+  Called when a new job arrives.
+
+  If multiple cores are idle, the job should be assigned to the core with the
+  lowest id.
+  If the job arriving should be scheduled to run during the next
+  time cycle, return the zero-based index of the core the job should be
+  scheduled on. If another job is already running on the core specified,
+  this will preempt the currently running job.
+  Assumptions:
+    - You may assume that every job wil have a unique arrival time.
+
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made.
+
+ */
+
+
+
+int scheduler_new_job(int job_number, int time, int running_time, int priority)
+{
+		return place_job(create_job(job_number, time, running_time, priority, 0), time);
+}
+
+
+/**
+  Called when a new job of tenant group group arrives. Equivalent to
+  scheduler_new_job, with the job queued in its group's queue when groups are
+  on (see scheduler_set_group_weight).
+
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @param group the id of the job's group, from 0.
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made.
+ */
+int scheduler_new_job_in_group(int job_number, int time, int running_time, int priority, int group)
+{
+		return place_job(create_job(job_number, time, running_time, priority, group), time);
+}
+
+
+/**
+  Called when several jobs arrive at the same time. Equivalent to calling
+  scheduler_new_job_in_group for each job in array order, but the remaining times are
+  brought up to date once, idle cores are found once and every job that ends
+  up waiting is merged into the queue in a single pass.
+
+  @param batch the arriving jobs.
+  @param n the number of jobs in batch.
+  @param time the current time of the simulator.
+  @param cores filled in with the zero-based index of the core each job should
+  be scheduled on, or -1 if it waits. A job placed on a core and then
+  preempted by a later job of the same batch is reported as -1.
+  @return the number of jobs from batch that should be running.
+ */
+int scheduler_new_jobs(const scheduler_job_batch_t *batch, int n, int time, int *cores)
+{
+	job_t** queued = malloc(n * sizeof(job_t*));
+	int* idle = malloc(scheduler->num_cores * sizeof(int));
+	int* batch_slot = malloc(scheduler->num_cores * sizeof(int));
+	int queued_count = 0, idle_count = 0, placed = 0;
+
+	// Idle cores in the order scheduler_new_job would hand them out
+	for(int i=0; i<scheduler->num_cores; i++){
+		batch_slot[i] = -1;
+		if(scheduler->core_array[i] == NULL){
+			int j = idle_count++;
+			while(j > 0 && scheduler->core_speed[idle[j-1]] < scheduler->core_speed[i]){
+				idle[j] = idle[j-1];
+				j--;
+			}
+			idle[j] = i;
+		}
+	}
+
+	for(int i=0; i<n; i++){
+		job_t* new_job = create_job(batch[i].job_number, time, batch[i].running_time, batch[i].priority, batch[i].group);
+
+		if(i < idle_count){
+			cores[i] = idle[i];
+			core_dispatch(cores[i], new_job, time);
+		}
+		else{
+			job_t* victim = NULL;
+			cores[i] = preempt_for(new_job, time, &victim);
+			if(victim != NULL){
+				queued[queued_count++] = victim;
+			}
+		}
+
+		if(cores[i] != -1){
+			// A job admitted earlier in this batch may have just lost the core
+			if(batch_slot[cores[i]] != -1){
+				cores[batch_slot[cores[i]]] = -1;
+			}
+			batch_slot[cores[i]] = i;
+		}
+	}
+
+	queue_jobs(queued, queued_count);
+
+	for(int i=0; i<n; i++){
+		if(cores[i] != -1){
+			placed = placed +1;
+		}
+	}
+
+	free(batch_slot);
+	free(idle);
+	free(queued);
+	return placed;
+}
+
+
+/**
+  Adds a finished job's waiting, turnaround and response times to the totals.
+*/
+static void record_finish(job_t* job, int time){
+	scheduler->total_jobs = scheduler->total_jobs +1;
+	int temp = (time - job->arrival_time) - job->cpu_time_done - job->needed_time - job->io_time;
+	scheduler->total_wait = scheduler->total_wait + temp;
+	scheduler->last_finished.job_number = job->id;
+	scheduler->last_finished.waiting_time = temp;
+	temp = time - job->arrival_time;
+	scheduler->total_turnaround = scheduler->total_turnaround + temp;
+	scheduler->total_response = scheduler->total_response + job->time_to_schedule;
+	scheduler->last_finished.turnaround_time = temp;
+	scheduler->last_finished.response_time = job->time_to_schedule;
+
+	if(scheduler->grouped){
+		scheduler_group_stats_t* stats = &scheduler->groups[job->group]->stats;
+		stats->jobs_finished = stats->jobs_finished +1;
+		stats->total_waiting = stats->total_waiting + (time - job->arrival_time) - job->cpu_time_done - job->needed_time - job->io_time;
+		stats->total_turnaround = stats->total_turnaround + (time - job->arrival_time);
+		stats->total_response = stats->total_response + job->time_to_schedule;
+	}
+}
+
+
+/**
+  Called when a job has completed execution.
+
+  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
+  If any job should be scheduled to run on the core free'd up by the
+  finished job, return the job_number of the job that should be scheduled to
+  run on core core_id.
+
+  @param core_id the zero-based index of the core where the job was located.
+  @param job_number a globally unique identification number of the job.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled to run on core core_id
+  @return -1 if core should remain idle.
+ */
+int scheduler_job_finished(int core_id, int job_number, int time)
+{
+	job_t* old_job = scheduler->core_array[core_id];
+	record_finish(old_job, time);
+
+	core_release(core_id, time);
+	free(old_job);
+
+	job_t* new_job = poll_placed_job(core_id, time);
+	if(new_job == NULL){
+		new_job = poll_job();
+	}
+	if(new_job == NULL){
+		return -1;
+	}
+	else{
+		if(new_job->used_time == 0 && new_job->used_carry == 0 && new_job->cpu_time_done == 0){
+			new_job->time_to_schedule = time - new_job->arrival_time;
+		}
+		core_dispatch(core_id, new_job, time);
+
+		return new_job->id;
+	}
+
+}
+
+
+/**
+  Called when the job on core core_id has finished a CPU burst and blocks on
+  I/O. The job keeps its statistics and waits, off every core and out of the
+  queue, until scheduler_job_unblocked gives it its next CPU burst.
+
+  @param core_id the zero-based index of the core where the job was located.
+  @param job_number a globally unique identification number of the job.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled to run on core core_id
+  @return -1 if core should remain idle.
+ */
+int scheduler_job_blocked(int core_id, int job_number, int time)
+{
+	job_t* old_job = scheduler->core_array[core_id];
+
+	core_release(core_id, time);
+	old_job->cpu_time_done = old_job->cpu_time_done + old_job->needed_time;
+
+	if(scheduler->blocked_count == scheduler->blocked_capacity){
+		scheduler->blocked_capacity = scheduler->blocked_capacity * 2 + 8;
+		scheduler->blocked = realloc(scheduler->blocked, scheduler->blocked_capacity * sizeof(job_t*));
+	}
+	scheduler->blocked[scheduler->blocked_count] = old_job;
+	scheduler->blocked_count = scheduler->blocked_count +1;
+
+	job_t* new_job = poll_placed_job(core_id, time);
+	if(new_job == NULL){
+		new_job = poll_job();
+	}
+	if(new_job == NULL){
+		return -1;
+	}
+	else{
+		if(new_job->used_time == 0 && new_job->used_carry == 0 && new_job->cpu_time_done == 0){
+			new_job->time_to_schedule = time - new_job->arrival_time;
+		}
+		core_dispatch(core_id, new_job, time);
+
+		return new_job->id;
+	}
+}
+
+
+/**
+  Called when a job blocked by scheduler_job_blocked has finished its I/O and
+  is ready for its next CPU burst. The job is placed exactly as a new job
+  would be, and is ordered in the queue by the time it became ready rather
+  than by its arrival.
+
+  @param job_number a globally unique identification number of the job.
+  @param time the current time of the simulator.
+  @param running_time the length of the job's next CPU burst.
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made, or the job is not blocked.
+ */
+int scheduler_job_unblocked(int job_number, int time, int running_time)
+{
+	job_t* job = NULL;
+
+	for(int i=0; i<scheduler->blocked_count; i++){
+		if(scheduler->blocked[i]->id == job_number){
+			job = scheduler->blocked[i];
+			scheduler->blocked[i] = scheduler->blocked[scheduler->blocked_count - 1];
+			scheduler->blocked_count = scheduler->blocked_count -1;
+			break;
+		}
+	}
+	if(job == NULL){
+		return -1;
+	}
+
+	job->io_time = job->io_time + (time - job->last_stop_time);
+	job->ready_time = time;
+	if(job->pass < scheduler->global_pass){
+		job->pass = scheduler->global_pass;
+	}
+	job->needed_time = running_time;
+	job->remaining_time = running_time;
+	job->used_time = 0;
+	job->used_carry = 0;
+
+	return place_job(job, time);
+}
+
+
+/**
+  When the scheme is time sliced (RR, STRIDE or LOTTERY), called when the
+  quantum timer has expired on a core. Under STRIDE the expired job may win
+  its core straight back, if its pass is still the lowest.
+
+  If any job should be scheduled to run on the core free'd up by
+  the quantum expiration, return the job_number of the job that should be
+  scheduled to run on core core_id.
+
+  @param core_id the zero-based index of the core where the quantum has expired.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled on core cord_id
+  @return -1 if core should remain idle
+ */
+int scheduler_quantum_expired(int core_id, int time)
+{
+	job_t* old_job = scheduler->core_array[core_id];
+	core_release(core_id, time);
+	scheduler->core_stats[core_id].requeues = scheduler->core_stats[core_id].requeues +1;
+
+	// Look for a better placed job before requeuing, so the expired job does not win its own core back
+	job_t* new_job = poll_placed_job(core_id, time);
+	queue_job(old_job);
+	if(new_job == NULL){
+		new_job = poll_job();
+	}
+	if(new_job == NULL){
+		return -1;
+	}
+	else{
+		if(new_job->used_time == 0 && new_job->used_carry == 0 && new_job->cpu_time_done == 0){
+			new_job->time_to_schedule = time - new_job->arrival_time;
+		}
+		core_dispatch(core_id, new_job, time);
+
+		return new_job->id;
+	}
+}
+
+
+/**
+  Chooses what a gang job at the head of the queue lets past it when it does
+  not fit on the idle cores. With BACKFILL_NONE nothing overtakes it. With
+  BACKFILL_EASY (the default) a later job may start if it fits now and does
+  not delay the head job's reservation.
+
+  @param backfill the backfilling policy.
+ */
+void scheduler_set_backfill(backfill_t backfill)
+{
+	scheduler->backfill = backfill;
+}
+
+
+static int idle_cores(){
+	int idle = 0;
+	for(int i=0; i<scheduler->num_cores; i++){
+		if(scheduler->core_array[i] == NULL){
+			idle = idle +1;
+		}
+	}
+	return idle;
+}
+
+
+/**
+  Brings the fragmentation count up to time: every core that sat idle since
+  the last gang event while a job waited for more cores than were free.
+*/
+static void gang_account(int time){
+	if(priqueue_size(scheduler->priqueue) > 0){
+		scheduler->fragmented_time += (time - scheduler->gang_time) * idle_cores();
+	}
+	scheduler->gang_time = time;
+}
+
+
+/**
+  Places job on the cores_needed fastest idle cores, lowest id among equals.
+  The job moves at the pace of its slowest core, so that core (the lowest id
+  among the slowest) is its lead: last_core and work_since of the lead core
+  track its progress.
+*/
+static void gang_start(job_t* job, int time){
+	int lead = -1;
+
+	for(int placed=0; placed<job->cores_needed; placed++){
+		int core = -1;
+		for(int i=0; i<scheduler->num_cores; i++){
+			if(scheduler->core_array[i] == NULL && (core == -1 || scheduler->core_speed[i] > scheduler->core_speed[core])){
 				core = i;
-				break;
 			}
 		}
 
-		updateRemainingTimes(time);
+		job->last_core = -1;  // spreading over several cores is not a migration
+		core_dispatch(core, job, time);
+		if(lead == -1 || scheduler->core_speed[core] < scheduler->core_speed[lead] ||
+				(scheduler->core_speed[core] == scheduler->core_speed[lead] && core < lead)){
+			lead = core;
+		}
+	}
 
-		if(core != -1)
-    {
-				new_job->last_start_time = time;
-				// new_job->time_to_schedule = 0;
-        scheduler->core_array[core] = new_job;
-        return core;
-    }
+	job->last_core = lead;
+	job->time_to_schedule = time - job->arrival_time;
+}
 
-		if(scheduler->scheme == PSJF){
-			//find job with longest remaining time
-			core = 0;
-			for(int i=0; i<scheduler->num_cores; i++){
-				if(scheduler->core_array[i] != NULL){
-					if(scheduler->core_array[i]->remaining_time > scheduler->core_array[core]->remaining_time){
-						core = i;
-					}
-					else if(scheduler->core_array[i]->remaining_time == scheduler->core_array[core]->remaining_time){
-						if(scheduler->core_array[i]->arrival_time > scheduler->core_array[core]->remaining_time){
-							core = i;
-						}
-					}
-				}
-			}
 
-			if(scheduler->core_array[core]->remaining_time <= new_job->remaining_time){
-				priqueue_offer(scheduler->priqueue, new_job);
-				return -1;
-			}
+/**
+  Time at which the job running with lead core core_id is expected to finish.
+*/
+static int gang_finish_time(int core_id, int time){
+	job_t* job = scheduler->core_array[core_id];
+	int speed = scheduler->core_speed[core_id];
+	int work = (job->needed_time - job->used_time) * 100 - core_work(core_id, time);
+	int start = scheduler->work_since[core_id] > time ? scheduler->work_since[core_id] : time;
+	return start + (work + speed - 1) / speed;
+}
 
-			new_job->last_start_time = time;
-			job_t* old_job = scheduler->core_array[core];
-			priqueue_offer(scheduler->priqueue, old_job);
-			scheduler->core_array[core] = NULL;
-			scheduler->core_array[core] = new_job;
 
-			return core;
+/**
+  Speed of the slowest core gang_start would place a job needing cores_needed
+  cores on, which sets the pace of the whole job.
+*/
+static int gang_start_speed(int cores_needed){
+	int speeds[scheduler->num_cores];
+	int idle = 0;
+
+	// Speeds of the idle cores, fastest first
+	for(int i=0; i<scheduler->num_cores; i++){
+		if(scheduler->core_array[i] == NULL){
+			int j = idle++;
+			while(j > 0 && speeds[j-1] < scheduler->core_speed[i]){
+				speeds[j] = speeds[j-1];
+				j--;
+			}
+			speeds[j] = scheduler->core_speed[i];
 		}
+	}
 
-		else if(scheduler->scheme == PPRI){
-			core = 0;
-			for(int i=0; i<scheduler->num_cores; i++){
-				if(scheduler->core_array[i] != NULL){
-					if(scheduler->core_array[i]->priority > scheduler->core_array[core]->priority){
-						core = i;
-					}
-					else if(scheduler->core_array[i]->priority == scheduler->core_array[core]->priority){
-						if(scheduler->core_array[i]->arrival_time > scheduler->core_array[core]->remaining_time){
-							core = i;
-						}
-					}
-				}
-			}
+	return speeds[cores_needed - 1];
+}
 
-			if(scheduler->core_array[core]->priority <= new_job->priority){
-				priqueue_offer(scheduler->priqueue, new_job);
-				return -1;
+
+/**
+  EASY backfilling behind head, which needs more than the idle cores. The
+  head job is promised the earliest time enough running jobs will have
+  finished for it (its shadow time). A later job starts now if it fits on the
+  idle cores and either finishes by the shadow time, judged by its running
+  time at the pace of the cores it would get, or only uses cores the head job
+  will not need then.
+
+  @return the number of jobs started
+*/
+static int gang_backfill(job_t* head, int idle, int time){
+	int ends[scheduler->num_cores], widths[scheduler->num_cores];
+	int running = 0;
+
+	// Finish times of the running jobs, soonest first
+	for(int i=0; i<scheduler->num_cores; i++){
+		job_t* job = scheduler->core_array[i];
+		if(job != NULL && job->last_core == i){
+			int end = gang_finish_time(i, time);
+			int j = running++;
+			while(j > 0 && ends[j-1] > end){
+				ends[j] = ends[j-1];
+				widths[j] = widths[j-1];
+				j--;
 			}
+			ends[j] = end;
+			widths[j] = job->cores_needed;
+		}
+	}
 
-			new_job->last_start_time = time;
-			job_t* old_job = scheduler->core_array[core];
-			priqueue_offer(scheduler->priqueue, old_job);
-			scheduler->core_array[core] = NULL;
-			scheduler->core_array[core] = new_job;
-			return core;
+	int shadow = time, extra = 0, available = idle;
+	for(int i=0; i<running; i++){
+		available = available + widths[i];
+		if(available >= head->cores_needed){
+			shadow = ends[i];
+			extra = available - head->cores_needed;
+			break;
 		}
-		else if(scheduler->scheme == FCFS || scheduler->scheme == RR || scheduler->scheme == PRI || scheduler->scheme == SJF ){
-			priqueue_offer(scheduler->priqueue, new_job);
-			return -1;
+	}
+
+	int queued = priqueue_size(scheduler->priqueue), started = 0;
+	job_t** candidates = malloc(queued * sizeof(job_t*));
+	priqueue_to_array(scheduler->priqueue, (void**)candidates);
+
+	for(int i=1; i<queued && idle > 0; i++){
+		job_t* job = candidates[i];
+		if(job->cores_needed > idle){
+			continue;
 		}
 
-		else{
-			return -1;
+		int speed = gang_start_speed(job->cores_needed);
+		int done_by_shadow = time + (job->remaining_time * 100 - job->used_carry + speed - 1) / speed <= shadow;
+		if(!done_by_shadow && job->cores_needed > extra){
+			continue;
+		}
+
+		priqueue_remove(scheduler->priqueue, job);
+		gang_start(job, time);
+		idle = idle - job->cores_needed;
+		if(!done_by_shadow){
+			extra = extra - job->cores_needed;
 		}
+		scheduler->backfilled = scheduler->backfilled +1;
+		started = started +1;
+	}
 
+	free(candidates);
+	return started;
 }
 
 
 /**
-  Called when a job has completed execution.
+  Called when a job that may need several cores at once arrives. Jobs given to
+  the scheduler this way are never preempted; they wait in the queue, in the
+  order of the scheme, until scheduler_gang_dispatch starts them on all of
+  their cores together.
 
-  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
-  If any job should be scheduled to run on the core free'd up by the
-  finished job, return the job_number of the job that should be scheduled to
-  run on core core_id.
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @param cores_needed the number of cores the job runs on at once, at most the number of cores.
+ */
+void scheduler_new_gang_job(int job_number, int time, int running_time, int priority, int cores_needed)
+{
+	gang_account(time);
+
+	job_t* job = create_job(job_number, time, running_time, priority, 0);
+	job->cores_needed = cores_needed;
+	queue_job(job);
+}
+
+
+/**
+  Called when a job started by scheduler_gang_dispatch has completed. Every
+  core it ran on becomes idle; call scheduler_gang_dispatch to fill them.
 
-  @param core_id the zero-based index of the core where the job was located.
   @param job_number a globally unique identification number of the job.
   @param time the current time of the simulator.
-  @return job_number of the job that should be scheduled to run on core core_id
-  @return -1 if core should remain idle.
  */
-int scheduler_job_finished(int core_id, int job_number, int time)
+void scheduler_gang_job_finished(int job_number, int time)
 {
-	job_t* old_job = scheduler->core_array[core_id];
-	scheduler->total_jobs = scheduler->total_jobs +1;
-	int temp = (time - old_job->arrival_time) - old_job->needed_time;
-	scheduler->total_wait = scheduler->total_wait + temp;
-	temp = time - old_job->arrival_time;
-	scheduler->total_turnaround = scheduler->total_turnaround + temp;
-	// temp = old_job->time_to_schedule;
-	scheduler->total_response = scheduler->total_response + old_job->time_to_schedule;
+	job_t* job = NULL;
 
-	scheduler->core_array[core_id] = NULL;
-	free(old_job);
+	gang_account(time);
 
-	job_t* new_job = priqueue_poll(scheduler->priqueue);
-	if(new_job == NULL){
-		return -1;
-	}
-	else{
-		if(new_job->used_time == 0){
-			new_job->time_to_schedule = time - new_job->arrival_time;
+	for(int i=0; i<scheduler->num_cores; i++){
+		if(scheduler->core_array[i] != NULL && scheduler->core_array[i]->id == job_number){
+			job = scheduler->core_array[i];
+			scheduler->core_stats[i].busy_time += time - scheduler->busy_since[i];
+			job->last_stop_time = time;
+			scheduler->core_array[i] = NULL;
+			scheduler->run_group[i] = -1;
 		}
-		scheduler->core_array[core_id] = new_job;
-		new_job->last_start_time = time;
-
-		return new_job->id;
 	}
 
+	if(job != NULL){
+		record_finish(job, time);
+		free(job);
+	}
 }
 
 
 /**
-  When the scheme is set to RR, called when the quantum timer has expired
-  on a core.
-
-  If any job should be scheduled to run on the core free'd up by
-  the quantum expiration, return the job_number of the job that should be
-  scheduled to run on core core_id.
+  Starts every queued job that may start at time: jobs from the head of the
+  queue while they fit on the idle cores, then, behind a head job that does
+  not fit, whatever the backfilling policy lets past it.
 
-  @param core_id the zero-based index of the core where the quantum has expired.
   @param time the current time of the simulator.
-  @return job_number of the job that should be scheduled on core cord_id
-  @return -1 if core should remain idle
+  @param core_jobs filled in with the job_number of the job on each core, or -1 for an idle core.
+  @return the number of jobs started
  */
-int scheduler_quantum_expired(int core_id, int time)
+int scheduler_gang_dispatch(int time, int *core_jobs)
 {
-	updateRemainingTimes(time);
-	job_t* old_job = scheduler->core_array[core_id];
-	priqueue_offer(scheduler->priqueue, old_job);
-	scheduler->core_array[core_id] = NULL;
+	int idle, started = 0;
+	job_t* head;
 
-	job_t* new_job = priqueue_poll(scheduler->priqueue);
-	if(new_job == NULL){
-		return -1;
+	gang_account(time);
+	idle = idle_cores();
+
+	while((head = priqueue_peek(scheduler->priqueue)) != NULL && head->cores_needed <= idle){
+		priqueue_poll(scheduler->priqueue);
+		gang_start(head, time);
+		idle = idle - head->cores_needed;
+		started = started +1;
 	}
-	else{
-		if(new_job->used_time == 0){
-			new_job->time_to_schedule = time - new_job->arrival_time;
-		}
-		scheduler->core_array[core_id] = new_job;
-		new_job->last_start_time = time;
 
-		return new_job->id;
+	if(head != NULL && idle > 0 && scheduler->backfill == BACKFILL_EASY){
+		started = started + gang_backfill(head, idle, time);
 	}
+
+	for(int i=0; i<scheduler->num_cores; i++){
+		core_jobs[i] = scheduler->core_array[i] != NULL ? scheduler->core_array[i]->id : -1;
+	}
+
+	return started;
 }
 
 
@@ -412,17 +1691,507 @@ float scheduler_average_response_time()
 
 
 /**
-  Free any memory associated with your scheduler.
+  Copies the overhead counters of a single core.
+
+  Busy time includes the interval of the job running on the core at time, and
+  idle time is everything else since time 0.
+
+  @param core_id the zero-based index of the core.
+  @param time the current time of the simulator.
+  @param stats filled in with the counters of core core_id.
+ */
+void scheduler_core_stats(int core_id, int time, scheduler_core_stats_t *stats)
+{
+	*stats = scheduler->core_stats[core_id];
+	if(scheduler->core_array[core_id] != NULL){
+		stats->busy_time = stats->busy_time + (time - scheduler->busy_since[core_id]);
+	}
+	stats->idle_time = time - stats->busy_time;
+}
+
+
+/**
+  Sums the overhead counters of every core for the active scheme.
+
+  @param time the current time of the simulator.
+  @param stats filled in with the totals and the deepest the queue has been.
+ */
+void scheduler_stats(int time, scheduler_stats_t *stats)
+{
+	memset(stats, 0, sizeof(scheduler_stats_t));
+	stats->scheme = scheduler->scheme;
+	stats->cores = scheduler->num_cores;
+	stats->max_queue_depth = scheduler->max_queue_depth;
+	stats->jobs_finished = scheduler->total_jobs;
+	stats->total_waiting = scheduler->total_wait;
+	stats->total_turnaround = scheduler->total_turnaround;
+	stats->total_response = scheduler->total_response;
+	stats->fragmented_time = scheduler->fragmented_time;
+	stats->backfilled = scheduler->backfilled;
+
+	scheduler_core_stats_t core;
+	for(int i=0; i<scheduler->num_cores; i++){
+		scheduler_core_stats(i, time, &core);
+		stats->busy_time = stats->busy_time + core.busy_time;
+		stats->idle_time = stats->idle_time + core.idle_time;
+		stats->context_switches = stats->context_switches + core.context_switches;
+		stats->preemptions = stats->preemptions + core.preemptions;
+		stats->requeues = stats->requeues + core.requeues;
+		stats->migrations = stats->migrations + core.migrations;
+	}
+}
+
+
+/**
+  Returns the waiting, turnaround and response time of the job that finished
+  last, as added to the totals. Unlike the difference of two totals, they are
+  exact however many jobs have finished.
+
+  @param stats filled in with the figures of the last finished job.
+ */
+void scheduler_last_finished(scheduler_job_stats_t *stats)
+{
+	*stats = scheduler->last_finished;
+}
+
+
+/**
+  Turns on hierarchical fair share and sets the weight of tenant group group.
+  Each group then has its own queue, ordered by the scheme, and the groups
+  share the cores in proportion to their weights: a job is always taken from
+  the group that has had the least service for its weight, and PSJF and PPRI
+  only preempt jobs of the arriving job's own group. Groups a job names
+  without a weight having been set get a weight of 1.
+
+  Call before the first job arrives. Groups are not available under LOTTERY,
+  whose draw already spans every queued job, nor for gang jobs.
+
+  @param group the id of the group, from 0.
+  @param weight the group's share of the cores relative to the other groups, at least 1.
+ */
+void scheduler_set_group_weight(int group, int weight)
+{
+	if(scheduler->scheme == LOTTERY){
+		return;
+	}
+
+	scheduler->grouped = 1;
+	find_group(group)->weight = weight > 0 ? weight : 1;
+}
+
+
+/**
+  Returns the number of tenant groups, or 0 when groups are off.
+ */
+int scheduler_group_count()
+{
+	return scheduler->grouped ? scheduler->group_count : 0;
+}
+
+
+/**
+  Copies the statistics of a tenant group: its weight, the jobs of it that
+  have finished with their waiting, turnaround and response time totals, and
+  the CPU time its jobs received up to their last time off a core.
+
+  @param group the id of the group, less than scheduler_group_count().
+  @param stats filled in with the group's statistics.
+ */
+void scheduler_group_stats(int group, scheduler_group_stats_t *stats)
+{
+	*stats = scheduler->groups[group]->stats;
+	stats->weight = scheduler->groups[group]->weight;
+}
+
+
+/**
+  Tells the scheduler that core core_id spends its first time_units time units
+  after its latest dispatch switching to the job, doing no work on it. The
+  job's remaining time, and so the choice of a job to preempt, only starts
+  going down once the switch is paid for.
+
+  @param core_id the zero-based index of the core.
+  @param time_units the length of the switch.
+ */
+void scheduler_switch_stall(int core_id, int time_units)
+{
+	scheduler->work_since[core_id] = scheduler->busy_since[core_id] + time_units;
+}
+
+
+/**
+  Returns the number of jobs waiting in the queue.
+ */
+int scheduler_queue_depth()
+{
+	return queued_jobs();
+}
+
+
+static void save_job(FILE *file, job_t* job){
+	int fields[] = { job->id, job->arrival_time, job->used_time, job->remaining_time, job->needed_time,
+		job->last_start_time, job->time_to_schedule, job->priority, job->last_core, job->last_stop_time, job->used_carry };
+	checkpoint_write_ints(file, fields, sizeof(fields) / sizeof(int));
+}
+
+
+static job_t* load_job(FILE *file){
+	int fields[11];
+	if(checkpoint_read_ints(file, fields, 11) != 0){
+		return NULL;
+	}
+
+	job_t* job = malloc(sizeof(job_t));
+	job->id = fields[0];
+	job->arrival_time = fields[1];
+	job->used_time = fields[2];
+	job->remaining_time = fields[3];
+	job->needed_time = fields[4];
+	job->last_start_time = fields[5];
+	job->time_to_schedule = fields[6];
+	job->priority = fields[7];
+	job->last_core = fields[8];
+	job->last_stop_time = fields[9];
+	job->used_carry = fields[10];
+	job->cores_needed = 1;
+	job->ready_time = job->arrival_time;
+	job->cpu_time_done = 0;
+	job->io_time = 0;
+	job->pass = 0;
+	job->stride = STRIDE_ONE / job_tickets(job);
+	job->slot = -1;
+	job->group = 0;
+	return job;
+}
+
+
+/**
+  Writes the scheduler state to a snapshot: the running and queued jobs, the
+  statistics so far and the placement settings. Only runs without stride,
+  lottery, gangs, I/O bursts or tenant groups can be saved, so the job fields
+  and counters those keep are left out and start from their defaults again
+  on load; the blocked list is always empty.
+
+  @param file the snapshot being written.
+ */
+void scheduler_save(FILE *file)
+{
+	checkpoint_write_int(file, scheduler->scheme);
+	checkpoint_write_int(file, scheduler->num_cores);
+	checkpoint_write_int(file, scheduler->total_jobs);
+	checkpoint_write_float(file, scheduler->total_wait);
+	checkpoint_write_float(file, scheduler->total_turnaround);
+	checkpoint_write_float(file, scheduler->total_response);
+	checkpoint_write_int(file, scheduler->max_queue_depth);
+	checkpoint_write_int(file, scheduler->affinity_window);
+	checkpoint_write_ints(file, scheduler->core_speed, scheduler->num_cores);
+	checkpoint_write_ints(file, scheduler->core_socket, scheduler->num_cores);
+	checkpoint_write_ints(file, scheduler->busy_since, scheduler->num_cores);
+	checkpoint_write_ints(file, scheduler->work_since, scheduler->num_cores);
+	checkpoint_write_ints(file, scheduler->last_job, scheduler->num_cores);
+	checkpoint_write_ints(file, (int*)scheduler->core_stats, scheduler->num_cores * sizeof(scheduler_core_stats_t) / sizeof(int));
+
+	for(int i=0; i<scheduler->num_cores; i++){
+		checkpoint_write_int(file, scheduler->core_array[i] != NULL);
+		if(scheduler->core_array[i] != NULL){
+			save_job(file, scheduler->core_array[i]);
+		}
+	}
+
+	job_t** queued = malloc((queued_jobs() + 1) * sizeof(job_t*));
+	int queued_count = queued_to_array(queued);
+	checkpoint_write_int(file, queued_count);
+	for(int i=0; i<queued_count; i++){
+		save_job(file, queued[i]);
+	}
+	free(queued);
+}
+
+
+/**
+  Initializes the scheduler from a snapshot written by scheduler_save, in
+  place of scheduler_start_up.
+
+  The snapshot may be restored under a different scheme than it was saved
+  with, to try an alternative policy from the same state; the queued jobs are
+  then reordered by the new scheme.
+
+  @param file the snapshot being read.
+  @param scheme the scheme to continue with, or -1 to keep the saved one.
+  @return 0 on success
+  @return -1 if the snapshot is truncated or malformed
+ */
+int scheduler_load(FILE *file, int scheme)
+{
+	long saved_scheme, cores, value;
+	int core_fields = sizeof(scheduler_core_stats_t) / sizeof(int);
+	job_t** queued = NULL;
+	long queued_count = 0;
+
+	if(checkpoint_read_int(file, &saved_scheme) != 0 || checkpoint_read_int(file, &cores) != 0 || cores <= 0){
+		return -1;
+	}
+
+	scheduler_start_up(cores, scheme < 0 ? saved_scheme : scheme);
+
+	if(checkpoint_read_int(file, &value) != 0 ||
+			checkpoint_read_float(file, &scheduler->total_wait) != 0 ||
+			checkpoint_read_float(file, &scheduler->total_turnaround) != 0 ||
+			checkpoint_read_float(file, &scheduler->total_response) != 0){
+		goto failed;
+	}
+	scheduler->total_jobs = value;
+
+	if(checkpoint_read_int(file, &value) != 0){
+		goto failed;
+	}
+	scheduler->max_queue_depth = value;
+	if(checkpoint_read_int(file, &value) != 0){
+		goto failed;
+	}
+	scheduler->affinity_window = value;
+
+	if(checkpoint_read_ints(file, scheduler->core_speed, cores) != 0 ||
+			checkpoint_read_ints(file, scheduler->core_socket, cores) != 0 ||
+			checkpoint_read_ints(file, scheduler->busy_since, cores) != 0 ||
+			checkpoint_read_ints(file, scheduler->work_since, cores) != 0 ||
+			checkpoint_read_ints(file, scheduler->last_job, cores) != 0 ||
+			checkpoint_read_ints(file, (int*)scheduler->core_stats, cores * core_fields) != 0){
+		goto failed;
+	}
+
+	scheduler->num_sockets = 1;
+	for(int i=0; i<cores; i++){
+		if(scheduler->core_socket[i] + 1 > scheduler->num_sockets){
+			scheduler->num_sockets = scheduler->core_socket[i] + 1;
+		}
+	}
+
+	for(int i=0; i<cores; i++){
+		if(checkpoint_read_int(file, &value) != 0){
+			goto failed;
+		}
+		if(value && (scheduler->core_array[i] = load_job(file)) == NULL){
+			goto failed;
+		}
+		core_keys(i);
+	}
+
+	if(checkpoint_read_int(file, &value) != 0 || value < 0){
+		goto failed;
+	}
+	if((queued = malloc((value + 1) * sizeof(job_t*))) == NULL){
+		goto failed;
+	}
+	for(queued_count=0; queued_count<value; queued_count++){
+		if((queued[queued_count] = load_job(file)) == NULL){
+			goto failed;
+		}
+	}
+	queue_jobs(queued, value);
+	free(queued);
+
+	return 0;
+
+failed:
+	// Nothing is queued yet, so the loaded jobs are only in core_array, which scheduler_clean_up frees, and queued
+	for(long i=0; i<queued_count; i++){
+		free(queued[i]);
+	}
+	free(queued);
+	scheduler_clean_up();
+	return -1;
+}
+
+
+static job_t* copy_job(const job_t* job){
+	job_t* copy = malloc(sizeof(job_t));
+	memcpy(copy, job, sizeof(job_t));
+	return copy;
+}
+
+
+/**
+  Creates an independent copy of the current scheduler, jobs included, to
+  continue the same run under another scheme. The current scheduler stays
+  current; attach the copy on the thread that is going to drive it.
+
+  @param scheme the scheme the copy continues with, or -1 to keep the current one.
+  @return the new scheduler instance
+ */
+scheduler_t* scheduler_clone(int scheme)
+{
+	scheduler_t* source = scheduler;
+	int cores = source->num_cores;
+
+	scheduler_start_up(cores, scheme < 0 ? (int)source->scheme : scheme);
+	scheduler_t* clone = scheduler;
+	scheduler = source;
+
+	clone->total_jobs = source->total_jobs;
+	clone->total_wait = source->total_wait;
+	clone->total_turnaround = source->total_turnaround;
+	clone->total_response = source->total_response;
+	clone->max_queue_depth = source->max_queue_depth;
+	clone->affinity_window = source->affinity_window;
+	clone->num_sockets = source->num_sockets;
+	clone->global_pass = source->global_pass;
+	clone->rng = source->rng;
+	clone->backfill = source->backfill;
+	clone->gang_time = source->gang_time;
+	clone->fragmented_time = source->fragmented_time;
+	clone->backfilled = source->backfilled;
+	memcpy(clone->core_speed, source->core_speed, cores * sizeof(int));
+	memcpy(clone->core_socket, source->core_socket, cores * sizeof(int));
+	memcpy(clone->busy_since, source->busy_since, cores * sizeof(int));
+	memcpy(clone->work_since, source->work_since, cores * sizeof(int));
+	memcpy(clone->last_job, source->last_job, cores * sizeof(int));
+	memcpy(clone->core_stats, source->core_stats, cores * sizeof(scheduler_core_stats_t));
+
+	for(int i=0; i<cores; i++){
+		if(source->core_array[i] != NULL){
+			// A gang job is on several cores, and stays one job in the copy
+			int first = 0;
+			while(source->core_array[first] != source->core_array[i]){
+				first = first +1;
+			}
+			clone->core_array[i] = first < i ? clone->core_array[first] : copy_job(source->core_array[i]);
+		}
+		clone->run_remaining[i] = source->run_remaining[i];
+		clone->run_carry[i] = source->run_carry[i];
+		clone->run_priority[i] = source->run_priority[i];
+		clone->run_arrival[i] = source->run_arrival[i];
+		clone->run_group[i] = source->run_group[i];
+	}
+
+	clone->blocked_count = source->blocked_count;
+	clone->blocked_capacity = source->blocked_count;
+	clone->blocked = malloc(source->blocked_count * sizeof(job_t*));
+	for(int i=0; i<source->blocked_count; i++){
+		clone->blocked[i] = copy_job(source->blocked[i]);
+	}
+
+	job_t** queued = malloc((queued_jobs() + 1) * sizeof(job_t*));
+	int queued_count = queued_to_array(queued);
+	for(int i=0; i<queued_count; i++){
+		queued[i] = copy_job(queued[i]);
+	}
+	scheduler = clone;
+	if(source->grouped && clone->scheme != LOTTERY){
+		for(int i=0; i<source->group_count; i++){
+			group_t* group = find_group(i);
+			group->weight = source->groups[i]->weight;
+			group->vruntime = source->groups[i]->vruntime;
+			group->stats = source->groups[i]->stats;
+		}
+		clone->grouped = 1;
+		clone->group_clock = source->group_clock;
+	}
+	queue_jobs(queued, queued_count);
+	scheduler = source;
+	free(queued);
+
+	return clone;
+}
+
+
+/**
+  Returns the calling thread's current scheduler instance.
+ */
+scheduler_t* scheduler_current()
+{
+	return scheduler;
+}
+
+
+/**
+  Makes instance the calling thread's current scheduler. A thread that calls
+  into a scheduler started on another thread must attach it first.
+ */
+void scheduler_attach(scheduler_t* instance)
+{
+	scheduler = instance;
+}
+
+
+#ifdef SCHED_INSTRUMENT
+static const char* scheme_names[] = { "FCFS", "SJF", "PSJF", "PRI", "PPRI", "RR", "STRIDE", "LOTTERY" };
+#endif
+
+
+/**
+  Free any memory associated with your scheduler, including the jobs that
+  have not finished. With -DSCHED_INSTRUMENT,
+  first writes the latency of the decisions and queue operations made on the
+  calling thread, and on threads that have exited since, to stderr.
 
   Assumptions:
     - This function will be the last function called in your library.
 */
 void scheduler_clean_up()
 {
+#ifdef SCHED_INSTRUMENT
+	char title[128];
+	snprintf(title, sizeof(title), "Scheduler instrumentation: %s on %d core(s), %d job(s) finished, queue depth up to %d",
+			scheme_names[scheduler->scheme], scheduler->num_cores, scheduler->total_jobs, scheduler->max_queue_depth);
+	fflush(stdout);  // keep the report from landing in the middle of buffered output
+	instrument_dump(stderr, title);
+#endif
+
+	// A run cut short, as a forked branch or a tuning candidate may be, leaves jobs on the cores, in the
+	// queue and blocked on I/O. A gang job sits on every core it was given, so it is taken off all of them
+	// before it is freed.
+	for(int i=0; i<scheduler->num_cores; i++){
+		job_t* job = scheduler->core_array[i];
+		if(job != NULL){
+			for(int j=i; j<scheduler->num_cores; j++){
+				if(scheduler->core_array[j] == job){
+					scheduler->core_array[j] = NULL;
+				}
+			}
+			free(job);
+		}
+	}
+	for(int i=0; i<scheduler->blocked_count; i++){
+		free(scheduler->blocked[i]);
+	}
+	// The queues may still compare their jobs while they are destroyed, so those are freed last
+	job_t** queued = malloc((queued_jobs() + 1) * sizeof(job_t*));
+	int queued_count = queued_to_array(queued);
+
 	priqueue_destroy(scheduler->priqueue);
 	free(scheduler->core_array);
+	free(scheduler->core_stats);
+	free(scheduler->busy_since);
+	free(scheduler->work_since);
+	free(scheduler->last_job);
+	free(scheduler->core_speed);
+	free(scheduler->core_socket);
+	free(scheduler->blocked);
+	free(scheduler->lottery_tree);
+	free(scheduler->lottery_slot);
+	free(scheduler->lottery_free);
+	for(int i=0; i<scheduler->group_count; i++){
+		priqueue_destroy(&scheduler->groups[i]->queue);
+		free(scheduler->groups[i]);
+	}
+	free(scheduler->groups);
+	free(scheduler->group_heap);
+	free(scheduler->run_remaining);
+	free(scheduler->run_carry);
+	free(scheduler->run_priority);
+	free(scheduler->run_arrival);
+	free(scheduler->run_group);
+	free(scheduler->victim_keys);
+	free(scheduler->victim_ties);
 	free(scheduler->priqueue);
 	free(scheduler);
+	scheduler = NULL;
+
+	for(int i=0; i<queued_count; i++){
+		free(queued[i]);
+	}
+	free(queued);
 }
 
 
@@ -448,8 +2217,27 @@ void scheduler_show_queue()
 	// 	printf("Core: %d - Job priority: %d \n", i, pri);
 	// }
 	job_t* temp = NULL;
-	for(int i=0; i<priqueue_size(scheduler->priqueue); i++){
-		temp = priqueue_at(scheduler->priqueue, i);
+	priqueue_iterator_t it;
+	if(scheduler->scheme == LOTTERY){
+		job_t** jobs = malloc((queued_jobs() + 1) * sizeof(job_t*));
+		int n = lottery_to_array(jobs);
+		for(int i=0; i<n; i++){
+			printf(" (%d)%d ", jobs[i]->id, jobs[i]->priority);
+		}
+		free(jobs);
+		return;
+	}
+	if(scheduler->grouped){
+		for(int i=0; i<scheduler->group_count; i++){
+			priqueue_iterator(&scheduler->groups[i]->queue, &it);
+			while((temp = priqueue_next(&it)) != NULL){
+				printf(" (%d)%d ", temp->id, temp->priority);
+			}
+		}
+		return;
+	}
+	priqueue_iterator(scheduler->priqueue, &it);
+	while((temp = priqueue_next(&it)) != NULL){
 		printf(" (%d)%d ", temp->id, temp->priority);
 	}
 
@@ -4,20 +4,167 @@
 #ifndef LIBSCHEDULER_H_
 #define LIBSCHEDULER_H_
 
+#include <stdio.h>
+
 /**
   Constants which represent the different scheduling algorithms
 */
-typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR} scheme_t;
+typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR, STRIDE, LOTTERY} scheme_t;
+
+/**
+  Whether jobs under a scheme run a quantum at a time. Under the proportional
+  share schemes, STRIDE and LOTTERY, a job's priority is its number of tickets.
+*/
+#define SCHEME_TIME_SLICED(scheme) ((scheme) == RR || (scheme) == STRIDE || (scheme) == LOTTERY)
+
+/**
+  Data structures the scheduler can keep its queue in
+*/
+typedef enum {QUEUE_LIST = 0, QUEUE_KEYED, QUEUE_RING, QUEUE_HEAP} queue_backend_t;
+
+/**
+  How a job that needs several cores is let past by jobs queued behind it
+*/
+typedef enum {BACKFILL_NONE = 0, BACKFILL_EASY} backfill_t;
+
+/**
+  A scheduler instance. Every scheduler function works on the calling
+  thread's current instance, so several simulations can run side by side on
+  different threads.
+*/
+typedef struct _scheduler_t scheduler_t;
+
+/**
+  One of several jobs arriving at the same time
+*/
+typedef struct _scheduler_job_batch_t
+{
+	int job_number;
+	int running_time;
+	int priority;
+	int group;
+} scheduler_job_batch_t;
 
+/**
+  Overhead counters kept by the scheduler for a single core
+*/
+typedef struct _scheduler_core_stats_t
+{
+	int busy_time;
+	int idle_time;
+	int context_switches;
+	int preemptions;
+	int requeues;
+	int migrations;
+} scheduler_core_stats_t;
+
+/**
+  Service and job statistics of a single tenant group
+*/
+typedef struct _scheduler_group_stats_t
+{
+	int weight;
+	int jobs_finished;
+	int cpu_time;
+	float total_waiting;
+	float total_turnaround;
+	float total_response;
+} scheduler_group_stats_t;
+
+/**
+  Overhead counters summed over every core for the active scheme
+*/
+typedef struct _scheduler_stats_t
+{
+	scheme_t scheme;
+	int cores;
+	int busy_time;
+	int idle_time;
+	int context_switches;
+	int preemptions;
+	int requeues;
+	int migrations;
+	int max_queue_depth;
+	int jobs_finished;
+	int fragmented_time;
+	int backfilled;
+	float total_waiting;
+	float total_turnaround;
+	float total_response;
+} scheduler_stats_t;
+
+/**
+  Waiting, turnaround and response time of a single finished job
+*/
+typedef struct _scheduler_job_stats_t
+{
+	int job_number;
+	int waiting_time;
+	int turnaround_time;
+	int response_time;
+} scheduler_job_stats_t;
+
+void  scheduler_set_queue_backend      (queue_backend_t backend);
 void  scheduler_start_up               (int cores, scheme_t scheme);
+void  scheduler_set_affinity           (int window);
+void  scheduler_set_seed               (unsigned long seed);
+void  scheduler_set_topology           (const int *speed, const int *socket);
 int   scheduler_new_job                (int job_number, int time, int running_time, int priority);
+int   scheduler_new_job_in_group       (int job_number, int time, int running_time, int priority, int group);
+int   scheduler_new_jobs               (const scheduler_job_batch_t *batch, int n, int time, int *cores);
 int   scheduler_job_finished           (int core_id, int job_number, int time);
 int   scheduler_quantum_expired        (int core_id, int time);
+int   scheduler_job_blocked            (int core_id, int job_number, int time);
+int   scheduler_job_unblocked          (int job_number, int time, int running_time);
+void  scheduler_switch_stall           (int core_id, int time_units);
+void  scheduler_set_group_weight       (int group, int weight);
+int   scheduler_group_count            ();
+void  scheduler_group_stats            (int group, scheduler_group_stats_t *stats);
+void  scheduler_set_backfill           (backfill_t backfill);
+void  scheduler_new_gang_job           (int job_number, int time, int running_time, int priority, int cores_needed);
+void  scheduler_gang_job_finished      (int job_number, int time);
+int   scheduler_gang_dispatch          (int time, int *core_jobs);
 float scheduler_average_turnaround_time();
 float scheduler_average_waiting_time   ();
 float scheduler_average_response_time  ();
+void  scheduler_core_stats             (int core_id, int time, scheduler_core_stats_t *stats);
+void  scheduler_stats                  (int time, scheduler_stats_t *stats);
+void  scheduler_last_finished          (scheduler_job_stats_t *stats);
+int   scheduler_queue_depth            ();
+void  scheduler_save                   (FILE *file);
+int   scheduler_load                   (FILE *file, int scheme);
+scheduler_t *scheduler_clone           (int scheme);
+scheduler_t *scheduler_current         ();
+void  scheduler_attach                 (scheduler_t *instance);
 void  scheduler_clean_up               ();
 
 void  scheduler_show_queue             ();
 
+/**
+  With -DSCHED_INSTRUMENT every scheduling decision made outside
+  libscheduler.c is timed, and scheduler_clean_up writes the latencies to
+  stderr. Queue operations made by a decision are timed as well, so the
+  decision's latency includes their clock reads.
+*/
+#if defined(SCHED_INSTRUMENT) && !defined(LIBSCHEDULER_IMPLEMENTATION)
+#include "../libinstrument/libinstrument.h"
+
+#define scheduler_new_job(job_number, time, running_time, priority) \
+	INSTRUMENT_CALL(INSTRUMENT_NEW_JOB, scheduler_new_job(job_number, time, running_time, priority))
+#define scheduler_new_job_in_group(job_number, time, running_time, priority, group) \
+	INSTRUMENT_CALL(INSTRUMENT_NEW_JOB_IN_GROUP, scheduler_new_job_in_group(job_number, time, running_time, priority, group))
+#define scheduler_new_jobs(batch, n, time, cores) \
+	INSTRUMENT_CALL(INSTRUMENT_NEW_JOBS, scheduler_new_jobs(batch, n, time, cores))
+#define scheduler_job_finished(core_id, job_number, time) \
+	INSTRUMENT_CALL(INSTRUMENT_JOB_FINISHED, scheduler_job_finished(core_id, job_number, time))
+#define scheduler_quantum_expired(core_id, time) \
+	INSTRUMENT_CALL(INSTRUMENT_QUANTUM_EXPIRED, scheduler_quantum_expired(core_id, time))
+#define scheduler_job_blocked(core_id, job_number, time) \
+	INSTRUMENT_CALL(INSTRUMENT_JOB_BLOCKED, scheduler_job_blocked(core_id, job_number, time))
+#define scheduler_job_unblocked(job_number, time, running_time) \
+	INSTRUMENT_CALL(INSTRUMENT_JOB_UNBLOCKED, scheduler_job_unblocked(job_number, time, running_time))
+#define scheduler_gang_dispatch(time, core_jobs) \
+	INSTRUMENT_CALL(INSTRUMENT_GANG_DISPATCH, scheduler_gang_dispatch(time, core_jobs))
+#endif
+
 #endif /* LIBSCHEDULER_H_ */
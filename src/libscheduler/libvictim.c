@@ -0,0 +1,521 @@
+/** @file libvictim.c
+
+  Kernels over the packed per-core keys the scheduler keeps of its running
+  jobs (remaining time as of dispatch, priority, arrival time and group),
+  from which it picks the job an arriving job preempts. Streaming over plain
+  int arrays instead of a job_t pointer per core lets each step cover 8 cores
+  with AVX2 or 4 with SSE4.1. The instruction set is picked once, from what
+  the processor supports, unless victim_use asks for another, and the scalar
+  kernels serve everywhere else and for the last few cores of each array.
+ */
+
+#include <pthread.h>
+
+#include "libvictim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VICTIM_X86
+#endif
+
+
+typedef struct _victim_kernels_t
+{
+	int (*remaining)(int*, const int*, const int*, const int*, const int*, const int*, int, int, int);
+	int (*keys)(int*, const int*, const int*, int, int);
+	int (*find)(const int*, int, int, int);
+	int (*find_all)(const int*, int, int*, int);
+	int (*find_last_above)(const int*, int, const int*, int);
+} victim_kernels_t;
+
+
+static int valid(int group, int only_group){
+	return only_group < 0 ? group >= 0 : group == only_group;
+}
+
+
+static int remaining_scalar(int* keys, const int* remaining, const int* carry, const int* since, const int* speed, const int* group, int only_group, int time, int n){
+	int max = VICTIM_NONE;
+	for(int i=0; i<n; i++){
+		int elapsed = time > since[i] ? time - since[i] : 0;
+		keys[i] = valid(group[i], only_group) ? remaining[i] - (carry[i] + elapsed * speed[i]) / 100 : VICTIM_NONE;
+		if(keys[i] > max){
+			max = keys[i];
+		}
+	}
+	return max;
+}
+
+
+static int keys_scalar(int* keys, const int* key, const int* group, int only_group, int n){
+	int max = VICTIM_NONE;
+	for(int i=0; i<n; i++){
+		keys[i] = valid(group[i], only_group) ? key[i] : VICTIM_NONE;
+		if(keys[i] > max){
+			max = keys[i];
+		}
+	}
+	return max;
+}
+
+
+static int find_scalar(const int* keys, int value, int from, int n){
+	for(int i=from; i<n; i++){
+		if(keys[i] == value){
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+static int find_all_scalar(const int* keys, int value, int* cores, int n){
+	int count = 0;
+	for(int i=0; i<n; i++){
+		if(keys[i] == value){
+			cores[count++] = i;
+		}
+	}
+	return count;
+}
+
+
+static int find_last_above_scalar(const int* keys, int value, const int* second, int n){
+	for(int i=n-1; i>=0; i--){
+		if(keys[i] == value && second[i] > value){
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+static const victim_kernels_t scalar_kernels = { remaining_scalar, keys_scalar, find_scalar, find_all_scalar, find_last_above_scalar };
+
+
+#ifdef VICTIM_X86
+
+/*
+ * Progress is (carry + (time - since) * speed) / 100, with no progress before
+ * since. There is no vector division, so x / 100 is taken as
+ * (x * 0x51EB851F) >> 37, exact for every non-negative int, on the even and
+ * the odd 32 bit lanes in turn.
+ */
+
+__attribute__((target("avx2")))
+static __m256i divide_100_avx2(__m256i x){
+	__m256i magic = _mm256_set1_epi32(0x51EB851F);
+	__m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, magic), 37);
+	__m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), magic), 37);
+	return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+
+__attribute__((target("avx2")))
+static __m256i valid_avx2(const int* group, int only_group){
+	__m256i g = _mm256_loadu_si256((const __m256i*)group);
+	if(only_group < 0){
+		return _mm256_cmpgt_epi32(g, _mm256_set1_epi32(-1));
+	}
+	return _mm256_cmpeq_epi32(g, _mm256_set1_epi32(only_group));
+}
+
+
+__attribute__((target("avx2")))
+static int max_avx2(__m256i v){
+	__m128i m = _mm_max_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(m);
+}
+
+
+__attribute__((target("avx2")))
+static int remaining_avx2(int* keys, const int* remaining, const int* carry, const int* since, const int* speed, const int* group, int only_group, int time, int n){
+	__m256i none = _mm256_set1_epi32(VICTIM_NONE), now = _mm256_set1_epi32(time), zero = _mm256_setzero_si256(), max = none;
+	int i = 0;
+
+	for(; i + 8 <= n; i += 8){
+		__m256i elapsed = _mm256_max_epi32(_mm256_sub_epi32(now, _mm256_loadu_si256((const __m256i*)(since + i))), zero);
+		__m256i work = _mm256_mullo_epi32(elapsed, _mm256_loadu_si256((const __m256i*)(speed + i)));
+		__m256i progress = divide_100_avx2(_mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(carry + i)), work));
+		__m256i left = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(remaining + i)), progress);
+		left = _mm256_blendv_epi8(none, left, valid_avx2(group + i, only_group));
+		_mm256_storeu_si256((__m256i*)(keys + i), left);
+		max = _mm256_max_epi32(max, left);
+	}
+
+	int result = max_avx2(max);
+	int tail = remaining_scalar(keys + i, remaining + i, carry + i, since + i, speed + i, group + i, only_group, time, n - i);
+	return tail > result ? tail : result;
+}
+
+
+__attribute__((target("avx2")))
+static int keys_avx2(int* keys, const int* key, const int* group, int only_group, int n){
+	__m256i none = _mm256_set1_epi32(VICTIM_NONE), max = none;
+	int i = 0;
+
+	for(; i + 8 <= n; i += 8){
+		__m256i k = _mm256_blendv_epi8(none, _mm256_loadu_si256((const __m256i*)(key + i)), valid_avx2(group + i, only_group));
+		_mm256_storeu_si256((__m256i*)(keys + i), k);
+		max = _mm256_max_epi32(max, k);
+	}
+
+	int result = max_avx2(max);
+	int tail = keys_scalar(keys + i, key + i, group + i, only_group, n - i);
+	return tail > result ? tail : result;
+}
+
+
+__attribute__((target("avx2")))
+static int find_avx2(const int* keys, int value, int from, int n){
+	__m256i v = _mm256_set1_epi32(value);
+	int i = from;
+
+	for(; i + 8 <= n; i += 8){
+		__m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(keys + i)), v);
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(equal));
+		if(mask){
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return find_scalar(keys, value, i, n);
+}
+
+
+__attribute__((target("avx2")))
+static int find_all_avx2(const int* keys, int value, int* cores, int n){
+	__m256i v = _mm256_set1_epi32(value);
+	int i = 0, count = 0;
+
+	for(; i + 8 <= n; i += 8){
+		__m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(keys + i)), v);
+		for(int mask = _mm256_movemask_ps(_mm256_castsi256_ps(equal)); mask; mask &= mask - 1){
+			cores[count++] = i + __builtin_ctz(mask);
+		}
+	}
+	for(; i < n; i++){
+		if(keys[i] == value){
+			cores[count++] = i;
+		}
+	}
+	return count;
+}
+
+
+__attribute__((target("avx2")))
+static int find_last_above_avx2(const int* keys, int value, const int* second, int n){
+	__m256i v = _mm256_set1_epi32(value);
+	int i = n - n % 8;
+
+	int found = find_last_above_scalar(keys + i, value, second + i, n - i);
+	if(found != -1){
+		return i + found;
+	}
+	for(i -= 8; i >= 0; i -= 8){
+		__m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(keys + i)), v);
+		__m256i above = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(second + i)), v);
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(equal, above)));
+		if(mask){
+			return i + 31 - __builtin_clz(mask);
+		}
+	}
+	return -1;
+}
+
+
+static const victim_kernels_t avx2_kernels = { remaining_avx2, keys_avx2, find_avx2, find_all_avx2, find_last_above_avx2 };
+
+
+__attribute__((target("sse4.1")))
+static __m128i divide_100_sse4(__m128i x){
+	__m128i magic = _mm_set1_epi32(0x51EB851F);
+	__m128i even = _mm_srli_epi64(_mm_mul_epu32(x, magic), 37);
+	__m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), magic), 37);
+	return _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+}
+
+
+__attribute__((target("sse4.1")))
+static __m128i valid_sse4(const int* group, int only_group){
+	__m128i g = _mm_loadu_si128((const __m128i*)group);
+	if(only_group < 0){
+		return _mm_cmpgt_epi32(g, _mm_set1_epi32(-1));
+	}
+	return _mm_cmpeq_epi32(g, _mm_set1_epi32(only_group));
+}
+
+
+__attribute__((target("sse4.1")))
+static int max_sse4(__m128i m){
+	m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(m);
+}
+
+
+__attribute__((target("sse4.1")))
+static int remaining_sse4(int* keys, const int* remaining, const int* carry, const int* since, const int* speed, const int* group, int only_group, int time, int n){
+	__m128i none = _mm_set1_epi32(VICTIM_NONE), now = _mm_set1_epi32(time), zero = _mm_setzero_si128(), max = none;
+	int i = 0;
+
+	for(; i + 4 <= n; i += 4){
+		__m128i elapsed = _mm_max_epi32(_mm_sub_epi32(now, _mm_loadu_si128((const __m128i*)(since + i))), zero);
+		__m128i work = _mm_mullo_epi32(elapsed, _mm_loadu_si128((const __m128i*)(speed + i)));
+		__m128i progress = divide_100_sse4(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(carry + i)), work));
+		__m128i left = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(remaining + i)), progress);
+		left = _mm_blendv_epi8(none, left, valid_sse4(group + i, only_group));
+		_mm_storeu_si128((__m128i*)(keys + i), left);
+		max = _mm_max_epi32(max, left);
+	}
+
+	int result = max_sse4(max);
+	int tail = remaining_scalar(keys + i, remaining + i, carry + i, since + i, speed + i, group + i, only_group, time, n - i);
+	return tail > result ? tail : result;
+}
+
+
+__attribute__((target("sse4.1")))
+static int keys_sse4(int* keys, const int* key, const int* group, int only_group, int n){
+	__m128i none = _mm_set1_epi32(VICTIM_NONE), max = none;
+	int i = 0;
+
+	for(; i + 4 <= n; i += 4){
+		__m128i k = _mm_blendv_epi8(none, _mm_loadu_si128((const __m128i*)(key + i)), valid_sse4(group + i, only_group));
+		_mm_storeu_si128((__m128i*)(keys + i), k);
+		max = _mm_max_epi32(max, k);
+	}
+
+	int result = max_sse4(max);
+	int tail = keys_scalar(keys + i, key + i, group + i, only_group, n - i);
+	return tail > result ? tail : result;
+}
+
+
+__attribute__((target("sse4.1")))
+static int find_sse4(const int* keys, int value, int from, int n){
+	__m128i v = _mm_set1_epi32(value);
+	int i = from;
+
+	for(; i + 4 <= n; i += 4){
+		__m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(keys + i)), v);
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+		if(mask){
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return find_scalar(keys, value, i, n);
+}
+
+
+__attribute__((target("sse4.1")))
+static int find_all_sse4(const int* keys, int value, int* cores, int n){
+	__m128i v = _mm_set1_epi32(value);
+	int i = 0, count = 0;
+
+	for(; i + 4 <= n; i += 4){
+		__m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(keys + i)), v);
+		for(int mask = _mm_movemask_ps(_mm_castsi128_ps(equal)); mask; mask &= mask - 1){
+			cores[count++] = i + __builtin_ctz(mask);
+		}
+	}
+	for(; i < n; i++){
+		if(keys[i] == value){
+			cores[count++] = i;
+		}
+	}
+	return count;
+}
+
+
+__attribute__((target("sse4.1")))
+static int find_last_above_sse4(const int* keys, int value, const int* second, int n){
+	__m128i v = _mm_set1_epi32(value);
+	int i = n - n % 4;
+
+	int found = find_last_above_scalar(keys + i, value, second + i, n - i);
+	if(found != -1){
+		return i + found;
+	}
+	for(i -= 4; i >= 0; i -= 4){
+		__m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(keys + i)), v);
+		__m128i above = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(second + i)), v);
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(equal, above)));
+		if(mask){
+			return i + 31 - __builtin_clz(mask);
+		}
+	}
+	return -1;
+}
+
+
+static const victim_kernels_t sse4_kernels = { remaining_sse4, keys_sse4, find_sse4, find_all_sse4, find_last_above_sse4 };
+
+#endif /* VICTIM_X86 */
+
+
+static const victim_kernels_t* kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+
+static const victim_kernels_t* kernels_for(victim_isa_t isa){
+#ifdef VICTIM_X86
+	if(isa == VICTIM_AVX2){
+		return &avx2_kernels;
+	}
+	if(isa == VICTIM_SSE4){
+		return &sse4_kernels;
+	}
+#endif
+	return &scalar_kernels;
+}
+
+
+static void pick_kernels(){
+	kernels = kernels_for(victim_best_isa());
+}
+
+
+static const victim_kernels_t* current(){
+	pthread_once(&kernels_once, pick_kernels);
+	return kernels;
+}
+
+
+/**
+  The widest instruction set the processor supports.
+
+  @return the instruction set
+ */
+victim_isa_t victim_best_isa()
+{
+#ifdef VICTIM_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")){
+		return VICTIM_AVX2;
+	}
+	if(__builtin_cpu_supports("sse4.1")){
+		return VICTIM_SSE4;
+	}
+#endif
+	return VICTIM_SCALAR;
+}
+
+
+/**
+  Runs the kernels under isa from now on, or under the widest instruction set
+  the processor supports if it does not support isa. Meant for comparing them
+  before any scheduler runs; by default the widest one is used.
+
+  @param isa the instruction set.
+  @return the instruction set the kernels now run under
+ */
+victim_isa_t victim_use(victim_isa_t isa)
+{
+	pthread_once(&kernels_once, pick_kernels);
+
+	victim_isa_t best = victim_best_isa();
+	if(isa > best){
+		isa = best;
+	}
+
+	kernels = kernels_for(isa);
+	return isa;
+}
+
+
+/**
+  Name of an instruction set, for reports.
+
+  @param isa the instruction set.
+  @return its name
+ */
+const char* victim_isa_name(victim_isa_t isa)
+{
+	if(isa == VICTIM_AVX2){
+		return "avx2";
+	}
+	if(isa == VICTIM_SSE4){
+		return "sse4.1";
+	}
+	return "scalar";
+}
+
+
+/**
+  Fills keys with the remaining time of the job on each core as of time, and
+  VICTIM_NONE for the cores that hold no candidate.
+
+  @param keys where to write the n keys.
+  @param remaining the job's remaining time when it was dispatched, by core.
+  @param carry the hundredths of a time unit of work the job had done beyond
+  that, below one time unit, when it was dispatched.
+  @param since the time each core's job started working, after any switch;
+  it has done no work before.
+  @param speed each core's speed in percent; the job has done (carry + (time - since) * speed) / 100 since.
+  @param group the group of each core's job, -1 for an idle core.
+  @param only_group the group whose jobs are candidates, or -1 for every running job.
+  @param time the current time.
+  @param n the number of cores.
+  @return the largest key
+  @return VICTIM_NONE if no core holds a candidate
+ */
+int victim_remaining(int* keys, const int* remaining, const int* carry, const int* since, const int* speed, const int* group, int only_group, int time, int n)
+{
+	return current()->remaining(keys, remaining, carry, since, speed, group, only_group, time, n);
+}
+
+
+/**
+  Fills keys with key on the cores that hold a candidate, and VICTIM_NONE on
+  the others.
+
+  @param keys where to write the n keys.
+  @param key the key of each core's job.
+  @param group the group of each core's job, -1 for an idle core.
+  @param only_group the group whose jobs are candidates, or -1 for every running job.
+  @param n the number of cores.
+  @return the largest key
+  @return VICTIM_NONE if no core holds a candidate
+ */
+int victim_keys(int* keys, const int* key, const int* group, int only_group, int n)
+{
+	return current()->keys(keys, key, group, only_group, n);
+}
+
+
+/**
+  First core from core from on whose key is value.
+
+  @return the core
+  @return -1 if there is none
+ */
+int victim_find(const int* keys, int value, int from, int n)
+{
+	return current()->find(keys, value, from, n);
+}
+
+
+/**
+  Every core whose key is value, in order.
+
+  @param cores where to write them, room for n.
+  @return how many there are
+ */
+int victim_find_all(const int* keys, int value, int* cores, int n)
+{
+	return current()->find_all(keys, value, cores, n);
+}
+
+
+/**
+  Last core whose key is value and whose second key is above value.
+
+  @return the core
+  @return -1 if there is none
+ */
+int victim_find_last_above(const int* keys, int value, const int* second, int n)
+{
+	return current()->find_last_above(keys, value, second, n);
+}
@@ -0,0 +1,29 @@
+/** @file libvictim.h
+ */
+
+#ifndef LIBVICTIM_H_
+#define LIBVICTIM_H_
+
+/**
+  Instruction sets the victim kernels come in. Every kernel gives the same
+  result under each of them.
+*/
+typedef enum {VICTIM_SCALAR = 0, VICTIM_SSE4, VICTIM_AVX2} victim_isa_t;
+
+/**
+  The key of a core that holds no candidate: below every real key, so the
+  cores are searched as one packed array without skipping any.
+*/
+#define VICTIM_NONE (-2147483647 - 1)
+
+victim_isa_t victim_best_isa       ();
+victim_isa_t victim_use            (victim_isa_t isa);
+const char*  victim_isa_name       (victim_isa_t isa);
+
+int victim_remaining      (int* keys, const int* remaining, const int* carry, const int* since, const int* speed, const int* group, int only_group, int time, int n);
+int victim_keys           (int* keys, const int* key, const int* group, int only_group, int n);
+int victim_find           (const int* keys, int value, int from, int n);
+int victim_find_all       (const int* keys, int value, int* cores, int n);
+int victim_find_last_above(const int* keys, int value, const int* second, int n);
+
+#endif /* LIBVICTIM_H_ */
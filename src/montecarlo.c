@@ -0,0 +1,393 @@
+/** @file montecarlo.c
+
+  Estimates how schemes compare on a workload rather than on one trace.
+  Every run draws a random trace from a workload model, seeded by the run's
+  number, and simulates every scheme on it; the runs are spread over a pool
+  of threads. Each metric of each scheme is folded into a running mean and
+  variance (Welford's method) as soon as its run is over, so memory stays
+  the same however many runs there are: one trace per thread, and a few
+  numbers per metric.
+
+  Since every scheme sees the same traces, the difference between a scheme
+  and the first one is also estimated run by run, which takes out the
+  variation between traces and gives a much tighter interval than the two
+  separate ones would suggest.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "montecarlo.h"
+
+
+/**
+  A running count, mean and sum of squared deviations from the mean
+*/
+typedef struct _welford_t
+{
+	long count;
+	double mean, m2;
+} welford_t;
+
+typedef struct _montecarlo_worker_t
+{
+	pthread_t thread;
+	int started;            // whether the worker has a thread of its own to join
+	int first;              // the worker runs first, first + stride, first + 2 * stride, ...
+	welford_t *metric;      // by scheme, then metric
+	welford_t *difference;  // by scheme, then metric, from the first scheme
+	int *failed;            // by scheme
+	simulator_job_list_t *trace;
+} montecarlo_worker_t;
+
+// Student's t for a 95% two-sided interval, by degrees of freedom from 1
+static const double t_quantiles[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+static const simulation_t *montecarlo_sim;
+static const workload_t *montecarlo_model;
+static montecarlo_result_t *montecarlo_results;
+static int montecarlo_schemes, montecarlo_runs, montecarlo_stride, montecarlo_heterogeneous;
+static unsigned long montecarlo_seed;
+
+#define DIFFERENCES (MONTECARLO_RESPONSE + 1)
+
+
+static void welford_add(welford_t *w, double x)
+{
+	double delta = x - w->mean;
+
+	w->count++;
+	w->mean += delta / w->count;
+	w->m2 += delta * (x - w->mean);
+}
+
+
+/**
+  Folds the runs of from into into, as if into had seen them all itself.
+*/
+static void welford_merge(welford_t *into, const welford_t *from)
+{
+	long count = into->count + from->count;
+	double delta = from->mean - into->mean;
+
+	if (from->count == 0)
+		return;
+
+	into->m2 += from->m2 + delta * delta * into->count * from->count / count;
+	into->mean += delta * from->count / count;
+	into->count = count;
+}
+
+
+static montecarlo_estimate_t welford_estimate(const welford_t *w)
+{
+	montecarlo_estimate_t estimate = { w->mean, 0, 0 };
+
+	if (w->count > 1)
+	{
+		long df = w->count - 1;
+		double t = df <= 30 ? t_quantiles[df - 1] : 1.96 + 2.5 / df;
+
+		estimate.deviation = sqrt(w->m2 / df);
+		estimate.half_width = t * estimate.deviation / sqrt(w->count);
+	}
+	return estimate;
+}
+
+
+static uint64_t next_random(uint64_t *state)
+{
+	// splitmix64
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+
+static double draw(const workload_distribution_t *distribution, uint64_t *state)
+{
+	if (distribution->uniform)
+	{
+		long lo = (long)ceil(distribution->a), hi = (long)floor(distribution->b);
+		return lo + (long)(next_random(state) % (uint64_t)(hi - lo + 1));
+	}
+
+	return -distribution->a * log(1 - (next_random(state) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+/**
+  Draws the trace of run number run into trace. The same run always gets the
+  same trace, whichever thread draws it.
+*/
+static void draw_trace(simulator_job_list_t *trace, int run)
+{
+	const workload_t *model = montecarlo_model;
+	uint64_t state = montecarlo_seed * 0xD1B54A32D192ED03ULL + run;
+	int arrival_time = 0;
+
+	memset(trace, 0, model->jobs * sizeof(simulator_job_list_t));
+	for (int i = 0; i < model->jobs; i++)
+	{
+		int run_time = (int)ceil(draw(&model->run_time, &state));
+
+		if (i > 0)
+			arrival_time += (int)(draw(&model->interarrival, &state) + 0.5);
+
+		trace[i].job_id = i;
+		trace[i].arrival_time = arrival_time;
+		trace[i].run_time = run_time > 0 ? run_time : 1;
+		trace[i].priority = next_random(&state) % model->priorities;
+		trace[i].core_id = -1;
+		trace[i].last_core = -1;
+		trace[i].work = trace[i].run_time * 100;
+		trace[i].cores_needed = 1;
+		trace[i].burst_count = 1;
+		trace[i].io_device = -1;
+	}
+}
+
+
+/**
+  Simulates one scheme on a trace, on a scheduler of the calling thread's
+  own, and fills in every metric of the run.
+
+  @return SIMULATION_FINISHED, or SIMULATION_FAILED if the scheduler made an
+  invalid decision
+*/
+static int run_scheme(const simulator_job_list_t *trace, int scheme, int quantum, double *values)
+{
+	const simulation_t *model = montecarlo_sim;
+	simulator_job_list_t *jobs = malloc((montecarlo_model->jobs + 1) * sizeof(simulator_job_list_t));
+	scheduler_stats_t stats;
+	simulation_t sim;
+	int status;
+
+	memcpy(jobs, trace, montecarlo_model->jobs * sizeof(simulator_job_list_t));
+
+	scheduler_start_up(model->cores, scheme);
+	scheduler_set_affinity(model->affinity_window);
+	scheduler_set_seed(montecarlo_seed);
+	if (montecarlo_heterogeneous)
+		scheduler_set_topology(model->core_speed, model->core_socket);
+
+	simulation_init(&sim, model->cores, scheme, quantum, jobs, montecarlo_model->jobs, model->core_speed, model->core_socket);
+	sim.switch_cost_fixed = model->switch_cost_fixed;
+	sim.switch_cost_migration = model->switch_cost_migration;
+	sim.affinity_window = model->affinity_window;
+	sim.quiet = 1;
+	sim.record_diagram = 0;
+	sim.event_driven = 1;  // the results are the same either way, and jumping between events is much faster
+	simulation_set_io_devices(&sim, 1);
+
+	do
+		status = simulation_step(&sim);
+	while (status == SIMULATION_RUNNING);
+
+	scheduler_stats(sim.time, &stats);
+	values[MONTECARLO_WAITING] = stats.jobs_finished ? stats.total_waiting / stats.jobs_finished : 0;
+	values[MONTECARLO_TURNAROUND] = stats.jobs_finished ? stats.total_turnaround / stats.jobs_finished : 0;
+	values[MONTECARLO_RESPONSE] = stats.jobs_finished ? stats.total_response / stats.jobs_finished : 0;
+	values[MONTECARLO_UTILIZATION] = (stats.busy_time + stats.idle_time) ? 100.0 * stats.busy_time / (stats.busy_time + stats.idle_time) : 0;
+	values[MONTECARLO_SWITCHES] = stats.context_switches;
+	values[MONTECARLO_MAKESPAN] = sim.time;
+
+	scheduler_clean_up();
+	simulation_destroy(&sim);
+
+	return status;
+}
+
+
+static void *run_worker(void *arg)
+{
+	montecarlo_worker_t *worker = arg;
+	double first[MONTECARLO_METRICS], values[MONTECARLO_METRICS];
+	int s, m;
+
+	for (int run = worker->first; run < montecarlo_runs; run += montecarlo_stride)
+	{
+		int first_failed = 0;
+
+		draw_trace(worker->trace, run);
+		for (s = 0; s < montecarlo_schemes; s++)
+		{
+			if (run_scheme(worker->trace, montecarlo_results[s].scheme, montecarlo_results[s].quantum, values) == SIMULATION_FAILED)
+			{
+				worker->failed[s]++;
+				first_failed |= (s == 0);
+				continue;
+			}
+
+			for (m = 0; m < MONTECARLO_METRICS; m++)
+				welford_add(&worker->metric[s * MONTECARLO_METRICS + m], values[m]);
+
+			if (s == 0)
+				memcpy(first, values, sizeof(first));
+			else if (!first_failed)
+				for (m = 0; m < DIFFERENCES; m++)
+					welford_add(&worker->difference[s * DIFFERENCES + m], values[m] - first[m]);
+		}
+	}
+
+	return NULL;
+}
+
+
+static int parse_distribution(const char *value, workload_distribution_t *distribution)
+{
+	char *end;
+
+	if (strncasecmp(value, "uniform:", 8) == 0)
+	{
+		distribution->uniform = 1;
+		if (sscanf(value + 8, "%lf-%lf", &distribution->a, &distribution->b) != 2)
+			return -1;
+		return (distribution->a >= 0 && ceil(distribution->a) <= floor(distribution->b)) ? 0 : -1;
+	}
+
+	if (strncasecmp(value, "exp:", 4) == 0)
+		value += 4;
+
+	distribution->uniform = 0;
+	distribution->a = strtod(value, &end);
+	return (end != value && *end == '\0' && distribution->a > 0) ? 0 : -1;
+}
+
+
+/**
+  Parses a workload model of comma separated settings, any of
+  jobs=<n>, interarrival=<distribution>, run=<distribution> and
+  priorities=<n>, e.g. "jobs=200,interarrival=exp:2,run=uniform:1-20". A
+  distribution is exp:<mean> (or just <mean>) or uniform:<lo>-<hi>. Settings
+  not given keep the values model already holds.
+
+  @return 0 on success
+  @return -1 if the model is malformed
+*/
+int workload_parse(const char *spec, workload_t *model)
+{
+	char *copy = strdup(spec), *setting;
+	int result = 0;
+
+	for (setting = strtok(copy, ","); setting != NULL && result == 0; setting = strtok(NULL, ","))
+	{
+		char *value = strchr(setting, '=');
+
+		if (value == NULL)
+		{
+			result = -1;
+			break;
+		}
+		*value++ = '\0';
+
+		if (strcasecmp(setting, "jobs") == 0) { result = (model->jobs = atoi(value)) > 0 ? 0 : -1; }
+		else if (strcasecmp(setting, "interarrival") == 0) { result = parse_distribution(value, &model->interarrival); }
+		else if (strcasecmp(setting, "run") == 0) { result = parse_distribution(value, &model->run_time); }
+		else if (strcasecmp(setting, "priorities") == 0) { result = (model->priorities = atoi(value)) > 0 ? 0 : -1; }
+		else
+			result = -1;
+	}
+
+	free(copy);
+	return result;
+}
+
+
+/**
+  Simulates every scheme of results on runs random traces drawn from model,
+  and estimates the mean of each metric with its 95% confidence interval.
+
+  @param sim a simulation holding the cores and overheads every run uses, and no jobs.
+  @param model the workload the traces are drawn from.
+  @param runs the number of traces.
+  @param results the scheme and quantum of each configuration, filled in with its estimates.
+  @param scheme_count the number of configurations.
+  @param threads the number of threads the runs are spread over.
+  @param seed seed of the traces, and of every run's scheduler.
+  @return 0 on success
+  @return 3 if a scheduler made an invalid decision in some run
+ */
+int montecarlo_run(const simulation_t *sim, const workload_t *model, int runs, montecarlo_result_t *results, int scheme_count,
+		int threads, unsigned long seed)
+{
+	montecarlo_worker_t *workers;
+	int i, s, m, failed = 0;
+
+	if (threads > runs)
+		threads = runs;
+
+	montecarlo_sim = sim;
+	montecarlo_model = model;
+	montecarlo_results = results;
+	montecarlo_schemes = scheme_count;
+	montecarlo_runs = runs;
+	montecarlo_stride = threads;
+	montecarlo_seed = seed;
+	montecarlo_heterogeneous = 0;
+	for (i = 0; i < sim->cores; i++)
+		if (sim->core_speed[i] != 100 || sim->core_socket[i] != 0)
+			montecarlo_heterogeneous = 1;
+
+	workers = calloc(threads, sizeof(montecarlo_worker_t));
+	for (i = 0; i < threads; i++)
+	{
+		workers[i].first = i;
+		workers[i].metric = calloc(scheme_count * MONTECARLO_METRICS, sizeof(welford_t));
+		workers[i].difference = calloc(scheme_count * DIFFERENCES, sizeof(welford_t));
+		workers[i].failed = calloc(scheme_count, sizeof(int));
+		workers[i].trace = malloc((model->jobs + 1) * sizeof(simulator_job_list_t));
+	}
+
+	for (i = 1; i < threads; i++)
+		workers[i].started = pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) == 0;
+	run_worker(&workers[0]);
+	for (i = 1; i < threads; i++)
+		if (!workers[i].started)
+			run_worker(&workers[i]);
+
+	// Merged in the same order every time, so that a thread count always gives the same estimates
+	for (i = 1; i < threads; i++)
+	{
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+		for (s = 0; s < scheme_count; s++)
+		{
+			for (m = 0; m < MONTECARLO_METRICS; m++)
+				welford_merge(&workers[0].metric[s * MONTECARLO_METRICS + m], &workers[i].metric[s * MONTECARLO_METRICS + m]);
+			for (m = 0; m < DIFFERENCES; m++)
+				welford_merge(&workers[0].difference[s * DIFFERENCES + m], &workers[i].difference[s * DIFFERENCES + m]);
+			workers[0].failed[s] += workers[i].failed[s];
+		}
+	}
+
+	for (s = 0; s < scheme_count; s++)
+	{
+		results[s].runs = workers[0].metric[s * MONTECARLO_METRICS].count;
+		results[s].failed = workers[0].failed[s];
+		for (m = 0; m < MONTECARLO_METRICS; m++)
+			results[s].metric[m] = welford_estimate(&workers[0].metric[s * MONTECARLO_METRICS + m]);
+		for (m = 0; m < DIFFERENCES; m++)
+			results[s].difference[m] = welford_estimate(&workers[0].difference[s * DIFFERENCES + m]);
+		if (results[s].failed)
+			failed = 1;
+	}
+
+	for (i = 0; i < threads; i++)
+	{
+		free(workers[i].metric);
+		free(workers[i].difference);
+		free(workers[i].failed);
+		free(workers[i].trace);
+	}
+	free(workers);
+
+	return failed ? 3 : 0;
+}
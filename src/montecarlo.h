@@ -0,0 +1,56 @@
+/** @file montecarlo.h
+ */
+
+#ifndef MONTECARLO_H_
+#define MONTECARLO_H_
+
+#include "simulation.h"
+
+/**
+  A random quantity of a workload: exponential with mean a, or uniform over
+  the whole numbers a to b
+*/
+typedef struct _workload_distribution_t
+{
+	int uniform;
+	double a, b;
+} workload_distribution_t;
+
+/**
+  The model random traces are drawn from
+*/
+typedef struct _workload_t
+{
+	int jobs;
+	workload_distribution_t interarrival;  // time between two arrivals
+	workload_distribution_t run_time;      // rounded up to at least 1
+	int priorities;                        // priorities are drawn uniformly from 0 to priorities - 1
+} workload_t;
+
+/**
+  What every run of a scheme is measured by
+*/
+typedef enum {MONTECARLO_WAITING = 0, MONTECARLO_TURNAROUND, MONTECARLO_RESPONSE,
+              MONTECARLO_UTILIZATION, MONTECARLO_SWITCHES, MONTECARLO_MAKESPAN, MONTECARLO_METRICS} montecarlo_metric_t;
+
+/**
+  The mean of a metric over the runs, and the half width of its 95% confidence interval
+*/
+typedef struct _montecarlo_estimate_t
+{
+	double mean, half_width, deviation;
+} montecarlo_estimate_t;
+
+typedef struct _montecarlo_result_t
+{
+	int scheme, quantum;   // set by the caller
+	int runs, failed;
+	montecarlo_estimate_t metric[MONTECARLO_METRICS];
+	montecarlo_estimate_t difference[MONTECARLO_RESPONSE + 1];  // from the first scheme, run by run on the same traces
+} montecarlo_result_t;
+
+int workload_parse(const char *spec, workload_t *model);
+int montecarlo_run(const simulation_t *sim, const workload_t *model, int runs, montecarlo_result_t *results, int scheme_count,
+                   int threads, unsigned long seed);
+
+#endif /* MONTECARLO_H_ */
@@ -0,0 +1,237 @@
+/** @file queuebench.c
+
+  Measures priority queue throughput as threads are added. Every thread
+  repeatedly offers then polls against a queue prefilled with PREFILL
+  elements, once with a single priqueue_t behind one mutex and once with a
+  cpriqueue_t of twice as many lanes as threads.
+
+  Then, on one thread, compares the SJF and PRI orderings through a comparer
+  against the keyed and heap backends at several queue depths, and the FCFS
+  and RR orderings in a list against the ring backend.
+
+  Usage: queuebench [max threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libpriqueue/libcpriqueue.h"
+
+#define PREFILL 4096
+#define OPS_PER_THREAD 200000
+
+int compare1(const void * a, const void * b)
+{
+	return ( *(int*)a - *(int*)b );
+}
+
+int *values;
+
+priqueue_t locked;
+pthread_mutex_t locked_mutex = PTHREAD_MUTEX_INITIALIZER;
+cpriqueue_t concurrent;
+
+void *run_locked(void *arg)
+{
+	for (int i = 0; i < OPS_PER_THREAD; i++)
+	{
+		pthread_mutex_lock(&locked_mutex);
+		priqueue_offer(&locked, &values[i % PREFILL]);
+		priqueue_poll(&locked);
+		pthread_mutex_unlock(&locked_mutex);
+	}
+
+	return NULL;
+}
+
+void *run_concurrent(void *arg)
+{
+	for (int i = 0; i < OPS_PER_THREAD; i++)
+	{
+		cpriqueue_offer(&concurrent, &values[i % PREFILL]);
+		cpriqueue_poll(&concurrent);
+	}
+
+	return NULL;
+}
+
+/* The fields the scheduler orders its jobs by. */
+typedef struct _bench_job_t
+{
+	int remaining_time, arrival_time, priority;
+} bench_job_t;
+
+int sjf_compare(const void *a, const void *b)
+{
+	const bench_job_t *job1 = a, *job2 = b;
+	if (job1->remaining_time != job2->remaining_time)
+		return job1->remaining_time - job2->remaining_time;
+	return job1->arrival_time - job2->arrival_time;
+}
+
+int pri_compare(const void *a, const void *b)
+{
+	const bench_job_t *job1 = a, *job2 = b;
+	if (job1->priority != job2->priority)
+		return job1->priority - job2->priority;
+	return job1->arrival_time - job2->arrival_time;
+}
+
+int fcfs_compare(const void *a, const void *b)
+{
+	const bench_job_t *job1 = a, *job2 = b;
+	return job1->arrival_time - job2->arrival_time;
+}
+
+int rr_compare(const void *a, const void *b)
+{
+	return 1;
+}
+
+uint64_t sjf_key(const void *a)
+{
+	const bench_job_t *job = a;
+	return (uint64_t)(uint32_t)job->remaining_time << 32 | (uint32_t)job->arrival_time;
+}
+
+uint64_t pri_key(const void *a)
+{
+	const bench_job_t *job = a;
+	return (uint64_t)(uint32_t)job->priority << 32 | (uint32_t)job->arrival_time;
+}
+
+double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Returns millions of offer+poll pairs per second. */
+double measure(void *(*body)(void *), int threads)
+{
+	pthread_t workers[threads];
+	double start = seconds();
+
+	for (int i = 0; i < threads; i++)
+		pthread_create(&workers[i], NULL, body, NULL);
+	for (int i = 0; i < threads; i++)
+		pthread_join(workers[i], NULL);
+
+	return (double)threads * OPS_PER_THREAD / (seconds() - start) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+	int i, threads;
+
+	values = malloc(PREFILL * sizeof(int));
+	for (i = 0; i < PREFILL; i++)
+		values[i] = (i * 7919) % PREFILL;
+
+	printf("Threads   one mutex (Mops/s)   cpriqueue (Mops/s)\n");
+	for (threads = 1; threads <= max_threads; threads *= 2)
+	{
+		priqueue_init(&locked, compare1);
+		cpriqueue_init(&concurrent, 2 * threads, compare1);
+		for (i = 0; i < PREFILL; i++)
+		{
+			priqueue_offer(&locked, &values[i]);
+			cpriqueue_offer(&concurrent, &values[i]);
+		}
+
+		double one_mutex = measure(run_locked, threads);
+		double multi = measure(run_concurrent, threads);
+		printf("%7d   %18.3f   %18.3f\n", threads, one_mutex, multi);
+
+		priqueue_destroy(&locked);
+		cpriqueue_destroy(&concurrent);
+	}
+
+	bench_job_t *jobs = malloc(PREFILL * sizeof(bench_job_t));
+	for (i = 0; i < PREFILL; i++)
+	{
+		jobs[i].remaining_time = (i * 7919) % 997;
+		jobs[i].arrival_time = i;
+		jobs[i].priority = (i * 104729) % 7;
+	}
+
+	printf("\n");
+	printf("Depth   SJF comparer   SJF keyed   SJF heap   PRI comparer   PRI keyed   PRI heap   (Mops/s)\n");
+	for (int depth = 16; depth <= PREFILL; depth *= 4)
+	{
+		printf("%5d", depth);
+		for (int ordering = 0; ordering < 2; ordering++)
+		{
+			for (int keyed = 0; keyed < 3; keyed++)
+			{
+				priqueue_t q;
+				if (keyed == 2)
+					priqueue_init_heap(&q, ordering ? pri_key : sjf_key);
+				else if (keyed)
+					priqueue_init_keyed(&q, ordering ? pri_key : sjf_key);
+				else
+					priqueue_init(&q, ordering ? pri_compare : sjf_compare);
+				for (i = 0; i < depth; i++)
+					priqueue_offer(&q, &jobs[i]);
+
+				// Every dispatch makes room for the next arrival
+				double start = seconds();
+				for (i = 0; i < OPS_PER_THREAD; i++)
+				{
+					priqueue_poll(&q);
+					priqueue_offer(&q, &jobs[(depth + i) % PREFILL]);
+				}
+				printf("   %*.3f", keyed == 0 ? 12 : keyed == 1 ? 9 : 8, OPS_PER_THREAD / (seconds() - start) / 1e6);
+
+				priqueue_destroy(&q);
+			}
+		}
+		printf("\n");
+	}
+
+	printf("\n");
+	printf("Depth   FCFS list   FCFS ring   RR list   RR ring   (Mops/s)\n");
+	for (int depth = 16; depth <= PREFILL; depth *= 4)
+	{
+		printf("%5d", depth);
+		for (int ordering = 0; ordering < 2; ordering++)
+		{
+			for (int ring = 0; ring < 2; ring++)
+			{
+				priqueue_t q;
+				if (ring)
+					priqueue_init_ring(&q, ordering ? rr_compare : fcfs_compare);
+				else
+					priqueue_init(&q, ordering ? rr_compare : fcfs_compare);
+				for (i = 0; i < depth; i++)
+				{
+					jobs[i].arrival_time = i;
+					priqueue_offer(&q, &jobs[i]);
+				}
+
+				// Jobs arrive in order, as they do in the simulator
+				double start = seconds();
+				for (i = 0; i < OPS_PER_THREAD; i++)
+				{
+					priqueue_poll(&q);
+					bench_job_t *job = &jobs[(depth + i) % PREFILL];
+					job->arrival_time = depth + i;
+					priqueue_offer(&q, job);
+				}
+				printf("   %*.3f", ordering ? 7 : 9, OPS_PER_THREAD / (seconds() - start) / 1e6);
+
+				priqueue_destroy(&q);
+			}
+		}
+		printf("\n");
+	}
+
+	free(jobs);
+	free(values);
+
+	return 0;
+}
@@ -16,6 +16,11 @@ int compare2(const void * a, const void * b)
 	return ( *(int*)b - *(int*)a );
 }
 
+uint64_t key1(const void * a)
+{
+	return *(int*)a / 10;
+}
+
 int main()
 {
 	priqueue_t q, q2;
@@ -65,6 +70,91 @@ int main()
 		printf("%d ", *((int *)priqueue_at(&q2, i)) );
 	printf("\n");
 
+	void *batch[] = { &values[25], &values[5], &values[40], &values[20] };
+	priqueue_offer_all(&q2, batch, 4);
+
+	printf("Elements after merging 25 5 40 20 (expected 40 30 25 20 20 10 5): ");
+	for (i = 0; i < priqueue_size(&q2); i++)
+		printf("%d ", *((int *)priqueue_at(&q2, i)) );
+	printf("\n");
+
+	/* Keyed backend, by tens: equal keys stay in the order offered */
+	priqueue_t q3;
+	priqueue_init_keyed(&q3, key1);
+
+	priqueue_offer(&q3, &values[12]);
+	priqueue_offer(&q3, &values[5]);
+	priqueue_offer(&q3, &values[17]);
+	priqueue_offer(&q3, &values[3]);
+	priqueue_offer(&q3, &values[14]);
+	priqueue_remove_at(&q3, 1);
+
+	printf("Keyed elements (expected 5 12 17 14): ");
+	while (priqueue_size(&q3) > 0)
+		printf("%d ", *((int *)priqueue_poll(&q3)) );
+	printf("\n");
+
+	/* Ring backend: in-order offers append, out-of-order ones land where the list puts them */
+	priqueue_t q4;
+	priqueue_init_ring(&q4, compare1);
+
+	for (i = 0; i < 12; i++)
+		priqueue_offer(&q4, &values[i]);
+	for (i = 0; i < 10; i++)
+		priqueue_poll(&q4);
+	for (i = 12; i < 40; i++)
+		priqueue_offer(&q4, &values[i]);
+	for (i = 10; i < 36; i++)
+		priqueue_poll(&q4);
+	priqueue_offer(&q4, &values[37]);
+	priqueue_offer(&q4, &values[2]);
+	priqueue_remove_at(&q4, 3);
+
+	printf("Ring elements (expected 2 36 37 38 39): ");
+	for (i = 0; i < priqueue_size(&q4); i++)
+		printf("%d ", *((int *)priqueue_at(&q4, i)) );
+	printf("\n");
+
+	/* Heap backend, by tens: polls in key order, equal keys in the order offered */
+	priqueue_t q5;
+	priqueue_init_heap(&q5, key1);
+
+	for (i = 0; i < 40; i++)
+		priqueue_offer(&q5, &values[(i * 17) % 40]);
+	for (i = 0; i < 20; i++)
+		priqueue_poll(&q5);
+	priqueue_remove_at(&q5, 2);
+	priqueue_offer(&q5, &values[25]);
+	priqueue_offer(&q5, &values[3]);
+
+	printf("Heap elements (expected 3 28 22 21 26 20 25 24 29 23 25 34): ");
+	for (i = 0; i < 12; i++)
+		printf("%d ", *((int *)priqueue_poll(&q5)) );
+	printf("\n");
+
+	/* Iterating and copying out visit the same order as priqueue_at, on every backend */
+	priqueue_offer(&q3, &values[31]);
+	priqueue_offer(&q3, &values[7]);
+
+	priqueue_t *queues[] = { &q, &q2, &q3, &q4, &q5 };
+	void *snapshot[20];
+	int matches = 0;
+	for (i = 0; i < 5; i++)
+	{
+		priqueue_iterator_t it;
+		void *element;
+		int n = priqueue_to_array(queues[i], snapshot), j = 0;
+
+		priqueue_iterator(queues[i], &it);
+		while ((element = priqueue_next(&it)) != NULL && element == snapshot[j] && element == priqueue_at(queues[i], j))
+			j++;
+		matches += (element == NULL && j == n && n == priqueue_size(queues[i]));
+	}
+	printf("Queues iterated in order (expected 5): %d\n", matches);
+
+	priqueue_destroy(&q5);
+	priqueue_destroy(&q4);
+	priqueue_destroy(&q3);
 	priqueue_destroy(&q2);
 	priqueue_destroy(&q);
 
@@ -0,0 +1,351 @@
+/** @file runtime.c
+
+  Runs the jobs of a trace on real threads, one worker per core, using
+  libscheduler for every dispatch decision. Each job is a CPU-bound stand-in
+  that spins until its worker thread has consumed run_time time units of CPU
+  time, so a machine with fewer CPUs than workers stretches the jobs out the
+  way it would stretch real work. Arrivals are
+  released by the calling thread at their arrival time, and a timer thread
+  expires RR quanta.
+
+  libscheduler is not thread safe, so every scheduler call and every change
+  to the shared runtime state happens under runtime_lock.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "runtime.h"
+
+
+typedef struct _runtime_core_t
+{
+	pthread_t thread;
+	pthread_cond_t wakeup;
+	clockid_t cpu_clock;
+	int core_id;
+	int job;          // index of the job the scheduler placed on this core, -1 when idle
+	int expired;      // set by the timer once the running job used up its quantum
+	long slice_start; // when the running job was put on the core, in usec
+	long slice_cpu;   // CPU time of the worker when the slice began, in usec
+} runtime_core_t;
+
+typedef struct _runtime_state_t
+{
+	long remaining;   // usec of work left
+	long released;    // usec at which the job arrived
+	long started;     // usec at which the job first ran, -1 before
+} runtime_state_t;
+
+
+static pthread_mutex_t runtime_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t runtime_all_finished = PTHREAD_COND_INITIALIZER;
+static runtime_core_t *runtime_cores;
+static runtime_state_t *runtime_states;
+static runtime_job_t *runtime_jobs;
+static int *runtime_index;  // job_id -> index into runtime_jobs
+static int runtime_core_count, runtime_quantum, runtime_unit;
+static int runtime_finished, runtime_job_count, runtime_done;
+static long runtime_epoch;
+static scheduler_t *runtime_scheduler;
+
+
+static long now_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000L + ts.tv_nsec / 1000 - runtime_epoch;
+}
+
+static long cpu_usec(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static int now_units(void)
+{
+	return (int)(now_usec() / runtime_unit);
+}
+
+static void sleep_until(long usec)
+{
+	long delta = usec - now_usec();
+	if (delta > 0)
+	{
+		struct timespec ts = { delta / 1000000L, (delta % 1000000L) * 1000 };
+		nanosleep(&ts, NULL);
+	}
+}
+
+
+/**
+  Puts the job the scheduler chose (job_id, or -1 for none) on core, waking
+  its worker. Must be called with runtime_lock held.
+*/
+static void assign_core(runtime_core_t *core, int job_id)
+{
+	__atomic_store_n(&core->job, (job_id == -1) ? -1 : runtime_index[job_id], __ATOMIC_RELAXED);
+	__atomic_store_n(&core->expired, 0, __ATOMIC_RELAXED);
+	core->slice_start = now_usec();
+	core->slice_cpu = cpu_usec(core->cpu_clock);
+
+	if (core->job != -1 && runtime_states[core->job].started == -1)
+		runtime_states[core->job].started = core->slice_start;
+
+	pthread_cond_signal(&core->wakeup);
+}
+
+
+/**
+  Charges the running job for the CPU time its worker has used since the
+  slice began. Must be called with runtime_lock held.
+*/
+static void charge_core(runtime_core_t *core)
+{
+	long cpu = cpu_usec(core->cpu_clock);
+
+	runtime_states[core->job].remaining -= cpu - core->slice_cpu;
+	core->slice_cpu = cpu;
+}
+
+
+static void *worker_main(void *arg)
+{
+	runtime_core_t *core = arg;
+
+	scheduler_attach(runtime_scheduler);
+
+	pthread_mutex_lock(&runtime_lock);
+	while (!runtime_done)
+	{
+		if (core->job == -1)
+		{
+			pthread_cond_wait(&core->wakeup, &runtime_lock);
+			continue;
+		}
+
+		int job = core->job;
+		long deadline = core->slice_cpu + runtime_states[job].remaining;
+		pthread_mutex_unlock(&runtime_lock);
+
+		// The stand-in task: spin until the work is done or the scheduler takes the core away
+		while (__atomic_load_n(&core->job, __ATOMIC_RELAXED) == job &&
+				!__atomic_load_n(&core->expired, __ATOMIC_RELAXED) && cpu_usec(CLOCK_THREAD_CPUTIME_ID) < deadline)
+		{
+			volatile unsigned spin = 0;
+			for (int i = 0; i < 1000; i++)
+				spin += i;
+		}
+
+		pthread_mutex_lock(&runtime_lock);
+		if (core->job != job)
+			continue;  // preempted, the job was already charged when it lost the core
+
+		long now = now_usec();
+		charge_core(core);
+
+		if (runtime_states[job].remaining <= 0)
+		{
+			runtime_job_t *finished = &runtime_jobs[job];
+			float turnaround = (float)(now - runtime_states[job].released) / runtime_unit;
+
+			finished->turnaround_time = turnaround;
+			finished->waiting_time = turnaround - finished->run_time;
+			finished->response_time = (float)(runtime_states[job].started - runtime_states[job].released) / runtime_unit;
+
+			assign_core(core, scheduler_job_finished(core->core_id, finished->job_id, now_units()));
+
+			if (++runtime_finished == runtime_job_count)
+			{
+				runtime_done = 1;
+				for (int i = 0; i < runtime_core_count; i++)
+					pthread_cond_signal(&runtime_cores[i].wakeup);
+				pthread_cond_signal(&runtime_all_finished);
+			}
+		}
+		else if (core->expired)
+			assign_core(core, scheduler_quantum_expired(core->core_id, now_units()));
+	}
+	pthread_mutex_unlock(&runtime_lock);
+
+	return NULL;
+}
+
+
+static void *timer_main(void *arg)
+{
+	long tick = runtime_unit;
+
+	while (1)
+	{
+		sleep_until(tick);
+		tick += runtime_unit;
+
+		pthread_mutex_lock(&runtime_lock);
+		if (runtime_done)
+			break;
+
+		long now = now_usec();
+		for (int i = 0; i < runtime_core_count; i++)
+		{
+			runtime_core_t *core = &runtime_cores[i];
+			if (core->job != -1 && !core->expired && now - core->slice_start >= (long)runtime_quantum * runtime_unit)
+				__atomic_store_n(&core->expired, 1, __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&runtime_lock);
+	}
+	pthread_mutex_unlock(&runtime_lock);
+
+	return NULL;
+}
+
+
+/**
+  Stops the first started workers, waits for them to exit and frees the
+  state of the run.
+*/
+static void stop_workers(int started, runtime_job_t **arrivals)
+{
+	int i;
+
+	pthread_mutex_lock(&runtime_lock);
+	runtime_done = 1;
+	for (i = 0; i < started; i++)
+		pthread_cond_signal(&runtime_cores[i].wakeup);
+	pthread_mutex_unlock(&runtime_lock);
+
+	for (i = 0; i < started; i++)
+		pthread_join(runtime_cores[i].thread, NULL);
+	for (i = 0; i < runtime_core_count; i++)
+		pthread_cond_destroy(&runtime_cores[i].wakeup);
+
+	free(arrivals);
+	free(runtime_cores);
+	free(runtime_states);
+	free(runtime_index);
+}
+
+
+static int compare_arrival(const void *a, const void *b)
+{
+	const runtime_job_t *job1 = *(const runtime_job_t **)a;
+	const runtime_job_t *job2 = *(const runtime_job_t **)b;
+
+	return job1->arrival_time - job2->arrival_time;
+}
+
+
+/**
+  Runs every job on a pool of worker threads driven by the scheduler.
+
+  The scheduler must already have been started on the calling thread with the
+  same number of cores and the scheme to evaluate; the workers share it. On return, the waiting, turnaround and response
+  times of every job hold the values measured with the wall clock.
+
+  @param jobs the jobs to run, with unique job_ids in [0, job_count).
+  @param job_count the number of jobs.
+  @param cores the number of worker threads to start.
+  @param quantum the RR quantum in time units, or 0 if quanta never expire.
+  @param unit_usec the length of one time unit, in microseconds.
+  @return 0 on success
+  @return -1 if the threads could not be started, in which case none is left running
+ */
+int runtime_run(runtime_job_t *jobs, int job_count, int cores, int quantum, int unit_usec)
+{
+	pthread_t timer;
+	int i;
+
+	runtime_epoch = 0;
+	runtime_epoch = now_usec();
+
+	runtime_scheduler = scheduler_current();
+
+	runtime_jobs = jobs;
+	runtime_job_count = job_count;
+	runtime_core_count = cores;
+	runtime_quantum = quantum;
+	runtime_unit = unit_usec;
+	runtime_finished = 0;
+	runtime_done = (job_count == 0);
+
+	runtime_index = malloc(job_count * sizeof(int));
+	runtime_states = malloc(job_count * sizeof(runtime_state_t));
+	runtime_cores = malloc(cores * sizeof(runtime_core_t));
+
+	runtime_job_t **arrivals = malloc(job_count * sizeof(runtime_job_t *));
+	for (i = 0; i < job_count; i++)
+	{
+		runtime_index[jobs[i].job_id] = i;
+		runtime_states[i].remaining = (long)jobs[i].run_time * unit_usec;
+		runtime_states[i].started = -1;
+		arrivals[i] = &jobs[i];
+	}
+	qsort(arrivals, job_count, sizeof(runtime_job_t *), compare_arrival);
+
+	for (i = 0; i < cores; i++)
+	{
+		runtime_cores[i].core_id = i;
+		runtime_cores[i].job = -1;
+		runtime_cores[i].expired = 0;
+		pthread_cond_init(&runtime_cores[i].wakeup, NULL);
+	}
+
+	for (i = 0; i < cores; i++)
+	{
+		if (pthread_create(&runtime_cores[i].thread, NULL, worker_main, &runtime_cores[i]) != 0)
+		{
+			stop_workers(i, arrivals);
+			return -1;
+		}
+		if (pthread_getcpuclockid(runtime_cores[i].thread, &runtime_cores[i].cpu_clock) != 0)
+		{
+			stop_workers(i + 1, arrivals);
+			return -1;
+		}
+	}
+
+	if (quantum > 0 && pthread_create(&timer, NULL, timer_main, NULL) != 0)
+	{
+		stop_workers(cores, arrivals);
+		return -1;
+	}
+
+	/*
+	 * Release each job at its arrival time.
+	 */
+	for (i = 0; i < job_count; i++)
+	{
+		runtime_job_t *job = arrivals[i];
+		sleep_until((long)job->arrival_time * unit_usec);
+
+		pthread_mutex_lock(&runtime_lock);
+		runtime_states[runtime_index[job->job_id]].released = now_usec();
+
+		int core_id = scheduler_new_job(job->job_id, now_units(), job->run_time, job->priority);
+		if (core_id >= 0)
+		{
+			runtime_core_t *core = &runtime_cores[core_id];
+			if (core->job != -1)
+				charge_core(core);
+			assign_core(core, job->job_id);
+		}
+		pthread_mutex_unlock(&runtime_lock);
+	}
+
+	/*
+	 * Every job has arrived, but some may still be queued or running.  Wait until the last one finishes.
+	 */
+	pthread_mutex_lock(&runtime_lock);
+	while (runtime_finished < runtime_job_count)
+		pthread_cond_wait(&runtime_all_finished, &runtime_lock);
+	pthread_mutex_unlock(&runtime_lock);
+
+	if (quantum > 0)
+		pthread_join(timer, NULL);
+	stop_workers(cores, arrivals);
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+/** @file runtime.h
+ */
+
+#ifndef RUNTIME_H_
+#define RUNTIME_H_
+
+#include "libscheduler/libscheduler.h"
+
+/**
+  A job dispatched by the runtime, along with what was measured while running it.
+  All measurements are expressed in time units.
+*/
+typedef struct _runtime_job_t
+{
+	int job_id, arrival_time, run_time, priority;
+	float waiting_time, turnaround_time, response_time;
+} runtime_job_t;
+
+int runtime_run(runtime_job_t *jobs, int job_count, int cores, int quantum, int unit_usec);
+
+#endif /* RUNTIME_H_ */
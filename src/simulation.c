@@ -0,0 +1,1265 @@
+/** @file simulation.c
+
+  The tick-by-tick simulation the simulator drives, kept in a simulation_t
+  so a run can be snapshotted between time units and resumed later.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+
+#include "simulation.h"
+#include "libcheckpoint/libcheckpoint.h"
+
+#define SNAPSHOT_MAGIC "SCHEDCKP"
+#define SNAPSHOT_VERSION 3
+
+// A quiet simulation, such as one branch of a fork, keeps its events to itself
+#define narrate(sim, ...) do { if (!(sim)->quiet) printf(__VA_ARGS__); } while (0)
+
+
+int fixed_switch_cost(const simulation_t *sim, int core_id, int prev_job_id, int next_job_id, int last_core)
+{
+	int cost = 0;
+
+	if (prev_job_id != -1 && prev_job_id != next_job_id)
+		cost += sim->switch_cost_fixed;
+	if (last_core != -1 && last_core != core_id)
+		cost += sim->switch_cost_migration;
+
+	return cost;
+}
+
+static void log_event(simulation_t *sim, event_type_t type, int core_id, int job_id)
+{
+	if (sim->events != NULL)
+		eventlog_write(sim->events, type, sim->time, core_id, job_id, scheduler_queue_depth());
+}
+
+static void start_job_on_core(simulation_t *sim, simulator_job_list_t *job, int core_id)
+{
+	int prev_job_id = sim->core_last_job[core_id];
+
+	job->switch_time = sim->switch_cost(sim, core_id, prev_job_id, job->job_id, job->last_core);
+	if (job->switch_time > 0)
+		scheduler_switch_stall(core_id, job->switch_time);
+	if (prev_job_id != -1 && prev_job_id != job->job_id && job->switch_time > 0)
+		sim->switches_charged++;
+	if (job->last_core != -1 && job->last_core != core_id && job->switch_time > 0)
+		sim->migrations_charged++;
+
+	job->core_id = core_id;
+	job->last_core = core_id;
+	sim->core_last_job[core_id] = job->job_id;
+
+	log_event(sim, EVENT_DISPATCH, core_id, job->job_id);
+}
+
+/**
+  Gives core_id to job, preempting whatever job runs there now.
+ */
+static void run_on_core(simulation_t *sim, simulator_job_list_t *job, int core_id)
+{
+	int i;
+
+	for (i = 0; i < sim->active_jobs; i++)
+		if (sim->jobs[i].core_id == core_id)
+		{
+			sim->jobs[i].core_id = -1;
+			log_event(sim, EVENT_PREEMPT, core_id, sim->jobs[i].job_id);
+		}
+
+	start_job_on_core(sim, job, core_id);
+
+	if (SCHEME_TIME_SLICED(sim->scheme))
+		sim->quantum_clock[core_id] = sim->quantum;
+}
+
+static int set_active_job(simulation_t *sim, int job_id, int core_id)
+{
+	int i;
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		if (sim->jobs[i].job_id == job_id && sim->jobs[i].arrived && !sim->jobs[i].blocked)
+		{
+			start_job_on_core(sim, &sim->jobs[i], core_id);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void print_available_jobs(simulator_job_list_t *jobs, int active_jobs)
+{
+	printf("Active jobs are: ");
+
+	int i, first = 1;
+	for (i = 0; i < active_jobs; i++)
+	{
+		if (jobs[i].arrived)
+		{
+			if (first)
+			{
+				printf("%d", jobs[i].job_id);
+				first = 0;
+			}
+			else
+				printf(", %d", jobs[i].job_id);
+		}
+	}
+
+	if (!first)
+		printf("\n");
+}
+
+static void print_available_cores(int cores)
+{
+	printf("Active cores are: ");
+
+	int i;
+	for (i = 0; i < cores; i++)
+	{
+		if (i == cores - 1)
+			printf("%d\n", i);
+		else
+			printf("%d, ", i);
+	}
+}
+
+static void narrate_queue(simulation_t *sim)
+{
+	if (!sim->quiet)
+	{
+		printf("  Queue: ");
+		scheduler_show_queue();
+		printf("\n\n");
+	}
+}
+
+static void narrate_arrival(simulation_t *sim, simulator_job_list_t *job, int core_id)
+{
+	if (core_id >= 0 && core_id < sim->cores)
+	{
+		narrate(sim, "A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
+				job->job_id, job->run_time, job->priority, job->job_id, core_id);
+		narrate_queue(sim);
+	}
+	else if (core_id == -1)
+	{
+		narrate(sim, "A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
+				job->job_id, job->run_time, job->priority, job->job_id);
+		narrate_queue(sim);
+	}
+}
+
+/**
+  Admits simultaneous arrivals one at a time, narrating each decision and the
+  queue it leaves, and fills in arrival_core as scheduler_new_jobs would: a job
+  preempted by a later arrival of the same batch never starts.
+ */
+static void admit_narrated(simulation_t *sim, int arrivals)
+{
+	int batch_slot[sim->cores];
+	int i, k;
+
+	for (i = 0; i < sim->cores; i++)
+		batch_slot[i] = -1;
+
+	for (k = 0; k < arrivals; k++)
+	{
+		simulator_job_list_t *job = &sim->jobs[sim->arrival_index[k]];
+		int core_id = scheduler_new_job_in_group(job->job_id, sim->time, job->run_time, job->priority, job->group);
+
+		sim->arrival_core[k] = core_id;
+		narrate_arrival(sim, job, core_id);
+
+		if (core_id >= 0 && core_id < sim->cores)
+		{
+			if (batch_slot[core_id] != -1)
+				sim->arrival_core[batch_slot[core_id]] = -1;
+			batch_slot[core_id] = k;
+		}
+	}
+}
+
+static void allocate_cores(simulation_t *sim, int job_count)
+{
+	int i;
+
+	sim->quantum_clock = malloc(sim->cores * sizeof(int));
+	sim->core_last_job = malloc(sim->cores * sizeof(int));
+	sim->core_speed = malloc(sim->cores * sizeof(int));
+	sim->core_socket = malloc(sim->cores * sizeof(int));
+	sim->core_timing_diagram = malloc(sim->cores * sizeof(char *));
+	sim->core_timing_diagram_length = calloc(sim->cores, sizeof(int));
+	sim->core_job = malloc(sim->cores * sizeof(int));
+	sim->core_lead = malloc(sim->cores * sizeof(int));
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		sim->core_timing_diagram[i] = malloc(sim->core_timing_diagram_size + 1);
+		sim->core_timing_diagram[i][0] = '\0';
+		sim->core_job[i] = -1;
+		sim->core_lead[i] = -1;
+	}
+
+	sim->io_device_job = malloc(sizeof(int));
+	sim->io_device_job[0] = -1;
+	sim->io_devices = 1;
+
+	sim->jobs_capacity = job_count;
+	sim->batch = malloc((job_count + 1) * sizeof(scheduler_job_batch_t));
+	sim->arrival_index = malloc((job_count + 1) * sizeof(int));
+	sim->arrival_core = malloc((job_count + 1) * sizeof(int));
+}
+
+
+/**
+  Sets up a simulation of jobs starting at time 0. The scheduler must already
+  have been started with the same cores and scheme.
+
+  @param sim the simulation to set up.
+  @param jobs the jobs of the trace. The simulation takes ownership of the array.
+  @param job_count the number of jobs.
+  @param core_speed relative speed of each core in percent, or NULL for 100.
+  @param core_socket socket of each core, or NULL for socket 0.
+ */
+void simulation_init(simulation_t *sim, int cores, int scheme, int quantum, simulator_job_list_t *jobs, int job_count,
+		const int *core_speed, const int *core_socket)
+{
+	int i;
+
+	memset(sim, 0, sizeof(simulation_t));
+	sim->cores = cores;
+	sim->scheme = scheme;
+	sim->quantum = quantum;
+	sim->jobs = jobs;
+	sim->active_jobs = job_count;
+	sim->next_job_id = job_count;
+	sim->record_diagram = 1;
+	sim->horizon = -1;
+	sim->switch_cost = fixed_switch_cost;
+	sim->affinity_window = -1;
+	sim->core_timing_diagram_size = 1024;
+
+	allocate_cores(sim, job_count);
+
+	for (i = 0; i < cores; i++)
+	{
+		sim->quantum_clock[i] = -1;
+		sim->core_last_job[i] = -1;
+		sim->core_speed[i] = core_speed ? core_speed[i] : 100;
+		sim->core_socket[i] = core_socket ? core_socket[i] : 0;
+	}
+
+	for (i = 0; i < job_count; i++)
+		memset(&jobs[i].share, 0, sizeof(simulation_share_t));
+}
+
+
+static void change_scheme(simulation_t *sim, int scheme, int quantum)
+{
+	int i;
+
+	// Continuing under another scheme starts every running job on a fresh quantum
+	if (scheme >= 0 && (scheme != sim->scheme || quantum != sim->quantum))
+	{
+		sim->scheme = scheme;
+		sim->quantum = quantum;
+		for (i = 0; i < sim->cores; i++)
+			sim->quantum_clock[i] = -1;
+		for (i = 0; i < sim->active_jobs; i++)
+			if (sim->jobs[i].core_id != -1)
+				sim->quantum_clock[sim->jobs[i].core_id] = quantum;
+	}
+}
+
+
+/**
+  Forks the simulation: branch becomes an independent copy of sim, at the
+  same time and with its own jobs and timing diagrams, driven by a copy of
+  the current scheduler.
+
+  @param scheme the scheme the branch continues with, or -1 to keep the current one.
+  @param quantum the RR quantum of the branch, used when scheme is RR.
+  @return the scheduler of the branch, to be attached on the thread stepping it
+ */
+scheduler_t *simulation_fork(simulation_t *branch, const simulation_t *sim, int scheme, int quantum)
+{
+	int i;
+
+	memcpy(branch, sim, sizeof(simulation_t));
+
+	branch->jobs = malloc((sim->active_jobs + 1) * sizeof(simulator_job_list_t));
+	memcpy(branch->jobs, sim->jobs, sim->active_jobs * sizeof(simulator_job_list_t));
+	allocate_cores(branch, sim->active_jobs);
+
+	simulation_set_io_devices(branch, sim->io_devices);
+	memcpy(branch->io_device_job, sim->io_device_job, sim->io_devices * sizeof(int));
+	for (i = 0; i < sim->active_jobs; i++)
+		if (sim->jobs[i].bursts != NULL)
+		{
+			branch->jobs[i].bursts = malloc(sim->jobs[i].burst_count * sizeof(int));
+			memcpy(branch->jobs[i].bursts, sim->jobs[i].bursts, sim->jobs[i].burst_count * sizeof(int));
+		}
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		branch->quantum_clock[i] = sim->quantum_clock[i];
+		branch->core_last_job[i] = sim->core_last_job[i];
+		branch->core_speed[i] = sim->core_speed[i];
+		branch->core_socket[i] = sim->core_socket[i];
+		branch->core_job[i] = sim->core_job[i];
+		branch->core_lead[i] = sim->core_lead[i];
+		branch->core_timing_diagram_length[i] = sim->core_timing_diagram_length[i];
+		memcpy(branch->core_timing_diagram[i], sim->core_timing_diagram[i], sim->core_timing_diagram_length[i] + 1);
+	}
+
+	if (sim->shares != NULL)
+	{
+		branch->shares = malloc(sim->shares_capacity * sizeof(simulation_share_t));
+		memcpy(branch->shares, sim->shares, sim->shares_capacity * sizeof(simulation_share_t));
+	}
+
+	branch->events = NULL;
+	change_scheme(branch, scheme, quantum);
+
+	return scheduler_clone(scheme);
+}
+
+
+static void narrate_gang_cores(simulation_t *sim, int lead)
+{
+	int i, first = 1;
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		if (sim->core_lead[i] == lead)
+		{
+			narrate(sim, first ? "%d" : ", %d", i);
+			first = 0;
+		}
+	}
+}
+
+
+/**
+  Asks the scheduler to start every gang job that can start now, and puts
+  each one it started on all of the cores it was given. A job runs at the
+  speed of its slowest core, the lowest-numbered of them leading as in the
+  scheduler: the job's core_id is its lead core.
+
+  @return 0 on success
+  @return -1 if the scheduler started a job that is not waiting
+ */
+static int start_gang_jobs(simulation_t *sim)
+{
+	int i, j, started = 0;
+
+	scheduler_gang_dispatch(sim->time, sim->core_job);
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		if (sim->core_job[i] == -1 || sim->core_lead[i] != -1)
+			continue;
+
+		int job_id = sim->core_job[i], lead = i;
+		for (j = i + 1; j < sim->cores; j++)
+			if (sim->core_job[j] == job_id && sim->core_speed[j] < sim->core_speed[lead])
+				lead = j;
+
+		for (j = i; j < sim->cores; j++)
+		{
+			if (sim->core_job[j] == job_id)
+			{
+				sim->core_lead[j] = lead;
+				sim->core_last_job[j] = job_id;
+			}
+		}
+
+		if (!set_active_job(sim, job_id, lead))
+		{
+			printf("The scheduler_gang_dispatch() selected an invalid job (job_id == %d).\n", job_id);
+			print_available_jobs(sim->jobs, sim->active_jobs);
+			return -1;
+		}
+
+		narrate(sim, "Job %d is now running on core(s) ", job_id);
+		narrate_gang_cores(sim, lead);
+		narrate(sim, ".\n");
+		started++;
+	}
+
+	if (started > 0)
+		narrate_queue(sim);
+
+	return 0;
+}
+
+
+/**
+  Returns how many time units can run before the next event: an arrival, a
+  job finishing a burst, a quantum expiring, an I/O burst completing or a
+  context switch completing. Nothing the scheduler sees changes in between,
+  so they can all run at once.
+ */
+static int time_to_next_event(simulation_t *sim)
+{
+	int i, span = INT_MAX;
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		simulator_job_list_t *job = &sim->jobs[i];
+		int until;
+
+		if (!job->arrived)
+			until = job->arrival_time - sim->time;
+		else if (job->blocked && job->io_device != -1)
+			until = job->io_left;
+		else if (job->core_id == -1)
+			continue;
+		else if (job->switch_time > 0)
+			until = job->switch_time;
+		else
+		{
+			int speed = sim->core_speed[job->core_id];
+			until = (job->work + speed - 1) / speed;
+
+			if (SCHEME_TIME_SLICED(sim->scheme) && sim->quantum_clock[job->core_id] > 0 && sim->quantum_clock[job->core_id] < until)
+				until = sim->quantum_clock[job->core_id];
+		}
+
+		if (until < span)
+			span = until;
+	}
+
+	if (sim->horizon >= 0 && sim->horizon - sim->time < span)
+		span = sim->horizon - sim->time;
+
+	return (span < 1 || span == INT_MAX) ? 1 : span;
+}
+
+
+static void grow_jobs(simulation_t *sim, int needed)
+{
+	if (needed <= sim->jobs_capacity)
+		return;
+
+	while (sim->jobs_capacity < needed)
+		sim->jobs_capacity = sim->jobs_capacity * 2 + 8;
+	sim->jobs = realloc(sim->jobs, (sim->jobs_capacity + 1) * sizeof(simulator_job_list_t));
+	sim->batch = realloc(sim->batch, (sim->jobs_capacity + 1) * sizeof(scheduler_job_batch_t));
+	sim->arrival_index = realloc(sim->arrival_index, (sim->jobs_capacity + 1) * sizeof(int));
+	sim->arrival_core = realloc(sim->arrival_core, (sim->jobs_capacity + 1) * sizeof(int));
+}
+
+static void init_job(simulator_job_list_t *job, int job_id, int arrival_time, int run_time, int priority)
+{
+	job->job_id = job_id;
+	job->arrival_time = arrival_time;
+	job->run_time = run_time;
+	job->priority = priority;
+	job->core_id = -1;
+	job->arrived = 0;
+	job->last_core = -1;
+	job->switch_time = 0;
+	job->work = run_time * 100;
+	job->cores_needed = 1;
+	job->group = 0;
+	job->bursts = NULL;
+	job->burst_count = 1;
+	job->burst = 0;
+	job->blocked = 0;
+	job->io_device = -1;
+	memset(&job->share, 0, sizeof(simulation_share_t));
+}
+
+
+/**
+  Adds a job to a running simulation, numbered after every job it already
+  has. The job arrives when the simulation reaches arrival_time, which must
+  not be in the past. A job that was reserved a slot takes it.
+ */
+void simulation_add_job(simulation_t *sim, int arrival_time, int run_time, int priority)
+{
+	simulator_job_list_t *job;
+	int i = sim->next_job_id;
+
+	if (sim->jobs_reserved > 0)
+	{
+		// Slots only move to replace a finished job, so most are still at the number of their job
+		if (i >= sim->active_jobs || sim->jobs[i].job_id != sim->next_job_id)
+			for (i = 0; sim->jobs[i].job_id != sim->next_job_id; i++)
+				;
+		job = &sim->jobs[i];
+		sim->jobs_reserved--;
+	}
+	else
+	{
+		grow_jobs(sim, sim->active_jobs + 1);
+		job = &sim->jobs[sim->active_jobs++];
+	}
+
+	init_job(job, sim->next_job_id++, arrival_time, run_time, priority);
+}
+
+
+/**
+  Lays out a slot for each of the next count jobs added to a running
+  simulation, where a simulation given all of them up front would hold them.
+  Finished jobs are replaced by the one at the end of the jobs, so with the
+  slots in place, jobs that finish or arrive together reach the scheduler in
+  the order they would in a run of the whole trace. A slot never arrives
+  before its job is added. Reserving 0 jobs drops the slots never filled.
+ */
+void simulation_reserve_jobs(simulation_t *sim, int count)
+{
+	int i, k;
+
+	if (count == 0)
+	{
+		for (i = k = 0; i < sim->active_jobs; i++)
+			if (sim->jobs[i].job_id < sim->next_job_id)
+				sim->jobs[k++] = sim->jobs[i];
+		sim->active_jobs = k;
+		sim->jobs_reserved = 0;
+		return;
+	}
+
+	// A slot has a run time of its own only so that it is not taken for a finished job
+	grow_jobs(sim, sim->active_jobs + count);
+	for (k = 0; k < count; k++)
+		init_job(&sim->jobs[sim->active_jobs++], sim->next_job_id + sim->jobs_reserved + k, INT_MAX, 1, 0);
+	sim->jobs_reserved += count;
+}
+
+
+/**
+  Sets the number of I/O devices jobs blocked on I/O are served by, one job
+  at a time each, in the order they blocked. A simulation starts with one.
+ */
+void simulation_set_io_devices(simulation_t *sim, int devices)
+{
+	int i;
+
+	sim->io_devices = devices;
+	sim->io_device_job = realloc(sim->io_device_job, devices * sizeof(int));
+	for (i = 0; i < devices; i++)
+		sim->io_device_job[i] = -1;
+}
+
+
+/**
+  Under a proportional share scheme, adds the span time units about to run to
+  what each ready job receives and to what it is entitled to: its tickets'
+  share of the cores, at most one core, split among the jobs that are ready.
+  Only time units in which a ready job waits count, since otherwise every
+  ready job runs whatever its tickets.
+ */
+static void account_shares(simulation_t *sim, int span)
+{
+	simulator_job_list_t *jobs = sim->jobs;
+	int i, total_tickets = 0, waiting = 0;
+
+	if (sim->shares == NULL)
+	{
+		sim->shares_capacity = 8;
+		sim->shares = malloc(sim->shares_capacity * sizeof(simulation_share_t));
+	}
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		if (jobs[i].arrived && !jobs[i].blocked)
+		{
+			total_tickets += jobs[i].priority > 0 ? jobs[i].priority : 1;
+			waiting += (jobs[i].core_id == -1);
+		}
+	}
+
+	if (waiting == 0)
+		return;
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		if (!jobs[i].arrived || jobs[i].blocked)
+			continue;
+
+		simulation_share_t *share = &jobs[i].share;
+		share->tickets = jobs[i].priority > 0 ? jobs[i].priority : 1;
+
+		double entitled = (double)sim->cores * share->tickets / total_tickets;
+		share->fair_time += span * (entitled < 1 ? entitled : 1);
+
+		if (jobs[i].core_id != -1 && jobs[i].switch_time == 0)
+		{
+			int work = sim->core_speed[jobs[i].core_id] * span;
+			share->cpu_time += work < jobs[i].work ? work : jobs[i].work;
+		}
+	}
+}
+
+
+/**
+  Adds the share of a finished job to the jobs that held as many tickets, so
+  that the shares take room for every number of tickets, not for every job.
+ */
+static void record_share(simulation_t *sim, const simulation_share_t *share)
+{
+	int i;
+
+	for (i = 0; i < sim->shares_count && sim->shares[i].tickets != share->tickets; i++)
+		;
+
+	if (i == sim->shares_count)
+	{
+		if (sim->shares_count == sim->shares_capacity)
+		{
+			sim->shares_capacity *= 2;
+			sim->shares = realloc(sim->shares, sim->shares_capacity * sizeof(simulation_share_t));
+		}
+		memset(&sim->shares[i], 0, sizeof(simulation_share_t));
+		sim->shares[i].tickets = share->tickets;
+		sim->shares_count++;
+	}
+
+	sim->shares[i].jobs++;
+	sim->shares[i].cpu_time += share->cpu_time;
+	sim->shares[i].fair_time += share->fair_time;
+}
+
+
+/**
+  Hands every job whose I/O burst is over back to the scheduler with its next
+  CPU burst, then starts waiting jobs on the free I/O devices, first blocked
+  first served.
+
+  @return 0, or -1 if the scheduler chose an invalid core
+ */
+static int complete_io(simulation_t *sim)
+{
+	simulator_job_list_t *jobs = sim->jobs;
+	int i, d;
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		if (!jobs[i].blocked || jobs[i].io_device == -1 || jobs[i].io_left > 0)
+			continue;
+
+		int job_id = jobs[i].job_id;
+		int core_id = scheduler_job_unblocked(job_id, sim->time, jobs[i].run_time);
+
+		sim->io_device_job[jobs[i].io_device] = -1;
+		jobs[i].io_device = -1;
+		jobs[i].blocked = 0;
+		sim->jobs_blocked--;
+
+		log_event(sim, EVENT_UNBLOCK, core_id, job_id);
+
+		if (core_id >= 0 && core_id < sim->cores)
+		{
+			narrate(sim, "Job %d (running time=%d) finished its I/O. Job %d is now running on core %d.\n", job_id, jobs[i].run_time, job_id, core_id);
+			narrate_queue(sim);
+			run_on_core(sim, &jobs[i], core_id);
+		}
+		else if (core_id == -1)
+		{
+			narrate(sim, "Job %d (running time=%d) finished its I/O. Job %d is set to idle (-1).\n", job_id, jobs[i].run_time, job_id);
+			narrate_queue(sim);
+		}
+		else
+		{
+			printf("The scheduler_job_unblocked() selected an invalid core (core_id == %d).\n", core_id);
+			print_available_cores(sim->cores);
+			return -1;
+		}
+	}
+
+	for (d = 0; d < sim->io_devices; d++)
+	{
+		if (sim->io_device_job[d] != -1)
+			continue;
+
+		simulator_job_list_t *next = NULL;
+		for (i = 0; i < sim->active_jobs; i++)
+			if (jobs[i].blocked && jobs[i].io_device == -1 && (next == NULL || jobs[i].io_ticket < next->io_ticket))
+				next = &jobs[i];
+		if (next == NULL)
+			break;
+
+		next->io_device = d;
+		sim->io_device_job[d] = next->job_id;
+	}
+
+	return 0;
+}
+
+
+/**
+  Runs one time unit: finishes, quantum expiries, arrivals, then the work on
+  every core.
+
+  @return SIMULATION_RUNNING if there are jobs left
+  @return SIMULATION_FINISHED once every job has finished
+  @return SIMULATION_FAILED if the scheduler made an invalid decision
+ */
+int simulation_step(simulation_t *sim)
+{
+	simulator_job_list_t *jobs = sim->jobs;
+	int cores = sim->cores, time = sim->time;
+	int i, j, k;
+
+	narrate(sim, "=== [TIME %d] ===\n", time);
+
+	/*
+	 * 1. Check if any jobs finished in the last time unit.
+	 */
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		if (jobs[i].run_time == 0 && jobs[i].burst + 1 < jobs[i].burst_count)
+		{
+			// The CPU burst is over: the job waits for an I/O device, then comes back with its next CPU burst
+			int job_id = jobs[i].job_id;
+			int core_id = jobs[i].core_id;
+			int new_job_id = scheduler_job_blocked(core_id, job_id, time);
+
+			log_event(sim, EVENT_BLOCK, core_id, job_id);
+
+			jobs[i].core_id = -1;
+			jobs[i].blocked = 1;
+			jobs[i].io_device = -1;
+			jobs[i].io_left = jobs[i].bursts[++jobs[i].burst];
+			jobs[i].io_ticket = sim->io_next_ticket++;
+			jobs[i].run_time = jobs[i].bursts[++jobs[i].burst];
+			jobs[i].work = jobs[i].run_time * 100;
+			sim->jobs_blocked++;
+			sim->io_bursts++;
+
+			if (SCHEME_TIME_SLICED(sim->scheme))
+				sim->quantum_clock[core_id] = sim->quantum;
+
+			if ( new_job_id != -1 && !set_active_job(sim, new_job_id, core_id) )
+			{
+				printf("The scheduler_job_blocked() selected an invalid job (job_id == %d).\n", new_job_id);
+				print_available_jobs(jobs, sim->active_jobs);
+				return SIMULATION_FAILED;
+			}
+
+			narrate(sim, "Job %d, running on core %d, blocked on I/O for %d time unit(s). Core %d is now running job %d.\n",
+					job_id, core_id, jobs[i].io_left, core_id, new_job_id);
+			narrate_queue(sim);
+		}
+		else if (jobs[i].run_time == 0)
+		{
+			// Notify the scheduler has finished
+			int job_id = jobs[i].job_id;
+			int core_id = jobs[i].core_id;
+			int new_job_id = -1;
+
+			if (sim->gang)
+			{
+				scheduler_gang_job_finished(job_id, time);
+				narrate(sim, "Job %d, running on core(s) ", job_id);
+				narrate_gang_cores(sim, core_id);
+				narrate(sim, ", finished.\n");
+				for (j = 0; j < cores; j++)
+				{
+					if (sim->core_lead[j] == core_id)
+					{
+						sim->core_job[j] = -1;
+						sim->core_lead[j] = -1;
+					}
+				}
+			}
+			else
+				new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
+
+			log_event(sim, EVENT_FINISH, core_id, job_id);
+
+			if (sim->finished != NULL)
+				sim->finished(sim, job_id, time);
+
+			if (SCHEME_TIME_SLICED(sim->scheme))
+				sim->quantum_clock[jobs[i].core_id] = sim->quantum;
+
+			// A job that never competed for a core while others waited holds no share
+			if (sim->shares != NULL && jobs[i].share.tickets > 0)
+				record_share(sim, &jobs[i].share);
+
+			// Delete the finished jobs, decrease the number of active jobs
+			free(jobs[i].bursts);
+			if (i != sim->active_jobs - 1)
+				memcpy(&jobs[i], &jobs[sim->active_jobs - 1], sizeof(simulator_job_list_t));
+			sim->active_jobs--;
+			sim->jobs_alive--;
+			i--;
+
+			// Set the new job
+			if ( new_job_id != -1 && !set_active_job(sim, new_job_id, core_id) )
+			{
+				printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
+				print_available_jobs(jobs, sim->active_jobs);
+				return SIMULATION_FAILED;
+			}
+			else if (!sim->gang)
+			{
+				narrate(sim, "Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
+				narrate_queue(sim);
+			}
+		}
+	}
+
+	/*
+	 * Check to see if we finished our last job.  (If we don't check here, we would run an extra time unit that will be totally idle.)
+	 */
+	if (sim->active_jobs == 0)
+		return SIMULATION_FINISHED;
+
+	// Cores freed by gang jobs go to the jobs already waiting before any new arrival, as a freed core does otherwise
+	if (sim->gang && start_gang_jobs(sim) != 0)
+		return SIMULATION_FAILED;
+
+	/*
+	 * 2. Check of any quantums expired in the last time unit.
+	 */
+	if (SCHEME_TIME_SLICED(sim->scheme))
+	{
+		for (i = 0; i < cores; i++)
+		{
+			if (sim->quantum_clock[i] == 0)
+			{
+				for (j = 0; j < sim->active_jobs; j++)
+				{
+					if (jobs[j].core_id == i)
+					{
+						// Notify the scheduler the quantum has expired
+						int core_id = jobs[j].core_id;
+						int old_job_id = jobs[j].job_id;
+						int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
+
+						log_event(sim, EVENT_QUANTUM_EXPIRED, core_id, old_job_id);
+
+						jobs[j].core_id = -1;
+
+						sim->quantum_clock[core_id] = sim->quantum;
+
+						// Set the new job
+						if ( new_job_id != -1 && !set_active_job(sim, new_job_id, core_id) )
+						{
+							printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
+							print_available_jobs(jobs, sim->active_jobs);
+							return SIMULATION_FAILED;
+						}
+						else
+						{
+							narrate(sim, "Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
+							narrate_queue(sim);
+						}
+
+						break;
+					}
+				}
+			}
+		}
+	}
+
+
+	/*
+	 * Jobs whose I/O burst is over come back to the scheduler, and the devices they free go to the jobs waiting longest.
+	 */
+	if (sim->jobs_blocked > 0 && complete_io(sim) != 0)
+		return SIMULATION_FAILED;
+
+
+	/*
+	 * 3. Check for any new jobs that arrive in this time unit.  Simultaneous arrivals are admitted as one batch.  Gang
+	 *    jobs are admitted one at a time, each starting whatever it lets start.
+	 */
+	int arrivals = 0;
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		if (jobs[i].arrival_time == time)
+		{
+			sim->batch[arrivals].job_number = jobs[i].job_id;
+			sim->batch[arrivals].running_time = jobs[i].run_time;
+			sim->batch[arrivals].priority = jobs[i].priority;
+			sim->batch[arrivals].group = jobs[i].group;
+			sim->arrival_index[arrivals++] = i;
+		}
+	}
+
+	if (arrivals > 1 && !sim->gang && sim->quiet)
+		scheduler_new_jobs(sim->batch, arrivals, time, sim->arrival_core);
+	else if (arrivals > 1 && !sim->gang)
+		admit_narrated(sim, arrivals);
+
+	for (k = 0; k < arrivals && sim->gang; k++)
+	{
+		i = sim->arrival_index[k];
+		scheduler_new_gang_job(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority, jobs[i].cores_needed);
+		jobs[i].arrived = 1;
+		sim->jobs_alive++;
+
+		log_event(sim, EVENT_ARRIVAL, -1, jobs[i].job_id);
+		narrate(sim, "A new job, job %d (running time=%d, priority=%d, cores=%d), arrived.\n",
+				jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].cores_needed);
+		narrate_queue(sim);
+
+		if (start_gang_jobs(sim) != 0)
+			return SIMULATION_FAILED;
+	}
+
+	for (k = 0; k < arrivals && !sim->gang; k++)
+	{
+		i = sim->arrival_index[k];
+		int new_job_core_id = arrivals > 1 ? sim->arrival_core[k] : scheduler_new_job_in_group(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority, jobs[i].group);
+		jobs[i].arrived = 1;
+		sim->jobs_alive++;
+
+		log_event(sim, EVENT_ARRIVAL, new_job_core_id, jobs[i].job_id);
+
+		// Simultaneous arrivals were narrated as they were admitted
+		if (arrivals == 1)
+			narrate_arrival(sim, &jobs[i], new_job_core_id);
+
+		if (new_job_core_id >= 0 && new_job_core_id < cores)
+			run_on_core(sim, &jobs[i], new_job_core_id);
+		else if (new_job_core_id != -1)
+		{
+			printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
+			print_available_cores(cores);
+			return SIMULATION_FAILED;
+		}
+	}
+
+
+	/*
+	 * 4. Run the time unit.  An event-driven simulation runs every time unit up to the next event at once.
+	 */
+	int span = sim->event_driven ? time_to_next_event(sim) : 1;
+	char time_string[cores][11];
+	int cores_working = 0;
+
+	for (i = 0; i < cores; i++)
+		time_string[i][0] = '\0';
+
+	if (sim->scheme == STRIDE || sim->scheme == LOTTERY)
+		account_shares(sim, span);
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		if (jobs[i].core_id != -1)
+		{
+			cores_working++;
+
+			assert(time_string[jobs[i].core_id][0] == '\0');
+
+			// A core paying for a context switch makes no progress on the job
+			if (jobs[i].switch_time > 0)
+			{
+				jobs[i].switch_time -= span;
+				sim->switch_overhead += span;
+				strcpy(time_string[jobs[i].core_id], "*");
+				continue;
+			}
+
+			// Progress is tracked in hundredths of a time unit so cores can run at any speed
+			jobs[i].work -= sim->core_speed[jobs[i].core_id] * span;
+			jobs[i].run_time = jobs[i].work > 0 ? (jobs[i].work + 99) / 100 : 0;
+			sim->quantum_clock[jobs[i].core_id] -= span;
+
+			if (jobs[i].job_id < 10)
+				sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
+			else if (jobs[i].job_id < 10 + 26)
+				sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
+			else if (jobs[i].job_id < 10 + 26 + 26)
+				sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
+			else
+				snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
+		}
+	}
+
+	for (i = 0; i < sim->active_jobs && sim->jobs_blocked > 0; i++)
+	{
+		if (!jobs[i].blocked)
+			continue;
+
+		if (jobs[i].io_device == -1)
+			sim->io_wait_time += span;
+		else
+		{
+			jobs[i].io_left -= span;
+			sim->io_busy_time += span;
+		}
+	}
+
+	// Every core of a gang job shows what its lead core shows
+	for (i = 0; i < cores; i++)
+		if (sim->core_lead[i] != -1 && sim->core_lead[i] != i)
+			strcpy(time_string[i], time_string[sim->core_lead[i]]);
+
+	for (i = 0; i < cores; i++)
+	{
+		// If the core is idle, print a '-'
+		if (time_string[i][0] == '\0')
+			strcpy(time_string[i], "-");
+
+		if (!sim->record_diagram)
+			continue;
+
+		int length = strlen(time_string[i]);
+
+		// Ensure we have enough memory
+		while (sim->core_timing_diagram_length[i] + length * span >= sim->core_timing_diagram_size)
+		{
+			sim->core_timing_diagram_size *= 2;
+
+			for (j = 0; j < cores; j++)
+			{
+				sim->core_timing_diagram[j] = realloc(sim->core_timing_diagram[j], sim->core_timing_diagram_size + 1);
+
+				if (sim->core_timing_diagram[j] == NULL)
+				{
+					fprintf(stderr, "Out of memory.\n");
+					return SIMULATION_FAILED;
+				}
+			}
+		}
+
+		for (k = 0; k < span; k++)
+		{
+			strcpy(sim->core_timing_diagram[i] + sim->core_timing_diagram_length[i], time_string[i]);
+			sim->core_timing_diagram_length[i] += length;
+		}
+	}
+
+
+	/*
+	 * 5. Print data!
+	 */
+	narrate(sim, "At the end of time unit %d...\n", time + span - 1);
+
+	for (i = 0; i < cores; i++)
+		narrate(sim, "  Core %2d: %s\n", i, sim->core_timing_diagram[i]);
+
+	narrate(sim, "\n");
+
+	narrate_queue(sim);
+
+
+	/*
+	 * 6. Sanity Checking
+	 *
+	 * - If there's a job alive (needing to be ran) and all CPUs are idle, the scheduler failed to schedule properly.
+	 *   Jobs blocked on I/O don't need a core.
+	 */
+	if (sim->jobs_alive > sim->jobs_blocked && cores_working == 0)
+	{
+		printf("All cores are idle and at least one job remains unscheduled.\n");
+		print_available_jobs(jobs, sim->active_jobs);
+		return SIMULATION_FAILED;
+	}
+
+
+	/*
+	 * 7. Increase time
+	 */
+	sim->time += span;
+
+	return SIMULATION_RUNNING;
+}
+
+
+/**
+  Writes a snapshot of the simulation and the scheduler to file_name. The
+  snapshot is written to a temporary file first and renamed into place, so a
+  crash while writing leaves the previous snapshot intact.
+
+  @return 0 on success
+  @return -1 if the file could not be written
+ */
+int simulation_save(simulation_t *sim, const char *file_name)
+{
+	char temp_name[strlen(file_name) + 5];
+	int i;
+
+	// Snapshots hold a single CPU burst per job
+	for (i = 0; i < sim->active_jobs; i++)
+		if (sim->jobs[i].bursts != NULL)
+			return -1;
+
+	sprintf(temp_name, "%s.tmp", file_name);
+	FILE *file = fopen(temp_name, "wb");
+	if (file == NULL)
+		return -1;
+
+	fwrite(SNAPSHOT_MAGIC, 1, strlen(SNAPSHOT_MAGIC), file);
+	checkpoint_write_int(file, SNAPSHOT_VERSION);
+
+	int header[] = { sim->cores, sim->scheme, sim->quantum, sim->time, sim->active_jobs, sim->jobs_alive,
+		sim->switch_cost_fixed, sim->switch_cost_migration, sim->switches_charged, sim->migrations_charged, sim->switch_overhead, sim->affinity_window,
+		sim->next_job_id, sim->record_diagram };
+	checkpoint_write_ints(file, header, sizeof(header) / sizeof(int));
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		simulator_job_list_t *job = &sim->jobs[i];
+		int fields[] = { job->job_id, job->arrival_time, job->run_time, job->priority, job->core_id, job->arrived,
+			job->last_core, job->switch_time, job->work };
+		checkpoint_write_ints(file, fields, sizeof(fields) / sizeof(int));
+	}
+
+	checkpoint_write_ints(file, sim->quantum_clock, sim->cores);
+	checkpoint_write_ints(file, sim->core_last_job, sim->cores);
+	checkpoint_write_ints(file, sim->core_speed, sim->cores);
+	checkpoint_write_ints(file, sim->core_socket, sim->cores);
+	for (i = 0; i < sim->cores; i++)
+		checkpoint_write_string(file, sim->core_timing_diagram[i]);
+
+	scheduler_save(file);
+
+	if (ferror(file) | fclose(file))
+		return -1;
+
+	return rename(temp_name, file_name);
+}
+
+
+/**
+  Restores a simulation and its scheduler from a snapshot written by
+  simulation_save, in place of simulation_init and scheduler_start_up.
+
+  @param scheme the scheme to continue with, or -1 to keep the saved one.
+  @param quantum the RR quantum to continue with, used when scheme is RR.
+  @return 0 on success
+  @return -1 if the file could not be read or is not a snapshot
+ */
+int simulation_load(simulation_t *sim, const char *file_name, int scheme, int quantum)
+{
+	char magic[sizeof(SNAPSHOT_MAGIC)];
+	long version;
+	int header[14];
+	int i, status = -1;
+
+	FILE *file = fopen(file_name, "rb");
+	if (file == NULL)
+		return -1;
+
+	memset(sim, 0, sizeof(simulation_t));
+	if (fread(magic, 1, strlen(SNAPSHOT_MAGIC), file) != strlen(SNAPSHOT_MAGIC) ||
+			memcmp(magic, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC)) != 0 ||
+			checkpoint_read_int(file, &version) != 0 || version != SNAPSHOT_VERSION ||
+			checkpoint_read_ints(file, header, 14) != 0 || header[0] <= 0 || header[4] < 0)
+		goto done;
+
+	sim->cores = header[0];
+	sim->scheme = header[1];
+	sim->quantum = header[2];
+	sim->time = header[3];
+	sim->active_jobs = header[4];
+	sim->jobs_alive = header[5];
+	sim->switch_cost_fixed = header[6];
+	sim->switch_cost_migration = header[7];
+	sim->switches_charged = header[8];
+	sim->migrations_charged = header[9];
+	sim->switch_overhead = header[10];
+	sim->affinity_window = header[11];
+	sim->next_job_id = header[12];
+	sim->record_diagram = header[13];
+	sim->switch_cost = fixed_switch_cost;
+	sim->horizon = -1;
+	sim->core_timing_diagram_size = 1024;
+
+	sim->jobs = malloc((sim->active_jobs + 1) * sizeof(simulator_job_list_t));
+	allocate_cores(sim, sim->active_jobs);
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		simulator_job_list_t *job = &sim->jobs[i];
+		int fields[9];
+		if (checkpoint_read_ints(file, fields, 9) != 0)
+		{
+			sim->active_jobs = i;
+			goto done;
+		}
+
+		job->job_id = fields[0];
+		job->arrival_time = fields[1];
+		job->run_time = fields[2];
+		job->priority = fields[3];
+		job->core_id = fields[4];
+		job->arrived = fields[5];
+		job->last_core = fields[6];
+		job->switch_time = fields[7];
+		job->work = fields[8];
+		job->cores_needed = 1;
+		job->group = 0;
+		job->bursts = NULL;
+		job->burst_count = 1;
+		job->burst = 0;
+		job->blocked = 0;
+		job->io_device = -1;
+		memset(&job->share, 0, sizeof(simulation_share_t));
+	}
+
+	if (checkpoint_read_ints(file, sim->quantum_clock, sim->cores) != 0 ||
+			checkpoint_read_ints(file, sim->core_last_job, sim->cores) != 0 ||
+			checkpoint_read_ints(file, sim->core_speed, sim->cores) != 0 ||
+			checkpoint_read_ints(file, sim->core_socket, sim->cores) != 0)
+		goto done;
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		if (checkpoint_read_string(file, &sim->core_timing_diagram[i], &sim->core_timing_diagram_size) != 0)
+			goto done;
+		sim->core_timing_diagram_length[i] = strlen(sim->core_timing_diagram[i]);
+	}
+
+	// Every diagram must have room for the shared size, which may have grown while reading later ones
+	for (i = 0; i < sim->cores; i++)
+		sim->core_timing_diagram[i] = realloc(sim->core_timing_diagram[i], sim->core_timing_diagram_size + 1);
+
+	if (scheduler_load(file, scheme) != 0)
+		goto done;
+
+	change_scheme(sim, scheme, quantum);
+
+	status = 0;
+
+done:
+	// A snapshot cut short leaves only what was read so far to free
+	if (status != 0)
+		simulation_destroy(sim);
+	fclose(file);
+	return status;
+}
+
+
+/**
+  Frees the simulation, including the jobs it was given.
+ */
+void simulation_destroy(simulation_t *sim)
+{
+	int i;
+
+	for (i = 0; i < sim->cores; i++)
+		free(sim->core_timing_diagram[i]);
+	free(sim->core_timing_diagram);
+	free(sim->core_timing_diagram_length);
+	free(sim->quantum_clock);
+	free(sim->core_last_job);
+	free(sim->core_speed);
+	free(sim->core_socket);
+	free(sim->core_job);
+	free(sim->core_lead);
+	free(sim->io_device_job);
+	free(sim->shares);
+	for (i = 0; i < sim->active_jobs; i++)
+		free(sim->jobs[i].bursts);
+	free(sim->batch);
+	free(sim->arrival_index);
+	free(sim->arrival_core);
+	free(sim->jobs);
+}
@@ -0,0 +1,117 @@
+/** @file simulation.h
+ */
+
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include "libscheduler/libscheduler.h"
+#include "libeventlog/libeventlog.h"
+
+#define SIMULATION_RUNNING   0
+#define SIMULATION_FINISHED  1
+#define SIMULATION_FAILED   -1
+
+/**
+  CPU time a job received under a proportional share scheme, against the
+  time a perfectly fair machine would have given it. Summed over every job
+  holding the same number of tickets once they finish.
+*/
+typedef struct _simulation_share_t
+{
+	int tickets;
+	int jobs;
+	long cpu_time;     // in hundredths of a time unit
+	double fair_time;
+} simulation_share_t;
+
+typedef struct _simulator_job_list_t
+{
+	int job_id, arrival_time, run_time, priority;
+	int core_id, arrived;
+	int last_core, switch_time;
+	int work;
+	int cores_needed;
+	int group;               // tenant group, 0 unless the trace has a Group column
+	int *bursts;             // alternating CPU and I/O burst lengths, starting and ending with CPU; NULL for a single CPU burst
+	int burst_count, burst;  // number of bursts, and the one the job is in
+	int blocked, io_device, io_left, io_ticket;
+	simulation_share_t share;  // STRIDE and LOTTERY only, while the job is alive
+} simulator_job_list_t;
+
+struct _simulation_t;
+
+/**
+  Called after the scheduler has been told that job job_id finished at time.
+*/
+typedef void (*finish_function_t) (const struct _simulation_t *sim, int job_id, int time);
+
+/**
+  Context switch cost model. Returns the number of time units core core_id
+  spends switching before job next_job_id makes progress, where prev_job_id
+  is the job the core last ran (-1 if none) and last_core is the core
+  next_job_id last ran on (-1 if it has never run).
+*/
+typedef int (*switch_cost_function_t) (const struct _simulation_t *sim, int core_id, int prev_job_id, int next_job_id, int last_core);
+
+/**
+  The complete state of a simulation between two time units
+*/
+typedef struct _simulation_t
+{
+	int cores, scheme, quantum;
+	int time;
+	int event_driven;  // run every time unit up to the next event in one step
+	int horizon;       // a step never runs past this time, -1 for no limit
+
+	simulator_job_list_t *jobs;
+	int active_jobs, jobs_alive;
+	int jobs_capacity, next_job_id;
+	int jobs_reserved;  // slots laid out for jobs not added yet, see simulation_reserve_jobs
+
+	int *quantum_clock;
+	int *core_last_job;
+	int *core_speed, *core_socket;
+
+	int record_diagram;
+	char **core_timing_diagram;
+	int *core_timing_diagram_length;
+	int core_timing_diagram_size;
+
+	switch_cost_function_t switch_cost;
+	int switch_cost_fixed, switch_cost_migration;
+	int switches_charged, migrations_charged, switch_overhead;
+	int affinity_window;
+	int quiet;
+	eventlog_t *events;
+	finish_function_t finished;
+
+	scheduler_job_batch_t *batch;
+	int *arrival_index, *arrival_core;
+
+	int gang;          // jobs may need several cores at once, and are started through scheduler_gang_dispatch
+	int *core_job;     // job on each core as of the last gang dispatch, -1 if idle
+	int *core_lead;    // the core whose speed the job on each core runs at, -1 if idle
+
+	int io_devices;
+	int *io_device_job;  // job each I/O device is serving, -1 if free
+	int jobs_blocked, io_next_ticket;
+	int io_busy_time, io_wait_time, io_bursts;
+
+	simulation_share_t *shares;  // STRIDE and LOTTERY only, the finished jobs by number of tickets
+	int shares_count, shares_capacity;
+} simulation_t;
+
+int  fixed_switch_cost (const simulation_t *sim, int core_id, int prev_job_id, int next_job_id, int last_core);
+
+void simulation_init   (simulation_t *sim, int cores, int scheme, int quantum, simulator_job_list_t *jobs, int job_count,
+                        const int *core_speed, const int *core_socket);
+scheduler_t *simulation_fork(simulation_t *branch, const simulation_t *sim, int scheme, int quantum);
+void simulation_add_job(simulation_t *sim, int arrival_time, int run_time, int priority);
+void simulation_reserve_jobs(simulation_t *sim, int count);
+void simulation_set_io_devices(simulation_t *sim, int devices);
+int  simulation_step   (simulation_t *sim);
+int  simulation_save   (simulation_t *sim, const char *file_name);
+int  simulation_load   (simulation_t *sim, const char *file_name, int scheme, int quantum);
+void simulation_destroy(simulation_t *sim);
+
+#endif /* SIMULATION_H_ */
@@ -1,492 +1,1760 @@
-/*
- * CS 241
- * The University of Illinois
- */
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <string.h>
-#include <assert.h>
-
-#include "libscheduler/libscheduler.h"
-
-
-typedef struct _simulator_job_list_t
-{
-	int job_id, arrival_time, run_time, priority;
-	int core_id, arrived;
-} simulator_job_list_t;
-
-void print_usage(char *program_name)
-{
-	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> <input file>\n", program_name);
-	fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
-	fprintf(stderr, "\n");
-	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#\n");
-}
-
-int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int active_jobs)
-{
-	int i;
-	for (i = 0; i < active_jobs; i++)
-	{
-		if (jobs[i].job_id == job_id && jobs[i].arrived)
-		{
-			jobs[i].core_id = core_id;
-			return 1;
-		}
-	}
-
-	return 0;
-}
-
-void print_available_jobs(simulator_job_list_t *jobs, int active_jobs)
-{
-	printf("Active jobs are: ");
-
-	int i, first = 1;
-	for (i = 0; i < active_jobs; i++)
-	{
-		if (jobs[i].arrived)
-		{
-			if (first)
-			{
-				printf("%d", jobs[i].job_id);
-				first = 0;
-			}
-			else
-				printf(", %d", jobs[i].job_id);
-		}
-	}
-
-	if (!first)
-		printf("\n");
-}
-
-void print_available_cores(int cores)
-{
-	printf("Active cores are: ");
-
-	int i;
-	for (i = 0; i < cores; i++)
-	{
-		if (i == cores - 1)
-			printf("%d\n", i);
-		else
-			printf("%d, ", i);
-	}
-}
-
-
-int main(int argc, char **argv)
-{
-	int c;
-	int cores = 0, scheme = -1, quantum = 0;
-	char *file_name;
-
-	/*
-	 * Parse command line options.
-	 */
-	while ((c = getopt(argc, argv, "c:s:")) != -1)
-	{
-		switch (c)
-		{
-			case 'c':
-				cores = atoi(optarg);
-
-				if (cores <= 0)
-				{
-					fprintf(stderr, "Option -c <cores> require a positive number.\n");
-					print_usage(argv[0]);
-					return 1;
-				}
-				break;
-
-			case 's':
-				if (strcasecmp(optarg, "FCFS") == 0) { scheme = FCFS; }
-				else if (strcasecmp(optarg, "SJF") == 0) { scheme = SJF; }
-				else if (strcasecmp(optarg, "PSJF") == 0) { scheme = PSJF; }
-				else if (strcasecmp(optarg, "PRI") == 0) { scheme = PRI; }
-				else if (strcasecmp(optarg, "PPRI") == 0) { scheme = PPRI; }
-				else if (strncasecmp(optarg, "RR", 2) == 0)
-				{
-					scheme = RR;
-					quantum = atoi(optarg + 2);
-
-					if (quantum <= 0)
-					{
-						fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR. (Eg: -s RR2)\n");
-						print_usage(argv[0]);
-						return 1;
-					}
-				}
-				break;
-
-			case '?':
-				print_usage(argv[0]);
-				return 1;
-
-			default:
-				printf("...\n");
-				break;
-		}
-	}
-
-	if (cores == 0)
-	{
-		fprintf(stderr, "Required option -c <cores> is not present.\n");
-		print_usage(argv[0]);
-		return 1;
-	}
-
-	if (scheme == -1)
-	{
-		fprintf(stderr, "Required option -s <scheme> is not present.\n");
-		print_usage(argv[0]);
-		return 1;
-	}
-
-	if (optind == argc - 1)
-		file_name = argv[optind];
-	else
-	{
-		fprintf(stderr, "A single input file is required.\n");
-		print_usage(argv[0]);
-		return 1;
-	}
-
-
-	/*
-	 * Open the file, read the file, and populate the jobs data structure.
-	 */
-	FILE *file = fopen(file_name, "r");
-	if (file == NULL)
-	{
-		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
-		return 2;
-	}
-
-
-	int job_id = 0;
-	int jobs_ct = 10;
-	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
-
-	char line[1024 + 1];
-	fgets(line, 1024, file);  // Ignore the first (header) line
-	while (fgets(line, 1024, file) != NULL)
-	{
-		char *arrival_time = strtok(line, ",");
-		char *run_time = strtok(NULL, ",");
-		char *priority = strtok(NULL, ",");
-
-		if (arrival_time != NULL && run_time != NULL && priority != NULL)
-		{
-			if (job_id == jobs_ct)
-			{
-				jobs_ct *= 2;
-				jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
-
-				if (!jobs)
-				{
-					fprintf(stderr, "Out of memory.\n");
-					return 2;
-				}
-			}
-
-			jobs[job_id].job_id = job_id;
-			jobs[job_id].arrival_time = atoi(arrival_time);
-			jobs[job_id].run_time = atoi(run_time);
-			jobs[job_id].priority = atoi(priority);
-			jobs[job_id].core_id = -1;
-			jobs[job_id].arrived = 0;
-
-			job_id++;
-		}
-		else
-		{
-			fprintf(stderr, "Illegal file format.\n");
-			return 2;
-		}
-	}
-
-	fclose(file);
-
-
-	/*
-	 * Run the simulation.
-	 */
-
-	printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
-	if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
-	else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
-	else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
-	else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
-	else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
-	else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
-	printf(" scheduling...\n\n");
-
-	scheduler_start_up(cores, scheme);
-
-
-	int time = 0, i, j;
-	int active_jobs = job_id, jobs_alive = 0;
-
-	int *quantum_clock = malloc(cores * sizeof(int));
-	char **core_timing_diagram = malloc(cores * sizeof(char *));
-	int core_timing_diagram_size = 1024;
-
-	for (i = 0; i < cores; i++)
-	{
-		quantum_clock[i] = -1;
-		core_timing_diagram[i] = malloc(core_timing_diagram_size + 1);
-		core_timing_diagram[i][0] = '\0';
-	}
-
-	while (active_jobs > 0)
-	{
-		printf("=== [TIME %d] ===\n", time);
-
-		/*
-		 * 1. Check if any jobs finished in the last time unit.
-		 */
-		for (i = 0; i < active_jobs; i++)
-		{
-			if (jobs[i].run_time == 0)
-			{
-				// Notify the scheduler has finished
-				int job_id = jobs[i].job_id;
-				int core_id = jobs[i].core_id;
-				int new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
-
-				if (scheme == RR)
-					quantum_clock[jobs[i].core_id] = quantum;
-
-				// Delete the finished jobs, decrease the number of active jobs
-				if (i != active_jobs - 1)
-					memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
-				active_jobs--;
-				jobs_alive--;
-				i--;
-
-				// Set the new job
-				if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-				{
-					printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
-					print_available_jobs(jobs, active_jobs);
-					return 3;
-				}
-				else
-				{
-					printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-				}
-			}
-		}
-
-		/*
-		 * Check to see if we finished our last job.  (If we don't check here, we would run an extra time unit that will be totally idle.)
-		 */
-		if (active_jobs == 0)
-			break;
-
-		/*
-		 * 2. Check of any quantums expired in the last time unit.
-		 */
-		if (scheme == RR)
-		{
-			for (i = 0; i < cores; i++)
-			{
-				if (quantum_clock[i] == 0)
-				{
-					for (j = 0; j < active_jobs; j++)
-					{
-						if (jobs[j].core_id == i)
-						{
-							// Notify the scheduler the quantum has expired
-							int core_id = jobs[j].core_id;
-							int old_job_id = jobs[j].job_id;
-							int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
-
-							jobs[j].core_id = -1;
-
-							quantum_clock[core_id] = quantum;
-
-							// Set the new job
-							if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-							{
-								printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
-								print_available_jobs(jobs, active_jobs);
-								return 3;
-							}
-							else
-							{
-								printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
-								printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-							}
-
-							break;
-						}
-					}
-				}
-			}
-		}
-
-
-		/*
-		 * 3. Check for any new jobs that arrive in this time unit
-		 */
-		for (i = 0; i < active_jobs; i++)
-		{
-			if (jobs[i].arrival_time == time)
-			{
-				int new_job_core_id = scheduler_new_job(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority);
-				jobs[i].arrived = 1;
-				jobs_alive++;
-
-				if (new_job_core_id >= 0 && new_job_core_id < cores)
-				{
-					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
-							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id, new_job_core_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-
-					// Find if anyone is currently using the core.
-					for (j = 0; j < active_jobs; j++)
-						if (jobs[j].core_id == new_job_core_id)
-							jobs[j].core_id = -1;
-
-					// Assign the core to the new job
-					jobs[i].core_id = new_job_core_id;
-
-					if (scheme == RR)
-						quantum_clock[new_job_core_id] = quantum;
-				}
-				else if (new_job_core_id == -1)
-				{
-					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
-							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-				}
-				else
-				{
-					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
-					print_available_cores(cores);
-					return 3;
-				}
-			}
-		}
-
-
-		/*
-		 * 4. Run the time unit.
-		 */
-		char time_string[cores][11];
-		int cores_working = 0;
-
-		for (i = 0; i < cores; i++)
-			time_string[i][0] = '\0';
-
-		for (i = 0; i < active_jobs; i++)
-		{
-			if (jobs[i].core_id != -1)
-			{
-				cores_working++;
-				jobs[i].run_time--;
-				quantum_clock[jobs[i].core_id]--;
-
-				assert(time_string[jobs[i].core_id][0] == '\0');
-
-				if (jobs[i].job_id < 10)
-					sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
-				else if (jobs[i].job_id < 10 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
-				else if (jobs[i].job_id < 10 + 26 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
-				else
-					snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
-			}
-		}
-
-		for (i = 0; i < cores; i++)
-		{
-			// If the core is idle, print a '-'
-			if (time_string[i][0] == '\0')
-				strcpy(time_string[i], "-");
-
-			// Ensure we have enough memory
-			while (strlen(core_timing_diagram[i]) + strlen(time_string[i]) >= (unsigned int)core_timing_diagram_size)
-			{
-				core_timing_diagram_size *= 2;
-
-				for (j = 0; j < cores; j++)
-				{
-					core_timing_diagram[j] = realloc(core_timing_diagram[j], core_timing_diagram_size + 1);
-
-					if (core_timing_diagram[j] == NULL)
-					{
-						fprintf(stderr, "Out of memory.\n");
-						return 3;
-					}
-				}
-			}
-
-			strcat( core_timing_diagram[i], time_string[i] );
-		}
-
-
-		/*
-		 * 5. Print data!
-		 */
-		printf("At the end of time unit %d...\n", time);
-
-		for (i = 0; i < cores; i++)
-			printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
-
-		printf("\n");
-
-		printf("  Queue: ");
-		scheduler_show_queue();
-		printf("\n");
-		printf("\n");
-
-
-		/*
-		 * 6. Sanity Checking
-		 *
-		 * - If there's a job alive (needing to be ran) and all CPUs are idle, the scheduler failed to schedule properly.
-		 */
-		if (jobs_alive > 0 && cores_working == 0)
-		{
-			printf("All cores are idle and at least one job remains unscheduled.\n");
-			print_available_jobs(jobs, active_jobs);
-			return 3;
-		}
-
-
-		/*
-		 * 7. Increase time
-		 */
-		time++;
-	}
-
-
-	printf("FINAL TIMING DIAGRAM:\n");
-	for (i = 0; i < cores; i++)
-		printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
-
-	printf("\n");
-	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
-	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
-	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
-
-	scheduler_clean_up();
-
-
-	free(quantum_clock);
-	for (i=0; i < cores; i++)
-		free(core_timing_diagram[i]);
-	free(core_timing_diagram);
-	free(jobs);
-
-	return 0;
-}
+/*
+ * CS 241
+ * The University of Illinois
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <limits.h>
+#include <math.h>
+
+#include "libscheduler/libscheduler.h"
+#include "runtime.h"
+#include "tune.h"
+#include "cluster.h"
+#include "montecarlo.h"
+#include "simulation.h"
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> [--stats] <input file>\n", program_name);
+	fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
+	fprintf(stderr, "       %s --restore <checkpoint> [-s <scheme>] [--stats]\n", program_name);
+	fprintf(stderr, "       tail -f jobs.csv | %s -c 4 -s psjf --stream\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, stride#, lottery#\n");
+	fprintf(stderr, "Under stride# and lottery# (proportional share, with a quantum of #) each job\n");
+	fprintf(stderr, "holds as many tickets as its priority.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "The input file is a CSV trace with a header naming its \"Arrival time\", \"Run time\"\n");
+	fprintf(stderr, "and \"Priority\" columns, and optionally \"Cores\" (cores a job needs at once),\n");
+	fprintf(stderr, "\"Bursts\" (CPU and I/O burst lengths in turn, e.g. 3;2;4, in place of the run time)\n");
+	fprintf(stderr, "or \"Group\" (the job's tenant group, from 0; groups share the cores by weight and\n");
+	fprintf(stderr, "the scheme orders the jobs within each group).\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  --stats                print per-core overhead counters after the averages\n");
+	fprintf(stderr, "  --switch-cost <n>      time units a core spends switching to a different job\n");
+	fprintf(stderr, "  --migration-cost <n>   extra time units when a job resumes on another core\n");
+	fprintf(stderr, "  --affinity <window>    resume jobs on the core they last ran on if they left\n");
+	fprintf(stderr, "                         it no more than <window> time units ago\n");
+	fprintf(stderr, "  --topology <groups>    heterogeneous cores as <count>x<speed>[@<socket>],...\n");
+	fprintf(stderr, "                         e.g. 2x1.5@0,4x1@1 (replaces -c)\n");
+	fprintf(stderr, "  --runtime <usec>       run the jobs on one worker thread per core instead of\n");
+	fprintf(stderr, "                         simulating them, with a time unit of <usec> microseconds\n");
+	fprintf(stderr, "  --checkpoint <file>    where to save snapshots of the simulation\n");
+	fprintf(stderr, "  --checkpoint-at <t>    save a snapshot before running time unit <t>\n");
+	fprintf(stderr, "  --checkpoint-every <n> save a snapshot every <n> time units\n");
+	fprintf(stderr, "  --restore <file>       resume a saved simulation, optionally under another\n");
+	fprintf(stderr, "                         scheme (not stride or lottery) or other overheads\n");
+	fprintf(stderr, "  --fork <schemes>       at the --fork-at time, branch into each of the comma\n");
+	fprintf(stderr, "                         separated schemes and compare them from that point on\n");
+	fprintf(stderr, "  --fork-at <t>          the time at which to fork (default 0)\n");
+	fprintf(stderr, "  --tune <objective>     instead of one run, search the quantum of rr, stride or\n");
+	fprintf(stderr, "                         lottery (given without one, e.g. -s rr) that minimizes\n");
+	fprintf(stderr, "                         response (mean response time), p99-waiting or switches\n");
+	fprintf(stderr, "  --tune-max <q>         the largest quantum to try (default the longest run time)\n");
+	fprintf(stderr, "  --cluster <nodes>      run the trace on <nodes> nodes of -c cores each, with a\n");
+	fprintf(stderr, "                         scheduler of their own, behind a central dispatcher\n");
+	fprintf(stderr, "  --dispatch <policy>    how the dispatcher picks a node for each job: random,\n");
+	fprintf(stderr, "                         two-choices (the shorter queue of two random nodes),\n");
+	fprintf(stderr, "                         least-loaded (least remaining work) or shortest-queue\n");
+	fprintf(stderr, "                         (the default)\n");
+	fprintf(stderr, "  --threads <n>          threads the nodes, or the --monte-carlo runs, are spread\n");
+	fprintf(stderr, "                         over (default one per processor)\n");
+	fprintf(stderr, "  --monte-carlo <runs>   instead of reading a trace, simulate each scheme on <runs>\n");
+	fprintf(stderr, "                         random traces drawn from the --workload model and report\n");
+	fprintf(stderr, "                         the mean of every metric with its 95%% confidence interval\n");
+	fprintf(stderr, "  --workload <model>     jobs=<n>,interarrival=<dist>,run=<dist>,priorities=<n>,\n");
+	fprintf(stderr, "                         where <dist> is exp:<mean> or uniform:<lo>-<hi> (default\n");
+	fprintf(stderr, "                         jobs=100,interarrival=exp:2,run=exp:5,priorities=4)\n");
+	fprintf(stderr, "  --schemes <s,..>       with --monte-carlo, the schemes to compare (default -s)\n");
+	fprintf(stderr, "  --events <file>        write every scheduling event to <file>\n");
+	fprintf(stderr, "  --events-format <fmt>  json (one object per line, the default) or binary\n");
+	fprintf(stderr, "  --step <mode>          tick through every time unit (the default) or jump from\n");
+	fprintf(stderr, "                         one event to the next\n");
+	fprintf(stderr, "  --queue <backend>      keep the queue in a sorted list, a sorted array of\n");
+	fprintf(stderr, "                         precomputed keys (keyed), a heap of keys (heap), or a\n");
+	fprintf(stderr, "                         ring buffer for fcfs, rr and lottery, a heap for stride\n");
+	fprintf(stderr, "                         and a list otherwise (ring, the default)\n");
+	fprintf(stderr, "  --seed <n>             seed of the lottery draws (default 1)\n");
+	fprintf(stderr, "  --backfill <policy>    for traces with a Cores column: let later jobs start\n");
+	fprintf(stderr, "                         ahead of a waiting head job as long as they do not\n");
+	fprintf(stderr, "                         delay it (easy, the default) or never (none)\n");
+	fprintf(stderr, "  --group-weights <w,..> for traces with a Group column: the weight of groups 0,\n");
+	fprintf(stderr, "                         1, ... in turn (default 1 each)\n");
+	fprintf(stderr, "  --io-devices <n>       for traces with a Bursts column: I/O devices serving\n");
+	fprintf(stderr, "                         blocked jobs, one at a time each (default 1)\n");
+	fprintf(stderr, "  --stream               read arrivals from stdin (or the input file) as the\n");
+	fprintf(stderr, "                         simulation runs and report rolling statistics\n");
+	fprintf(stderr, "  --window <n>           statistics cover at most the last <n> finished jobs\n");
+	fprintf(stderr, "  --window-time <t>      ... and only jobs that finished in the last <t> time units\n");
+	fprintf(stderr, "  --report-every <t>     time units between rolling statistics (default 10)\n");
+}
+
+/**
+  Parses a topology description of comma separated core groups, each written
+  <count>x<speed>[@<socket>], e.g. "2x1.5@0,4x1@1" for two cores running at
+  1.5 times the base speed on socket 0 and four base-speed cores on socket 1.
+  Fills in the per-core speed (in percent) and socket arrays.
+
+  @return the number of cores described
+  @return -1 if the description is malformed
+*/
+int parse_topology(const char *description, int **core_speed, int **core_socket)
+{
+	int cores = 0;
+	const char *group = description;
+
+	*core_speed = NULL;
+	*core_socket = NULL;
+
+	while (*group != '\0')
+	{
+		int count, socket = 0, consumed = 0;
+		float speed;
+
+		if (sscanf(group, "%dx%f%n", &count, &speed, &consumed) != 2 || count <= 0 || speed <= 0)
+			return -1;
+		group += consumed;
+
+		if (*group == '@')
+		{
+			if (sscanf(group, "@%d%n", &socket, &consumed) != 1 || socket < 0)
+				return -1;
+			group += consumed;
+		}
+
+		if (*group == ',')
+			group++;
+		else if (*group != '\0')
+			return -1;
+
+		*core_speed = realloc(*core_speed, (cores + count) * sizeof(int));
+		*core_socket = realloc(*core_socket, (cores + count) * sizeof(int));
+		for (int i = 0; i < count; i++)
+		{
+			(*core_speed)[cores + i] = (int)(speed * 100 + 0.5);
+			(*core_socket)[cores + i] = socket;
+		}
+		cores += count;
+	}
+
+	return cores;
+}
+
+void print_scheduler_stats(int cores, int time)
+{
+	scheduler_core_stats_t core;
+	scheduler_stats_t total;
+
+	printf("\n");
+	printf("SCHEDULER STATISTICS:\n");
+	for (int i = 0; i < cores; i++)
+	{
+		scheduler_core_stats(i, time, &core);
+		printf("  Core %2d: busy %d, idle %d, switches %d, preemptions %d, requeues %d, migrations %d\n",
+				i, core.busy_time, core.idle_time, core.context_switches, core.preemptions, core.requeues, core.migrations);
+	}
+
+	scheduler_stats(time, &total);
+	printf("  Total:   busy %d, idle %d, switches %d, preemptions %d, requeues %d, migrations %d\n",
+			total.busy_time, total.idle_time, total.context_switches, total.preemptions, total.requeues, total.migrations);
+	printf("  Utilization: %.2f%%\n", (total.busy_time + total.idle_time) ? 100.0 * total.busy_time / (total.busy_time + total.idle_time) : 0.0);
+	printf("  Maximum Queue Depth: %d\n", total.max_queue_depth);
+}
+
+/**
+  Runs the loaded jobs on real threads instead of simulating them, then
+  compares the averages measured with the wall clock against the ones the
+  scheduler computed from the times it was given.
+*/
+int run_runtime(simulator_job_list_t *jobs, int job_count, int cores, int quantum, int unit_usec)
+{
+	runtime_job_t *runtime_jobs = malloc(job_count * sizeof(runtime_job_t));
+	float waiting = 0, turnaround = 0, response = 0;
+	int i;
+
+	for (i = 0; i < job_count; i++)
+	{
+		runtime_jobs[i].job_id = jobs[i].job_id;
+		runtime_jobs[i].arrival_time = jobs[i].arrival_time;
+		runtime_jobs[i].run_time = jobs[i].run_time;
+		runtime_jobs[i].priority = jobs[i].priority;
+	}
+
+	printf("Running on %d worker thread(s) with a time unit of %d usec...\n\n", cores, unit_usec);
+	if (runtime_run(runtime_jobs, job_count, cores, quantum, unit_usec) != 0)
+	{
+		fprintf(stderr, "Unable to start the runtime threads.\n");
+		scheduler_clean_up();
+		free(runtime_jobs);
+		free(jobs);
+		return 3;
+	}
+
+	for (i = 0; i < job_count; i++)
+	{
+		printf("Job %d: waiting %.2f, turnaround %.2f, response %.2f\n", runtime_jobs[i].job_id,
+				runtime_jobs[i].waiting_time, runtime_jobs[i].turnaround_time, runtime_jobs[i].response_time);
+		waiting += runtime_jobs[i].waiting_time;
+		turnaround += runtime_jobs[i].turnaround_time;
+		response += runtime_jobs[i].response_time;
+	}
+
+	printf("\n");
+	printf("Measured Average Waiting Time: %.2f\n", job_count ? waiting / job_count : 0);
+	printf("Measured Average Turnaround Time: %.2f\n", job_count ? turnaround / job_count : 0);
+	printf("Measured Average Response Time: %.2f\n", job_count ? response / job_count : 0);
+	printf("Scheduler Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
+	printf("Scheduler Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
+	printf("Scheduler Average Response Time: %.2f\n", scheduler_average_response_time());
+
+	scheduler_clean_up();
+	free(runtime_jobs);
+	free(jobs);
+
+	return 0;
+}
+
+/**
+  Parses a scheme name as accepted by -s, e.g. "psjf" or "rr2", storing the
+  quantum of a time sliced scheme in *quantum.
+
+  @return the scheme
+  @return -1 if the name is not a scheme or the quantum is not positive
+*/
+int parse_scheme(const char *name, int *quantum)
+{
+	if (strcasecmp(name, "FCFS") == 0) { return FCFS; }
+	else if (strcasecmp(name, "SJF") == 0) { return SJF; }
+	else if (strcasecmp(name, "PSJF") == 0) { return PSJF; }
+	else if (strcasecmp(name, "PRI") == 0) { return PRI; }
+	else if (strcasecmp(name, "PPRI") == 0) { return PPRI; }
+	else if (strncasecmp(name, "RR", 2) == 0 && atoi(name + 2) > 0)
+	{
+		*quantum = atoi(name + 2);
+		return RR;
+	}
+	else if (strncasecmp(name, "STRIDE", 6) == 0 && atoi(name + 6) > 0)
+	{
+		*quantum = atoi(name + 6);
+		return STRIDE;
+	}
+	else if (strncasecmp(name, "LOTTERY", 7) == 0 && atoi(name + 7) > 0)
+	{
+		*quantum = atoi(name + 7);
+		return LOTTERY;
+	}
+
+	return -1;
+}
+
+/**
+  Where each field of a job is in the rows of a trace
+*/
+typedef struct _trace_columns_t
+{
+	int arrival_time, run_time, priority;
+	int cores;   // -1 if the trace has no "Cores" column
+	int bursts;  // -1 if the trace has no "Bursts" column
+	int group;   // -1 if the trace has no "Group" column
+} trace_columns_t;
+
+int column_is(const char *name, int length, const char *column)
+{
+	return length == (int)strlen(column) && strncasecmp(name, column, length) == 0;
+}
+
+/**
+  Finds the columns of a trace from the names in its header line. A trace whose
+  header does not name the arrival time, run time and priority is read as
+  those three columns, in that order.
+*/
+void parse_columns(char *header, trace_columns_t *columns)
+{
+	trace_columns_t named = { -1, -1, -1, -1, -1, -1 };
+	int index = 0;
+
+	for (char *name = strtok(header, ",\r\n"); name != NULL; name = strtok(NULL, ",\r\n"), index++)
+	{
+		name += strspn(name, " \"");
+		int length = strcspn(name, "\"");
+
+		if (column_is(name, length, "Arrival time")) { named.arrival_time = index; }
+		else if (column_is(name, length, "Run time")) { named.run_time = index; }
+		else if (column_is(name, length, "Priority")) { named.priority = index; }
+		else if (column_is(name, length, "Cores")) { named.cores = index; }
+		else if (column_is(name, length, "Bursts")) { named.bursts = index; }
+		else if (column_is(name, length, "Group")) { named.group = index; }
+	}
+
+	// A Bursts column stands in for a missing run time
+	if (named.bursts != -1 && named.run_time == -1)
+		named.run_time = named.bursts;
+
+	*columns = named;
+	if (named.arrival_time == -1 || named.run_time == -1 || named.priority == -1)
+	{
+		columns->arrival_time = 0;
+		columns->run_time = 1;
+		columns->priority = 2;
+	}
+}
+
+/**
+  Parses the bursts of a job, written as CPU and I/O burst lengths in turn
+  separated by semicolons, starting and ending with a CPU burst.
+
+  @return the number of bursts, or -1 if the field is malformed
+*/
+int parse_bursts(const char *field, int **bursts)
+{
+	int count = 0, capacity = 4;
+	char *end;
+
+	*bursts = malloc(capacity * sizeof(int));
+	field += strspn(field, " \"");
+
+	while (1)
+	{
+		long length = strtol(field, &end, 10);
+		if (end == field || length < 1)
+			break;
+
+		if (count == capacity)
+			*bursts = realloc(*bursts, (capacity *= 2) * sizeof(int));
+		(*bursts)[count++] = length;
+
+		if (*end != ';')
+		{
+			end += strspn(end, " \"\r\n");
+			if (*end == '\0' && count % 2 == 1)
+				return count;
+			break;
+		}
+		field = end + 1;
+	}
+
+	free(*bursts);
+	*bursts = NULL;
+	return -1;
+}
+
+/**
+  A finished job, as remembered by the rolling statistics of a stream
+*/
+typedef struct _stream_sample_t
+{
+	int time;
+	int waiting_time, turnaround_time, response_time;
+} stream_sample_t;
+
+stream_sample_t *stream_samples;
+int stream_capacity, stream_count, stream_next, stream_finished;
+
+void stream_job_finished(const simulation_t *sim, int job_id, int time)
+{
+	scheduler_job_stats_t job;
+	stream_sample_t *sample = &stream_samples[stream_next];
+
+	scheduler_last_finished(&job);
+	sample->time = time;
+	sample->waiting_time = job.waiting_time;
+	sample->turnaround_time = job.turnaround_time;
+	sample->response_time = job.response_time;
+	stream_finished++;
+
+	stream_next = (stream_next + 1) % stream_capacity;
+	if (stream_count < stream_capacity)
+		stream_count++;
+}
+
+void print_stream_window(const simulation_t *sim, int window_time)
+{
+	double waiting = 0, turnaround = 0, response = 0;
+	int i, n = 0;
+
+	for (i = 0; i < stream_count; i++)
+	{
+		stream_sample_t *sample = &stream_samples[(stream_next - 1 - i + stream_capacity) % stream_capacity];
+		if (window_time > 0 && sim->time - sample->time >= window_time)
+			break;
+
+		waiting += sample->waiting_time;
+		turnaround += sample->turnaround_time;
+		response += sample->response_time;
+		n++;
+	}
+
+	printf("[TIME %d] %d job(s) alive, %d finished; last %d: waiting %.2f, turnaround %.2f, response %.2f\n",
+			sim->time, sim->jobs_alive, stream_finished, n,
+			n ? waiting / n : 0, n ? turnaround / n : 0, n ? response / n : 0);
+	fflush(stdout);
+}
+
+/**
+  Runs the simulation until time until, printing the rolling statistics each
+  time another report_every time units have gone by.
+*/
+int advance_stream(simulation_t *sim, int until, int window_time, int report_every, int *next_report)
+{
+	// Until INT_MAX runs the jobs already admitted to completion
+	while (sim->time < until && !(until == INT_MAX && sim->active_jobs == 0))
+	{
+		sim->horizon = (until < *next_report) ? until : *next_report;
+
+		// With nothing to run the cores sit idle until the next arrival
+		if (sim->active_jobs == 0)
+			sim->time = sim->horizon;
+		else if (simulation_step(sim) == SIMULATION_FAILED)
+			return SIMULATION_FAILED;
+		else if (sim->active_jobs == 0)
+			continue;
+
+		if (sim->time >= *next_report)
+		{
+			print_stream_window(sim, window_time);
+			*next_report = (sim->time / report_every + 1) * report_every;
+		}
+	}
+
+	return SIMULATION_RUNNING;
+}
+
+/**
+  Counts the records of a stream that can be read ahead, leaving the stream
+  where it was.
+
+  @return the number of records, or 0 if the stream cannot be read ahead
+*/
+int count_stream_records(FILE *file)
+{
+	char line[1024 + 1];
+	long start = ftell(file);
+	int arrival_time, run_time, priority, records = 0;
+
+	if (start == -1)
+		return 0;
+
+	while (fgets(line, 1024, file) != NULL)
+		if (sscanf(line, "%d,%d,%d", &arrival_time, &run_time, &priority) == 3)
+			records++;
+
+	clearerr(file);
+	fseek(file, start, SEEK_SET);
+	return records;
+}
+
+/**
+  Feeds the simulation from a stream of arrivals, one CSV record per line in
+  the order they arrive. Time advances as the records come in, and memory use
+  stays bounded however long a piped stream is: finished jobs are dropped and
+  no timing diagram is kept.
+
+  A stream from a file is counted first, and the jobs still to come keep a
+  slot each, as in a run of the whole file. The stream then ends as that run
+  does, since jobs that finish or arrive together reach the scheduler in the
+  same order.
+
+  @return 0 on success
+  @return 2 if the stream holds a malformed record, or a record with more
+  columns than the arrival time, run time and priority
+  @return 3 if the scheduler made an invalid decision
+*/
+int run_stream(simulation_t *sim, FILE *file, int window, int window_time, int report_every)
+{
+	char line[1024 + 1];
+	int records = 0, next_report = report_every, result = 0;
+
+	stream_capacity = window;
+	stream_count = stream_next = stream_finished = 0;
+	stream_samples = malloc(window * sizeof(stream_sample_t));
+
+	sim->quiet = 1;
+	sim->record_diagram = 0;
+	sim->finished = stream_job_finished;
+	simulation_reserve_jobs(sim, count_stream_records(file));
+
+	while (result == 0 && fgets(line, 1024, file) != NULL)
+	{
+		int arrival_time, run_time, priority, consumed = 0;
+		int fields = sscanf(line, "%d,%d,%d%n", &arrival_time, &run_time, &priority, &consumed);
+
+		// A header line may start the stream
+		if (fields != 3 && records++ == 0)
+			continue;
+
+		// Cores, Bursts or Group columns cannot be followed in a stream, so a record carrying them is refused
+		if (fields != 3 || line[consumed + strspn(line + consumed, " \t\r\n")] != '\0')
+		{
+			fprintf(stderr, "Illegal record \"%.*s\" in the stream.\n", (int)strcspn(line, "\r\n"), line);
+			result = 2;
+			break;
+		}
+		records++;
+
+		// Late records arrive now; the past cannot be changed
+		if (arrival_time < sim->time)
+			arrival_time = sim->time;
+
+		if (advance_stream(sim, arrival_time, window_time, report_every, &next_report) == SIMULATION_FAILED)
+			result = 3;
+		else
+			simulation_add_job(sim, arrival_time, run_time, priority);
+	}
+
+	// Once the stream ends, run the jobs that are left.  A file cut short while it was read leaves slots unfilled.
+	simulation_reserve_jobs(sim, 0);
+	if (result == 0 && advance_stream(sim, INT_MAX, window_time, report_every, &next_report) == SIMULATION_FAILED)
+		result = 3;
+
+	if (result == 0)
+	{
+		print_stream_window(sim, window_time);
+		printf("\n");
+		printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
+		printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
+		printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+	}
+
+	if (file != stdin)
+		fclose(file);
+	free(stream_samples);
+	scheduler_clean_up();
+	simulation_destroy(sim);
+
+	return result;
+}
+
+/**
+  Closes the event log, if there is one, once the simulation is over.
+
+  @return result, or 2 if the event log could not be written
+*/
+int close_events(eventlog_t *events, int result)
+{
+	if (events != NULL && eventlog_close(events) != 0)
+	{
+		fprintf(stderr, "Unable to write the event log.\n");
+		return result ? result : 2;
+	}
+
+	return result;
+}
+
+const char *dispatch_names[] = { "random choice", "the power of two choices", "least remaining work", "joining the shortest queue" };
+
+void print_scheme(int scheme, int quantum)
+{
+	if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
+	else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
+	else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
+	else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
+	else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
+	else if (scheme == RR) { printf("Round Robin (RR)"); }
+	else if (scheme == STRIDE) { printf("Stride Scheduling (STRIDE)"); }
+	else if (scheme == LOTTERY) { printf("Lottery Scheduling (LOTTERY)"); }
+
+	if (SCHEME_TIME_SLICED(scheme) && quantum > 0)
+		printf(" with a quantum of %d", quantum);
+}
+
+int compare_share_tickets(const void *a, const void *b)
+{
+	return ((const simulation_share_t *)a)->tickets - ((const simulation_share_t *)b)->tickets;
+}
+
+/**
+  Prints, for the jobs holding each number of tickets, the share of the CPU
+  time they received while jobs competed for the cores against the share a
+  perfectly fair machine would have given them.
+*/
+void print_shares(const simulation_t *sim)
+{
+	simulation_share_t *shares = malloc((sim->shares_count + 1) * sizeof(simulation_share_t));
+	double cpu_total = 0, fair_total = 0;
+	int i;
+
+	for (i = 0; i < sim->shares_count; i++)
+	{
+		shares[i] = sim->shares[i];
+		cpu_total += sim->shares[i].cpu_time / 100.0;
+		fair_total += sim->shares[i].fair_time;
+	}
+	qsort(shares, sim->shares_count, sizeof(simulation_share_t), compare_share_tickets);
+
+	printf("CPU Share by Tickets (achieved vs target):\n");
+	for (i = 0; i < sim->shares_count; i++)
+		printf("  %d ticket(s), %d job(s): %.2f%% vs %.2f%%\n", shares[i].tickets, shares[i].jobs,
+				cpu_total ? 100.0 * shares[i].cpu_time / 100.0 / cpu_total : 0.0,
+				fair_total ? 100.0 * shares[i].fair_time / fair_total : 0.0);
+
+	free(shares);
+}
+
+/**
+  Prints, for each tenant group, its weight, the CPU time its jobs received
+  and its jobs' average times.
+*/
+void print_groups()
+{
+	scheduler_group_stats_t stats;
+	int i, cpu_total = 0;
+
+	for (i = 0; i < scheduler_group_count(); i++)
+	{
+		scheduler_group_stats(i, &stats);
+		cpu_total += stats.cpu_time;
+	}
+
+	printf("Groups:\n");
+	for (i = 0; i < scheduler_group_count(); i++)
+	{
+		scheduler_group_stats(i, &stats);
+		if (stats.jobs_finished == 0)
+			continue;
+		printf("  Group %d (weight %d), %d job(s): CPU time %d (%.2f%%), waiting %.2f, turnaround %.2f, response %.2f\n",
+				i, stats.weight, stats.jobs_finished, stats.cpu_time, cpu_total ? 100.0 * stats.cpu_time / cpu_total : 0.0,
+				stats.total_waiting / stats.jobs_finished, stats.total_turnaround / stats.jobs_finished,
+				stats.total_response / stats.jobs_finished);
+	}
+}
+
+/**
+  One branch of a fork, run to completion on its own thread
+*/
+typedef struct _fork_branch_t
+{
+	pthread_t thread;
+	simulation_t sim;
+	scheduler_t *scheduler;
+	scheduler_stats_t stats;
+	int status;
+	int started;  // whether the branch has a thread of its own to join
+} fork_branch_t;
+
+void *run_branch(void *arg)
+{
+	fork_branch_t *branch = arg;
+
+	scheduler_attach(branch->scheduler);
+
+	do
+		branch->status = simulation_step(&branch->sim);
+	while (branch->status == SIMULATION_RUNNING);
+
+	scheduler_stats(branch->sim.time, &branch->stats);
+	scheduler_clean_up();
+
+	return NULL;
+}
+
+/**
+  Forks the simulation into one branch per scheme, runs the branches
+  concurrently and reports each one over the window after the fork only.
+
+  @return 0 on success
+  @return 3 if a branch failed
+*/
+int run_fork(simulation_t *sim, int branches, const int *schemes, const int *quanta)
+{
+	fork_branch_t *branch = malloc(branches * sizeof(fork_branch_t));
+	scheduler_stats_t before;
+	int i, c, failed = 0;
+
+	scheduler_stats(sim->time, &before);
+
+	for (i = 0; i < branches; i++)
+	{
+		branch[i].scheduler = simulation_fork(&branch[i].sim, sim, schemes[i], quanta[i]);
+		branch[i].sim.quiet = 1;
+	}
+
+	for (i = 0; i < branches; i++)
+		branch[i].started = pthread_create(&branch[i].thread, NULL, run_branch, &branch[i]) == 0;
+	// A branch without a thread runs on this one, which keeps its own scheduler afterwards
+	for (i = 0; i < branches; i++)
+		if (!branch[i].started)
+		{
+			scheduler_t *own = scheduler_current();
+			run_branch(&branch[i]);
+			scheduler_attach(own);
+		}
+
+	printf("FORKED AT TIME %d INTO %d BRANCH(ES):\n", sim->time, branches);
+	for (i = 0; i < branches; i++)
+	{
+		if (branch[i].started)
+			pthread_join(branch[i].thread, NULL);
+
+		scheduler_stats_t *after = &branch[i].stats;
+		int finished = after->jobs_finished - before.jobs_finished;
+		int busy = after->busy_time - before.busy_time;
+		int idle = after->idle_time - before.idle_time;
+
+		printf("\n");
+		printf("Branch %d: ", i + 1);
+		print_scheme(schemes[i], quanta[i]);
+		printf("\n");
+
+		if (branch[i].status == SIMULATION_FAILED)
+		{
+			printf("  The scheduler made an invalid decision at time %d.\n", branch[i].sim.time);
+			failed = 1;
+			simulation_destroy(&branch[i].sim);
+			continue;
+		}
+
+		for (c = 0; c < branch[i].sim.cores; c++)
+			printf("  Core %2d: %s\n", c, branch[i].sim.core_timing_diagram[c]);
+		printf("  Jobs Finished: %d by time %d\n", finished, branch[i].sim.time);
+		printf("  Average Waiting Time: %.2f\n", finished ? (after->total_waiting - before.total_waiting) / finished : 0);
+		printf("  Average Turnaround Time: %.2f\n", finished ? (after->total_turnaround - before.total_turnaround) / finished : 0);
+		printf("  Average Response Time: %.2f\n", finished ? (after->total_response - before.total_response) / finished : 0);
+		printf("  Utilization: %.2f%%\n", (busy + idle) ? 100.0 * busy / (busy + idle) : 0.0);
+		printf("  Switches %d, preemptions %d, requeues %d, migrations %d\n",
+				after->context_switches - before.context_switches, after->preemptions - before.preemptions,
+				after->requeues - before.requeues, after->migrations - before.migrations);
+		if (branch[i].sim.switch_cost_fixed > 0 || branch[i].sim.switch_cost_migration > 0)
+			printf("  Context Switch Overhead: %d time unit(s)\n", branch[i].sim.switch_overhead - sim->switch_overhead);
+
+		simulation_destroy(&branch[i].sim);
+	}
+
+	free(branch);
+
+	return failed ? 3 : 0;
+}
+
+void print_topology(int cores, const int *core_speed, const int *core_socket)
+{
+	printf("Topology:");
+	for (int i = 0; i < cores; i++)
+		printf(" core %d (speed %.2f, socket %d)%s", i, core_speed[i] / 100.0, core_socket[i], i == cores - 1 ? "" : ",");
+	printf("\n");
+}
+
+void print_distribution(const char *name, const workload_distribution_t *distribution)
+{
+	if (distribution->uniform)
+		printf("%s uniform from %.0f to %.0f", name, ceil(distribution->a), floor(distribution->b));
+	else
+		printf("%s exponential with mean %.2f", name, distribution->a);
+}
+
+void print_estimate(const char *name, const montecarlo_estimate_t *estimate, const char *unit)
+{
+	printf("  %-24s %10.2f%s +/- %.2f  (95%% CI %.2f to %.2f, sd %.2f)\n", name, estimate->mean, unit, estimate->half_width,
+			estimate->mean - estimate->half_width, estimate->mean + estimate->half_width, estimate->deviation);
+}
+
+/**
+  Simulates each scheme on random traces drawn from a workload model, and
+  prints the mean of every metric with its 95% confidence interval, then how
+  each scheme differs from the first one on the same traces.
+
+  @return 0 on success
+  @return 3 if a scheduler made an invalid decision in some run
+*/
+int run_montecarlo(const workload_t *workload, int runs, montecarlo_result_t *results, int scheme_count, int cores,
+		int *core_speed, int *core_socket, int topology, int switch_cost_fixed, int switch_cost_migration, int affinity_window, int threads, unsigned long seed)
+{
+	static const char *differences[] = { "waiting", "turnaround", "response" };
+	simulation_t sim;
+	int i, m, result;
+
+	printf("Simulating %d random trace(s) of %d job(s) on %d core(s): ", runs, workload->jobs, cores);
+	print_distribution("interarrival time", &workload->interarrival);
+	printf(", ");
+	print_distribution("run time", &workload->run_time);
+	printf(", %d priorities...\n", workload->priorities);
+	if (topology)
+		print_topology(cores, core_speed, core_socket);
+
+	// Every run starts from the cores and overheads of this empty simulation
+	simulation_init(&sim, cores, results[0].scheme, results[0].quantum, NULL, 0, core_speed, core_socket);
+	sim.switch_cost_fixed = switch_cost_fixed > 0 ? switch_cost_fixed : 0;
+	sim.switch_cost_migration = switch_cost_migration > 0 ? switch_cost_migration : 0;
+	sim.affinity_window = affinity_window;
+	free(core_speed);
+	free(core_socket);
+
+	result = montecarlo_run(&sim, workload, runs, results, scheme_count, threads, seed);
+	simulation_destroy(&sim);
+
+	for (i = 0; i < scheme_count; i++)
+	{
+		printf("\n");
+		print_scheme(results[i].scheme, results[i].quantum);
+		printf(", %d run(s):\n", results[i].runs);
+		if (results[i].failed)
+			printf("  The scheduler made an invalid decision in %d run(s), left out below.\n", results[i].failed);
+
+		print_estimate("Average Waiting Time", &results[i].metric[MONTECARLO_WAITING], "");
+		print_estimate("Average Turnaround Time", &results[i].metric[MONTECARLO_TURNAROUND], "");
+		print_estimate("Average Response Time", &results[i].metric[MONTECARLO_RESPONSE], "");
+		print_estimate("Utilization", &results[i].metric[MONTECARLO_UTILIZATION], "%");
+		print_estimate("Context Switches", &results[i].metric[MONTECARLO_SWITCHES], "");
+		print_estimate("Makespan", &results[i].metric[MONTECARLO_MAKESPAN], "");
+	}
+
+	if (scheme_count > 1)
+	{
+		printf("\n");
+		printf("Differences from ");
+		print_scheme(results[0].scheme, results[0].quantum);
+		printf(" on the same traces (* where the 95%% CI excludes 0):\n");
+		for (i = 1; i < scheme_count; i++)
+		{
+			printf("  ");
+			print_scheme(results[i].scheme, results[i].quantum);
+			printf(":\n   ");
+			for (m = 0; m <= MONTECARLO_RESPONSE; m++)
+			{
+				montecarlo_estimate_t *difference = &results[i].difference[m];
+				printf(" %s %+.2f +/- %.2f%s%s", differences[m], difference->mean, difference->half_width,
+						fabs(difference->mean) > difference->half_width ? "*" : "", m < MONTECARLO_RESPONSE ? "," : "\n");
+			}
+		}
+	}
+
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+	int cores = 0, scheme = -1, quantum = 0;
+	int show_stats = 0;
+	int switch_cost_fixed = -1, switch_cost_migration = -1;
+	int affinity_window = -1;
+	int topology_cores = 0, *core_speed = NULL, *core_socket = NULL;
+	int runtime_unit = 0;
+	char *checkpoint_file = NULL, *restore_file = NULL;
+	int checkpoint_at = -1, checkpoint_every = 0;
+	int event_driven = 0;
+	int gang = 0, bursts = 0, io_devices = 1;
+	int groups = 0, group_weight_count = 0, group_weights[64];
+	unsigned long seed = 1;
+	backfill_t backfill = BACKFILL_EASY;
+	int stream = 0, stream_window = 100, stream_window_time = 0, stream_report_every = 10;
+	int fork_at = 0, fork_branches = 0, fork_schemes[16], fork_quanta[16];
+	int tune = -1, tune_max = 0;
+	int cluster_nodes = 0, cluster_threads = 0, dispatch = -1;
+	int montecarlo_runs = 0, montecarlo_schemes = 0, workload_given = 0;
+	montecarlo_result_t montecarlo_results[16];
+	workload_t workload = { 100, { 0, 2, 0 }, { 0, 5, 0 }, 4 };
+	char *events_file = NULL;
+	eventlog_format_t events_format = EVENTLOG_JSON;
+	eventlog_t *events = NULL;
+	FILE *stream_file = NULL;
+	char *file_name;
+	simulation_t sim;
+
+	static struct option long_options[] =
+	{
+		{ "stats", no_argument, NULL, 'S' },
+		{ "switch-cost", required_argument, NULL, 'W' },
+		{ "migration-cost", required_argument, NULL, 'M' },
+		{ "affinity", required_argument, NULL, 'A' },
+		{ "topology", required_argument, NULL, 'T' },
+		{ "runtime", required_argument, NULL, 'R' },
+		{ "checkpoint", required_argument, NULL, 'K' },
+		{ "checkpoint-at", required_argument, NULL, 'a' },
+		{ "checkpoint-every", required_argument, NULL, 'e' },
+		{ "restore", required_argument, NULL, 'r' },
+		{ "fork", required_argument, NULL, 'F' },
+		{ "fork-at", required_argument, NULL, 'f' },
+		{ "tune", required_argument, NULL, 'U' },
+		{ "tune-max", required_argument, NULL, 'X' },
+		{ "cluster", required_argument, NULL, 'N' },
+		{ "dispatch", required_argument, NULL, 'H' },
+		{ "threads", required_argument, NULL, 'J' },
+		{ "monte-carlo", required_argument, NULL, 'C' },
+		{ "workload", required_argument, NULL, 'Y' },
+		{ "schemes", required_argument, NULL, 'Z' },
+		{ "events", required_argument, NULL, 'E' },
+		{ "events-format", required_argument, NULL, 'O' },
+		{ "step", required_argument, NULL, 'P' },
+		{ "queue", required_argument, NULL, 'Q' },
+		{ "backfill", required_argument, NULL, 'B' },
+		{ "io-devices", required_argument, NULL, 'D' },
+		{ "group-weights", required_argument, NULL, 'G' },
+		{ "seed", required_argument, NULL, 'd' },
+		{ "stream", no_argument, NULL, 'i' },
+		{ "window", required_argument, NULL, 'w' },
+		{ "window-time", required_argument, NULL, 't' },
+		{ "report-every", required_argument, NULL, 'p' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	/*
+	 * Parse command line options.
+	 */
+	while ((c = getopt_long(argc, argv, "c:s:", long_options, NULL)) != -1)
+	{
+		switch (c)
+		{
+			case 'c':
+				cores = atoi(optarg);
+
+				if (cores <= 0)
+				{
+					fprintf(stderr, "Option -c <cores> require a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 's':
+				quantum = 0;
+				scheme = parse_scheme(optarg, &quantum);
+
+				// A time-sliced scheme without a quantum, for --tune to search
+				if (strcasecmp(optarg, "RR") == 0) { scheme = RR; }
+				else if (strcasecmp(optarg, "STRIDE") == 0) { scheme = STRIDE; }
+				else if (strcasecmp(optarg, "LOTTERY") == 0) { scheme = LOTTERY; }
+				else if (scheme == -1 && (strncasecmp(optarg, "RR", 2) == 0 || strncasecmp(optarg, "STRIDE", 6) == 0 || strncasecmp(optarg, "LOTTERY", 7) == 0))
+				{
+					fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR, STRIDE and LOTTERY. (Eg: -s RR2)\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'S':
+				show_stats = 1;
+				break;
+
+			case 'W':
+			case 'M':
+				if (atoi(optarg) < 0)
+				{
+					fprintf(stderr, "Option --%s requires a non-negative number.\n", c == 'W' ? "switch-cost" : "migration-cost");
+					print_usage(argv[0]);
+					return 1;
+				}
+				if (c == 'W')
+					switch_cost_fixed = atoi(optarg);
+				else
+					switch_cost_migration = atoi(optarg);
+				break;
+
+			case 'A':
+				affinity_window = atoi(optarg);
+
+				if (affinity_window < 0)
+				{
+					fprintf(stderr, "Option --affinity <window> requires a non-negative number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'R':
+				runtime_unit = atoi(optarg);
+
+				if (runtime_unit <= 0)
+				{
+					fprintf(stderr, "Option --runtime <usec> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'T':
+				topology_cores = parse_topology(optarg, &core_speed, &core_socket);
+
+				if (topology_cores <= 0)
+				{
+					fprintf(stderr, "Option --topology requires groups of the form <count>x<speed>[@<socket>].\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'K':
+				checkpoint_file = optarg;
+				break;
+
+			case 'a':
+			case 'e':
+				if (atoi(optarg) < (c == 'a' ? 0 : 1))
+				{
+					fprintf(stderr, "Option --%s requires a %s number.\n", c == 'a' ? "checkpoint-at" : "checkpoint-every", c == 'a' ? "non-negative" : "positive");
+					print_usage(argv[0]);
+					return 1;
+				}
+				if (c == 'a')
+					checkpoint_at = atoi(optarg);
+				else
+					checkpoint_every = atoi(optarg);
+				break;
+
+			case 'r':
+				restore_file = optarg;
+				break;
+
+			case 'F':
+				for (char *name = strtok(optarg, ","); name != NULL; name = strtok(NULL, ","))
+				{
+					fork_quanta[fork_branches] = 0;
+					if (fork_branches == 16 || (fork_schemes[fork_branches] = parse_scheme(name, &fork_quanta[fork_branches])) == -1)
+					{
+						fprintf(stderr, "Option --fork requires up to 16 comma separated schemes. (Eg: --fork psjf,ppri,rr2)\n");
+						print_usage(argv[0]);
+						return 1;
+					}
+					fork_branches++;
+				}
+				break;
+
+			case 'U':
+				if (strcasecmp(optarg, "response") == 0) { tune = TUNE_RESPONSE; }
+				else if (strcasecmp(optarg, "p99-waiting") == 0) { tune = TUNE_P99_WAITING; }
+				else if (strcasecmp(optarg, "switches") == 0) { tune = TUNE_SWITCHES; }
+				else
+				{
+					fprintf(stderr, "Option --tune requires response, p99-waiting or switches.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'X':
+				tune_max = atoi(optarg);
+
+				if (tune_max <= 0)
+				{
+					fprintf(stderr, "Option --tune-max <q> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'N':
+			case 'J':
+				if (atoi(optarg) <= 0)
+				{
+					fprintf(stderr, "Option --%s requires a positive number.\n", c == 'N' ? "cluster <nodes>" : "threads <n>");
+					print_usage(argv[0]);
+					return 1;
+				}
+				if (c == 'N')
+					cluster_nodes = atoi(optarg);
+				else
+					cluster_threads = atoi(optarg);
+				break;
+
+			case 'H':
+				if (strcasecmp(optarg, "random") == 0) { dispatch = DISPATCH_RANDOM; }
+				else if (strcasecmp(optarg, "two-choices") == 0) { dispatch = DISPATCH_TWO_CHOICES; }
+				else if (strcasecmp(optarg, "least-loaded") == 0) { dispatch = DISPATCH_LEAST_LOADED; }
+				else if (strcasecmp(optarg, "shortest-queue") == 0) { dispatch = DISPATCH_SHORTEST_QUEUE; }
+				else
+				{
+					fprintf(stderr, "Option --dispatch requires random, two-choices, least-loaded or shortest-queue.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'C':
+				montecarlo_runs = atoi(optarg);
+
+				if (montecarlo_runs <= 0)
+				{
+					fprintf(stderr, "Option --monte-carlo <runs> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'Y':
+				workload_given = 1;
+				if (workload_parse(optarg, &workload) != 0)
+				{
+					fprintf(stderr, "Option --workload requires comma separated jobs=<n>, interarrival=<dist>, run=<dist> or priorities=<n>,\n");
+					fprintf(stderr, "where <dist> is exp:<mean> or uniform:<lo>-<hi>. (Eg: --workload jobs=200,run=uniform:1-20)\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'Z':
+				for (char *name = strtok(optarg, ","); name != NULL; name = strtok(NULL, ","))
+				{
+					montecarlo_results[montecarlo_schemes].quantum = 0;
+					if (montecarlo_schemes == 16 || (montecarlo_results[montecarlo_schemes].scheme = parse_scheme(name, &montecarlo_results[montecarlo_schemes].quantum)) == -1)
+					{
+						fprintf(stderr, "Option --schemes requires up to 16 comma separated schemes. (Eg: --schemes psjf,ppri,rr2)\n");
+						print_usage(argv[0]);
+						return 1;
+					}
+					montecarlo_schemes++;
+				}
+				break;
+
+			case 'E':
+				events_file = optarg;
+				break;
+
+			case 'O':
+				if (strcasecmp(optarg, "json") == 0) { events_format = EVENTLOG_JSON; }
+				else if (strcasecmp(optarg, "binary") == 0) { events_format = EVENTLOG_BINARY; }
+				else
+				{
+					fprintf(stderr, "Option --events-format requires json or binary.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'P':
+				if (strcasecmp(optarg, "tick") == 0) { event_driven = 0; }
+				else if (strcasecmp(optarg, "event") == 0) { event_driven = 1; }
+				else
+				{
+					fprintf(stderr, "Option --step requires tick or event.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'B':
+				if (strcasecmp(optarg, "easy") == 0) { backfill = BACKFILL_EASY; }
+				else if (strcasecmp(optarg, "none") == 0) { backfill = BACKFILL_NONE; }
+				else
+				{
+					fprintf(stderr, "Option --backfill requires easy or none.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'D':
+				io_devices = atoi(optarg);
+
+				if (io_devices <= 0)
+				{
+					fprintf(stderr, "Option --io-devices <n> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'd':
+				seed = strtoul(optarg, NULL, 10);
+				break;
+
+			case 'G':
+				for (char *weight = strtok(optarg, ","); weight != NULL; weight = strtok(NULL, ","))
+				{
+					if (group_weight_count == 64 || (group_weights[group_weight_count] = atoi(weight)) <= 0)
+					{
+						fprintf(stderr, "Option --group-weights requires up to 64 comma separated positive numbers. (Eg: --group-weights 2,1)\n");
+						print_usage(argv[0]);
+						return 1;
+					}
+					group_weight_count++;
+				}
+				break;
+
+			case 'Q':
+				if (strcasecmp(optarg, "list") == 0) { scheduler_set_queue_backend(QUEUE_LIST); }
+				else if (strcasecmp(optarg, "keyed") == 0) { scheduler_set_queue_backend(QUEUE_KEYED); }
+				else if (strcasecmp(optarg, "ring") == 0) { scheduler_set_queue_backend(QUEUE_RING); }
+				else if (strcasecmp(optarg, "heap") == 0) { scheduler_set_queue_backend(QUEUE_HEAP); }
+				else
+				{
+					fprintf(stderr, "Option --queue requires list, keyed, ring or heap.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'i':
+				stream = 1;
+				break;
+
+			case 'w':
+			case 't':
+			case 'p':
+				if (atoi(optarg) < (c == 't' ? 0 : 1))
+				{
+					fprintf(stderr, "Option --%s requires a %s number.\n", c == 'w' ? "window" : c == 't' ? "window-time" : "report-every",
+							c == 't' ? "non-negative" : "positive");
+					print_usage(argv[0]);
+					return 1;
+				}
+				if (c == 'w')
+					stream_window = atoi(optarg);
+				else if (c == 't')
+					stream_window_time = atoi(optarg);
+				else
+					stream_report_every = atoi(optarg);
+				break;
+
+			case 'f':
+				fork_at = atoi(optarg);
+
+				if (fork_at < 0)
+				{
+					fprintf(stderr, "Option --fork-at <t> requires a non-negative number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case '?':
+				print_usage(argv[0]);
+				return 1;
+
+			default:
+				printf("...\n");
+				break;
+		}
+	}
+
+	if (tune >= 0)
+	{
+		if (scheme != -1 && !SCHEME_TIME_SLICED(scheme))
+		{
+			fprintf(stderr, "Option --tune requires rr, stride or lottery.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+		if (restore_file != NULL || stream || runtime_unit > 0 || fork_branches > 0 || checkpoint_file != NULL || events_file != NULL)
+		{
+			fprintf(stderr, "Option --tune cannot be combined with --restore, --stream, --runtime, --fork, --checkpoint or --events.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		// The quantum is what the tuner searches for
+		quantum = 0;
+	}
+	else if (tune_max > 0)
+	{
+		fprintf(stderr, "Option --tune-max requires --tune.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	else if (SCHEME_TIME_SLICED(scheme) && quantum == 0)
+	{
+		fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR, STRIDE and LOTTERY. (Eg: -s RR2)\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (dispatch >= 0 && cluster_nodes == 0)
+	{
+		fprintf(stderr, "Option --dispatch requires --cluster.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	if (cluster_nodes > 0 && (restore_file != NULL || stream || runtime_unit > 0 || fork_branches > 0 || checkpoint_file != NULL
+			|| events_file != NULL || tune >= 0))
+	{
+		fprintf(stderr, "Option --cluster cannot be combined with --restore, --stream, --runtime, --fork, --checkpoint, --events or --tune.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	if (montecarlo_runs > 0 && (restore_file != NULL || stream || runtime_unit > 0 || fork_branches > 0 || checkpoint_file != NULL
+			|| events_file != NULL || tune >= 0 || cluster_nodes > 0))
+	{
+		fprintf(stderr, "Option --monte-carlo cannot be combined with --restore, --stream, --runtime, --fork, --checkpoint, --events, --tune or --cluster.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	if (montecarlo_runs == 0 && (workload_given || montecarlo_schemes > 0))
+	{
+		fprintf(stderr, "Options --workload and --schemes require --monte-carlo.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	if (cluster_nodes == 0 && montecarlo_runs == 0 && cluster_threads > 0)
+	{
+		fprintf(stderr, "Option --threads requires --cluster or --monte-carlo.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	else if (cluster_nodes > 0 && dispatch == -1)
+		dispatch = DISPATCH_SHORTEST_QUEUE;
+
+	if ((checkpoint_at >= 0 || checkpoint_every > 0) && checkpoint_file == NULL)
+	{
+		fprintf(stderr, "Options --checkpoint-at and --checkpoint-every require --checkpoint <file>.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// Snapshots do not keep the passes and the random number generator of the proportional share schemes,
+	// so a run can neither be saved under them nor restored into them
+	if ((checkpoint_file != NULL || restore_file != NULL) && (scheme == STRIDE || scheme == LOTTERY))
+	{
+		fprintf(stderr, "Options --checkpoint and --restore cannot be combined with stride or lottery.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (restore_file != NULL)
+	{
+		/*
+		 * Resume a checkpointed simulation.  The cores and jobs come from the snapshot; the scheme and the
+		 * overheads may be changed to see how the rest of the run would have gone under them.
+		 */
+		if (optind != argc || topology_cores > 0 || runtime_unit > 0 || stream)
+		{
+			fprintf(stderr, "Option --restore does not take an input file, --topology, --runtime or --stream.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (simulation_load(&sim, restore_file, scheme, quantum) != 0)
+		{
+			fprintf(stderr, "Unable to restore a simulation from \"%s\".\n", restore_file);
+			return 2;
+		}
+
+		if (cores != 0 && cores != sim.cores)
+		{
+			fprintf(stderr, "Option -c %d does not match the %d core(s) in the checkpoint.\n", cores, sim.cores);
+			simulation_destroy(&sim);
+			scheduler_clean_up();
+			return 1;
+		}
+
+		scheduler_set_seed(seed);
+		if (switch_cost_fixed >= 0)
+			sim.switch_cost_fixed = switch_cost_fixed;
+		if (switch_cost_migration >= 0)
+			sim.switch_cost_migration = switch_cost_migration;
+		if (affinity_window >= 0)
+		{
+			sim.affinity_window = affinity_window;
+			scheduler_set_affinity(affinity_window);
+		}
+
+		printf("Resumed %d core(s) and %d job(s) using ", sim.cores, sim.active_jobs);
+		print_scheme(sim.scheme, sim.quantum);
+		printf(" scheduling at time %d from \"%s\"...\n", sim.time, restore_file);
+		for (c = 0; c < sim.cores; c++)
+			if (sim.core_speed[c] != 100 || sim.core_socket[c] != 0)
+				break;
+		if (c < sim.cores)
+			print_topology(sim.cores, sim.core_speed, sim.core_socket);
+		printf("\n");
+	}
+	else
+	{
+		if (topology_cores > 0)
+		{
+			if (cores != 0 && cores != topology_cores)
+			{
+				fprintf(stderr, "Option -c %d does not match the %d core(s) in the topology.\n", cores, topology_cores);
+				print_usage(argv[0]);
+				return 1;
+			}
+			cores = topology_cores;
+		}
+		else
+		{
+			core_speed = malloc(cores * sizeof(int));
+			core_socket = calloc(cores, sizeof(int));
+			for (c = 0; c < cores; c++)
+				core_speed[c] = 100;
+		}
+
+		if (cores == 0)
+		{
+			fprintf(stderr, "Required option -c <cores> is not present.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (montecarlo_runs > 0)
+		{
+			int threads = cluster_threads > 0 ? cluster_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+			if (optind != argc)
+			{
+				fprintf(stderr, "Option --monte-carlo draws its own traces and does not take an input file.\n");
+				print_usage(argv[0]);
+				return 1;
+			}
+			if (montecarlo_schemes == 0 && scheme != -1)
+			{
+				montecarlo_results[0].scheme = scheme;
+				montecarlo_results[0].quantum = quantum;
+				montecarlo_schemes = 1;
+			}
+			if (montecarlo_schemes == 0)
+			{
+				fprintf(stderr, "Option --monte-carlo requires -s <scheme> or --schemes <s,..>.\n");
+				print_usage(argv[0]);
+				return 1;
+			}
+
+			return run_montecarlo(&workload, montecarlo_runs, montecarlo_results, montecarlo_schemes, cores, core_speed, core_socket,
+					topology_cores > 0, switch_cost_fixed, switch_cost_migration, affinity_window, threads > 0 ? threads : 1, seed);
+		}
+
+		if (scheme == -1)
+		{
+			fprintf(stderr, "Required option -s <scheme> is not present.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (optind == argc - 1)
+			file_name = argv[optind];
+		else if (stream && optind == argc)
+			file_name = NULL;
+		else
+		{
+			fprintf(stderr, "A single input file is required.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (stream && (runtime_unit > 0 || fork_branches > 0 || checkpoint_file != NULL))
+		{
+			fprintf(stderr, "Option --stream cannot be combined with --runtime, --fork or --checkpoint.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+
+		/*
+		 * Open the file, read the file, and populate the jobs data structure.  A stream is read as the simulation runs instead.
+		 */
+		FILE *file = (file_name != NULL) ? fopen(file_name, "r") : stdin;
+		if (file == NULL)
+		{
+			fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+			return 2;
+		}
+
+
+		int job_id = 0;
+		int jobs_ct = 10;
+		simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
+
+		char line[1024 + 1];
+		trace_columns_t columns;
+		if (!stream && fgets(line, 1024, file) != NULL)
+			parse_columns(line, &columns);
+		gang = !stream && columns.cores != -1;
+		bursts = !stream && columns.bursts != -1;
+		groups = !stream && columns.group != -1;
+
+		while (!stream && fgets(line, 1024, file) != NULL)
+		{
+			char *fields[16];
+			int field_count = 0;
+
+			for (char *field = strtok(line, ","); field != NULL && field_count < 16; field = strtok(NULL, ","))
+				fields[field_count++] = field;
+
+			if (columns.arrival_time < field_count && columns.run_time < field_count && columns.priority < field_count)
+			{
+				if (job_id == jobs_ct)
+				{
+					jobs_ct *= 2;
+					jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
+
+					if (!jobs)
+					{
+						fprintf(stderr, "Out of memory.\n");
+						return 2;
+					}
+				}
+
+				jobs[job_id].job_id = job_id;
+				jobs[job_id].arrival_time = atoi(fields[columns.arrival_time]);
+				jobs[job_id].run_time = atoi(fields[columns.run_time]);
+				jobs[job_id].priority = atoi(fields[columns.priority]);
+				jobs[job_id].cores_needed = (gang && columns.cores < field_count) ? atoi(fields[columns.cores]) : 1;
+				jobs[job_id].group = (groups && columns.group < field_count) ? atoi(fields[columns.group]) : 0;
+				jobs[job_id].core_id = -1;
+				jobs[job_id].arrived = 0;
+				jobs[job_id].last_core = -1;
+				jobs[job_id].switch_time = 0;
+				jobs[job_id].work = jobs[job_id].run_time * 100;
+				jobs[job_id].bursts = NULL;
+				jobs[job_id].burst_count = 1;
+				jobs[job_id].burst = 0;
+				jobs[job_id].blocked = 0;
+				jobs[job_id].io_device = -1;
+
+				if (bursts && columns.bursts < field_count)
+				{
+					jobs[job_id].burst_count = parse_bursts(fields[columns.bursts], &jobs[job_id].bursts);
+					if (jobs[job_id].burst_count == -1)
+					{
+						fprintf(stderr, "Job %d has malformed bursts; expected CPU and I/O burst lengths in turn, e.g. 3;2;4.\n", job_id);
+						return 2;
+					}
+					jobs[job_id].run_time = jobs[job_id].bursts[0];
+					jobs[job_id].work = jobs[job_id].run_time * 100;
+				}
+
+				if (jobs[job_id].cores_needed < 1 || jobs[job_id].cores_needed > cores)
+				{
+					fprintf(stderr, "Job %d needs %d core(s), but there are %d.\n", job_id, jobs[job_id].cores_needed, cores);
+					return 2;
+				}
+
+				if (jobs[job_id].group < 0)
+				{
+					fprintf(stderr, "Job %d is in group %d; groups are numbered from 0.\n", job_id, jobs[job_id].group);
+					return 2;
+				}
+
+				job_id++;
+			}
+			else
+			{
+				fprintf(stderr, "Illegal file format.\n");
+				return 2;
+			}
+		}
+
+		// Gang jobs are never preempted, and their placement is not snapshotted
+		if (gang && (scheme == PSJF || scheme == PPRI || SCHEME_TIME_SLICED(scheme)))
+		{
+			fprintf(stderr, "A trace with a Cores column can only be scheduled with fcfs, sjf or pri.\n");
+			return 1;
+		}
+		if (gang && (runtime_unit > 0 || fork_branches > 0 || checkpoint_file != NULL || affinity_window >= 0))
+		{
+			fprintf(stderr, "A trace with a Cores column cannot be combined with --runtime, --fork, --checkpoint or --affinity.\n");
+			return 1;
+		}
+
+		// Bursts are not snapshotted, and the runtime has no I/O devices to block on
+		if (bursts && (gang || runtime_unit > 0 || fork_branches > 0 || checkpoint_file != NULL))
+		{
+			fprintf(stderr, "A trace with a Bursts column cannot have a Cores column or be combined with --runtime, --fork or --checkpoint.\n");
+			return 1;
+		}
+
+		// A lottery draw spans every queued job, gang jobs bypass the group queues and snapshots do not keep the groups
+		if (groups && (gang || scheme == LOTTERY || runtime_unit > 0 || checkpoint_file != NULL))
+		{
+			fprintf(stderr, "A trace with a Group column cannot have a Cores column, be scheduled with lottery or be combined with --runtime or --checkpoint.\n");
+			return 1;
+		}
+		// Nodes take their jobs one at a time, as the dispatcher places them
+		if (cluster_nodes > 0 && (gang || bursts || groups))
+		{
+			fprintf(stderr, "Option --cluster cannot take a trace with a Cores, Bursts or Group column.\n");
+			return 1;
+		}
+		if (!groups && group_weight_count > 0)
+		{
+			fprintf(stderr, "Option --group-weights requires a trace with a Group column.\n");
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (cluster_nodes > 0)
+		{
+			fclose(file);
+			printf("Loaded %d node(s) of %d core(s) and %d job(s) using ", cluster_nodes, cores, job_id);
+		}
+		else if (!stream)
+		{
+			fclose(file);
+			printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
+		}
+		else
+			printf("Streaming jobs to %d core(s) using ", cores);
+		print_scheme(scheme, quantum);
+		printf(" scheduling");
+		if (cluster_nodes > 0)
+			printf(", dispatched by %s", dispatch_names[dispatch]);
+		printf("...\n");
+		if (topology_cores > 0)
+			print_topology(cores, core_speed, core_socket);
+		printf("\n");
+
+		scheduler_start_up(cores, scheme);
+		scheduler_set_affinity(affinity_window);
+		scheduler_set_seed(seed);
+		if (topology_cores > 0)
+			scheduler_set_topology(core_speed, core_socket);
+		for (c = 0; groups && c < job_id; c++)
+			scheduler_set_group_weight(jobs[c].group, jobs[c].group < group_weight_count ? group_weights[jobs[c].group] : 1);
+
+
+		if (runtime_unit > 0)
+		{
+			free(core_speed);
+			free(core_socket);
+			return run_runtime(jobs, job_id, cores, quantum, runtime_unit);
+		}
+
+		simulation_init(&sim, cores, scheme, quantum, jobs, job_id, core_speed, core_socket);
+		sim.switch_cost_fixed = switch_cost_fixed > 0 ? switch_cost_fixed : 0;
+		sim.switch_cost_migration = switch_cost_migration > 0 ? switch_cost_migration : 0;
+		sim.affinity_window = affinity_window;
+		sim.gang = gang;
+		simulation_set_io_devices(&sim, io_devices);
+		scheduler_set_backfill(backfill);
+		free(core_speed);
+		free(core_socket);
+
+		if (stream)
+			stream_file = file;
+	}
+
+	sim.event_driven = event_driven;
+
+	if (events_file != NULL && (sim.events = events = eventlog_open(events_file, events_format)) == NULL)
+	{
+		fprintf(stderr, "Unable to create the event log \"%s\".\n", events_file);
+		return 2;
+	}
+
+	if (tune >= 0)
+	{
+		int best = tune_quantum(&sim, tune, tune_max);
+
+		scheduler_clean_up();
+		simulation_destroy(&sim);
+		return best > 0 ? 0 : 3;
+	}
+
+	if (cluster_nodes > 0)
+	{
+		int threads = cluster_threads > 0 ? cluster_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+		int result = cluster_run(&sim, cluster_nodes, dispatch, threads > 0 ? threads : 1, seed);
+
+		scheduler_clean_up();
+		simulation_destroy(&sim);
+		return result;
+	}
+
+	if (stream_file != NULL)
+		return close_events(events, run_stream(&sim, stream_file, stream_window, stream_window_time, stream_report_every));
+
+
+	/*
+	 * Run the simulation.
+	 */
+	int status = sim.active_jobs > 0 ? SIMULATION_RUNNING : SIMULATION_FINISHED;
+	int resumed_at = sim.time;
+
+	while (status == SIMULATION_RUNNING)
+	{
+		if (checkpoint_file != NULL && (sim.time == checkpoint_at ||
+				(checkpoint_every > 0 && sim.time > resumed_at && sim.time % checkpoint_every == 0)))
+		{
+			if (simulation_save(&sim, checkpoint_file) != 0)
+				fprintf(stderr, "Unable to write the checkpoint \"%s\" at time %d.\n", checkpoint_file, sim.time);
+		}
+
+		if (fork_branches > 0 && sim.time == fork_at)
+		{
+			int result = run_fork(&sim, fork_branches, fork_schemes, fork_quanta);
+
+			scheduler_clean_up();
+			simulation_destroy(&sim);
+			return close_events(events, result);
+		}
+
+		// Stepping from event to event must still stop at the next checkpoint and at the fork
+		sim.horizon = -1;
+		if (checkpoint_file != NULL && checkpoint_at > sim.time)
+			sim.horizon = checkpoint_at;
+		if (checkpoint_file != NULL && checkpoint_every > 0)
+		{
+			int next = (sim.time / checkpoint_every + 1) * checkpoint_every;
+			if (sim.horizon < 0 || next < sim.horizon)
+				sim.horizon = next;
+		}
+		if (fork_branches > 0 && fork_at > sim.time && (sim.horizon < 0 || fork_at < sim.horizon))
+			sim.horizon = fork_at;
+
+		status = simulation_step(&sim);
+	}
+	sim.horizon = -1;
+
+	if (status == SIMULATION_FAILED)
+		return close_events(events, 3);
+
+	if (fork_branches > 0)
+		printf("The simulation finished at time %d, before it could fork at time %d.\n\n", sim.time, fork_at);
+
+
+	printf("FINAL TIMING DIAGRAM:\n");
+	for (c = 0; c < sim.cores; c++)
+		printf("  Core %2d: %s\n", c, sim.core_timing_diagram[c]);
+
+	printf("\n");
+	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
+	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
+	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+
+	if (sim.switch_cost_fixed > 0 || sim.switch_cost_migration > 0)
+		printf("Context Switch Overhead: %d time unit(s) over %d switch(es) and %d migration(s)\n",
+				sim.switch_overhead, sim.switches_charged, sim.migrations_charged);
+
+	if (sim.gang || bursts)
+	{
+		scheduler_stats_t total;
+		scheduler_stats(sim.time, &total);
+		int capacity = total.busy_time + total.idle_time;
+		printf("Core Utilization: %.2f%%\n", capacity ? 100.0 * total.busy_time / capacity : 0.0);
+	}
+
+	if (bursts)
+	{
+		scheduler_stats_t total;
+		scheduler_stats(sim.time, &total);
+		printf("I/O Device Utilization: %.2f%% over %d device(s)\n",
+				sim.time ? 100.0 * sim.io_busy_time / (sim.time * sim.io_devices) : 0.0, sim.io_devices);
+		printf("Average I/O Queue Time: %.2f\n", sim.io_bursts ? (float)sim.io_wait_time / sim.io_bursts : 0.0);
+		printf("Throughput: %.2f job(s) per 100 time units\n", sim.time ? 100.0 * total.jobs_finished / sim.time : 0.0);
+	}
+
+	if (sim.gang)
+	{
+		scheduler_stats_t total;
+		scheduler_stats(sim.time, &total);
+		int capacity = total.busy_time + total.idle_time;
+		printf("Fragmentation: %.2f%% (%d core-time unit(s) idle while jobs waited)\n",
+				capacity ? 100.0 * total.fragmented_time / capacity : 0.0, total.fragmented_time);
+		printf("Backfilled Jobs: %d\n", total.backfilled);
+	}
+
+	if (sim.shares != NULL)
+		print_shares(&sim);
+
+	if (scheduler_group_count() > 0)
+		print_groups();
+
+	if (sim.affinity_window >= 0)
+	{
+		scheduler_stats_t total;
+		scheduler_stats(sim.time, &total);
+		printf("Job Migrations: %d\n", total.migrations);
+	}
+
+	if (show_stats)
+		print_scheduler_stats(sim.cores, sim.time);
+
+	scheduler_clean_up();
+	simulation_destroy(&sim);
+
+	return close_events(events, 0);
+}
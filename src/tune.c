@@ -0,0 +1,367 @@
+/** @file tune.c
+
+  Searches the quantum of a time-sliced scheme for the one that minimizes an
+  objective over a trace. Every candidate quantum is a fork of the simulation
+  at time 0, and the candidates run side by side, one thread each, in rounds
+  of a doubling number of time units. Every objective only grows as a run
+  goes on, so after each round a candidate whose objective so far is already
+  worse than that of a finished candidate is cut.
+
+  The quanta are searched coarse to fine: first a geometric grid up to the
+  largest quantum worth trying, a quarter of it ahead of the rest so that
+  there is a finished run to cut against, then, repeatedly, quanta spread between the
+  best one so far and its nearest evaluated neighbours, until every quantum
+  between them has been tried.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "tune.h"
+
+#define TUNE_FIRST_ROUND 32
+#define TUNE_REFINE_WIDTH 16
+
+
+typedef struct _tune_candidate_t
+{
+	simulation_t sim;          // first, so that the finish callback can find its candidate
+	pthread_t thread;
+	scheduler_t *scheduler;
+	int quantum, status, round_end;
+	int cut_at;                // time the candidate was cut at, -1 if it ran to completion
+	float *waits;              // waiting time of each finished job
+	int finished;
+	double objective;          // the objective once finished, a lower bound on it before
+	double response, p99_waiting, turnaround;
+	int switches;
+} tune_candidate_t;
+
+static const char *objective_names[] = { "mean response time", "p99 waiting time", "context switches" };
+
+static int *tune_run_time;  // run time of each job of the trace by job id, 0 for jobs with bursts
+static int tune_job_count;
+
+
+static void tune_job_finished(const simulation_t *sim, int job_id, int time)
+{
+	tune_candidate_t *candidate = (tune_candidate_t *)sim;
+	scheduler_job_stats_t stats;
+
+	scheduler_last_finished(&stats);
+	candidate->waits[candidate->finished++] = stats.waiting_time;
+}
+
+
+static void *run_candidate(void *arg)
+{
+	tune_candidate_t *candidate = arg;
+
+	scheduler_attach(candidate->scheduler);
+	while (candidate->status == SIMULATION_RUNNING && candidate->sim.time < candidate->round_end)
+	{
+		candidate->sim.horizon = candidate->round_end;
+		candidate->status = simulation_step(&candidate->sim);
+	}
+
+	return NULL;
+}
+
+
+static int compare_floats(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+
+/**
+  Works out every objective of a candidate as of the time it has reached:
+  exactly once it has finished, and otherwise as a lower bound, counting what
+  the unfinished jobs are already certain to add. A job that has not run yet
+  will have a response time of at least the time it has waited so far, and a
+  job still alive will have waited at least as long as it has been in the
+  system beyond its run time. Must be called with the candidate's scheduler
+  attached.
+*/
+static void evaluate(tune_candidate_t *candidate, tune_objective_t objective)
+{
+	simulation_t *sim = &candidate->sim;
+	float *waits = malloc((tune_job_count + 1) * sizeof(float));
+	scheduler_stats_t totals;
+	double response;
+	int i, count = candidate->finished;
+
+	scheduler_stats(sim->time, &totals);
+	response = totals.total_response;
+	for (i = 0; i < candidate->finished; i++)
+		waits[i] = candidate->waits[i];
+
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		simulator_job_list_t *job = &sim->jobs[i];
+		float waited = 0;
+
+		if (job->arrived && job->last_core == -1)
+			response += sim->time - job->arrival_time;
+		if (job->arrived && tune_run_time[job->job_id] > 0)
+			waited = sim->time - job->arrival_time - tune_run_time[job->job_id];
+		waits[count++] = waited > 0 ? waited : 0;
+	}
+	while (count < tune_job_count)
+		waits[count++] = 0;
+
+	qsort(waits, count, sizeof(float), compare_floats);
+	candidate->response = tune_job_count ? response / tune_job_count : 0;
+	candidate->p99_waiting = count ? waits[(99 * count + 99) / 100 - 1] : 0;
+	candidate->turnaround = totals.jobs_finished ? totals.total_turnaround / totals.jobs_finished : 0;
+	candidate->switches = totals.context_switches;
+
+	if (objective == TUNE_RESPONSE)
+		candidate->objective = candidate->response;
+	else if (objective == TUNE_P99_WAITING)
+		candidate->objective = candidate->p99_waiting;
+	else
+		candidate->objective = candidate->switches;
+
+	free(waits);
+}
+
+
+/**
+  Whether candidate a is better than candidate b: a lower objective, or the
+  smaller quantum among equals.
+*/
+static int better(const tune_candidate_t *a, const tune_candidate_t *b)
+{
+	return a->objective < b->objective || (a->objective == b->objective && a->quantum < b->quantum);
+}
+
+
+static void release(tune_candidate_t *candidate)
+{
+	scheduler_attach(candidate->scheduler);
+	scheduler_clean_up();
+	simulation_destroy(&candidate->sim);
+	free(candidate->waits);
+}
+
+
+
+/**
+  Runs candidates[first .. count) from sim until each one has finished or
+  been cut, measured against candidates[best], the best candidate finished
+  so far (-1 for none).
+
+  @return the index of the best candidate once these have run
+  @return -2 if a run failed
+*/
+static int search(const simulation_t *sim, tune_candidate_t *candidates, int first, int count,
+		tune_objective_t objective, int best)
+{
+	scheduler_t *base = scheduler_current();
+	int i, running = count - first, failed = 0;
+
+	for (i = first; i < count; i++)
+	{
+		tune_candidate_t *candidate = &candidates[i];
+
+		candidate->scheduler = simulation_fork(&candidate->sim, sim, sim->scheme, candidate->quantum);
+		candidate->sim.quiet = 1;
+		candidate->sim.record_diagram = 0;
+		candidate->sim.event_driven = 1;
+		candidate->sim.events = NULL;
+		candidate->sim.finished = tune_job_finished;
+		candidate->status = SIMULATION_RUNNING;
+		candidate->cut_at = -1;
+		candidate->finished = 0;
+		candidate->waits = malloc((tune_job_count + 1) * sizeof(float));
+	}
+
+	for (int round_end = TUNE_FIRST_ROUND; running > 0 && !failed; round_end = (round_end < INT_MAX / 2) ? round_end * 2 : INT_MAX)
+	{
+		for (i = first; i < count; i++)
+		{
+			tune_candidate_t *candidate = &candidates[i];
+			if (candidate->status != SIMULATION_RUNNING || candidate->cut_at != -1)
+				continue;
+
+			candidate->round_end = round_end;
+			if (pthread_create(&candidate->thread, NULL, run_candidate, candidate) != 0)
+			{
+				run_candidate(candidate);
+				candidate->thread = pthread_self();
+			}
+		}
+
+		for (i = first; i < count; i++)
+		{
+			tune_candidate_t *candidate = &candidates[i];
+			if (candidate->cut_at != -1 || candidate->round_end != round_end)
+				continue;
+
+			if (!pthread_equal(candidate->thread, pthread_self()))
+				pthread_join(candidate->thread, NULL);
+			candidate->round_end = 0;
+			if (candidate->status == SIMULATION_FAILED)
+			{
+				printf("The scheduler made an invalid decision at time %d with quantum %d.\n",
+						candidate->sim.time, candidate->quantum);
+				failed = 1;
+				running--;
+				continue;
+			}
+
+			scheduler_attach(candidate->scheduler);
+			evaluate(candidate, objective);
+			if (candidate->status == SIMULATION_FINISHED)
+			{
+				running--;
+				if (best == -1 || better(candidate, &candidates[best]))
+					best = i;
+			}
+		}
+
+		for (i = first; i < count && best != -1; i++)
+		{
+			tune_candidate_t *candidate = &candidates[i];
+			if (candidate->status == SIMULATION_RUNNING && candidate->cut_at == -1 && better(&candidates[best], candidate))
+			{
+				candidate->cut_at = candidate->sim.time;
+				running--;
+			}
+		}
+	}
+
+	for (i = first; i < count; i++)
+		release(&candidates[i]);
+	scheduler_attach(base);
+
+	return failed ? -2 : best;
+}
+
+
+static int compare_quanta(const void *a, const void *b)
+{
+	return ((const tune_candidate_t *)a)->quantum - ((const tune_candidate_t *)b)->quantum;
+}
+
+
+static int add_candidate(tune_candidate_t **candidates, int *capacity, int count, int quantum)
+{
+	if (count == *capacity)
+	{
+		*capacity = *capacity * 2 + 16;
+		*candidates = realloc(*candidates, *capacity * sizeof(tune_candidate_t));
+	}
+	(*candidates)[count].quantum = quantum;
+	return count + 1;
+}
+
+
+/**
+  Finds the quantum of sim's time-sliced scheme that minimizes objective, and
+  prints every quantum tried with its mean response time, p99 waiting time,
+  mean turnaround time and context switches: the trade-off curve.
+
+  @param sim a simulation at time 0, with the current scheduler.
+  @param objective what to minimize.
+  @param max_quantum the largest quantum to try, or 0 for the longest run
+  time (or CPU burst) in the trace, beyond which every quantum behaves the same.
+  @return the best quantum
+  @return -1 if a run failed
+ */
+int tune_quantum(const simulation_t *sim, tune_objective_t objective, int max_quantum)
+{
+	tune_candidate_t *candidates = NULL;
+	int capacity = 0, count = 0, first = 0, best = -1;
+	int i, q, lo, hi, longest = 1;
+
+	tune_job_count = sim->active_jobs;
+	tune_run_time = calloc(sim->next_job_id + 1, sizeof(int));
+	for (i = 0; i < sim->active_jobs; i++)
+	{
+		const simulator_job_list_t *job = &sim->jobs[i];
+
+		if (job->bursts == NULL)
+			tune_run_time[job->job_id] = job->run_time;
+		if (job->run_time > longest)
+			longest = job->run_time;
+		for (int b = 0; job->bursts != NULL && b < job->burst_count; b += 2)
+			if (job->bursts[b] > longest)
+				longest = job->bursts[b];
+	}
+	if (max_quantum <= 0)
+		max_quantum = longest;
+
+	printf("Tuning the quantum for %s over quanta 1 to %d...\n\n", objective_names[objective], max_quantum);
+
+	// A coarse grid first: every quantum up to 8, then steps of a quarter
+	int *grid = malloc((max_quantum + 1) * sizeof(int)), grid_size = 0;
+	for (q = 1; q <= max_quantum; q = (q < 8) ? q + 1 : q + q / 4)
+		grid[grid_size++] = q;
+	if (grid[grid_size - 1] != max_quantum)
+		grid[grid_size++] = max_quantum;
+
+	// Every fourth quantum of the grid scouts ahead, so that the rest have a finished run to be cut against
+	for (i = 0; i < grid_size; i++)
+		if (i % 4 == 0 || i == grid_size - 1)
+			count = add_candidate(&candidates, &capacity, count, grid[i]);
+	best = search(sim, candidates, 0, count, objective, -1);
+	first = count;
+	for (i = 0; i < grid_size; i++)
+		if (i % 4 != 0 && i != grid_size - 1)
+			count = add_candidate(&candidates, &capacity, count, grid[i]);
+	free(grid);
+
+	while (best >= 0 && count > first && (best = search(sim, candidates, first, count, objective, best)) >= 0)
+	{
+		// Then quanta spread evenly between the best one and its nearest neighbours tried so far
+		lo = hi = candidates[best].quantum;
+		for (i = 0; i < count; i++)
+		{
+			q = candidates[i].quantum;
+			if (q < candidates[best].quantum && (lo == candidates[best].quantum || q > lo))
+				lo = q;
+			if (q > candidates[best].quantum && (hi == candidates[best].quantum || q < hi))
+				hi = q;
+		}
+
+		int step = (hi - lo - 2) / TUNE_REFINE_WIDTH + 1;
+		first = count;
+		for (q = lo + step; q < hi; q += step)
+			if (q != candidates[best].quantum)
+				count = add_candidate(&candidates, &capacity, count, q);
+	}
+
+	if (best < 0)
+	{
+		free(candidates);
+		free(tune_run_time);
+		return -1;
+	}
+
+	int best_quantum = candidates[best].quantum;
+	double best_objective = candidates[best].objective;
+	qsort(candidates, count, sizeof(tune_candidate_t), compare_quanta);
+
+	printf("Quantum  Mean Response  P99 Waiting  Mean Turnaround  Switches\n");
+	for (i = 0; i < count; i++)
+	{
+		tune_candidate_t *candidate = &candidates[i];
+		if (candidate->cut_at != -1)
+			printf("%7d  cut at time %d, %s already at least %.2f\n", candidate->quantum, candidate->cut_at,
+					objective_names[objective], candidate->objective);
+		else
+			printf("%7d  %13.2f  %11.2f  %15.2f  %8d\n", candidate->quantum, candidate->response,
+					candidate->p99_waiting, candidate->turnaround, candidate->switches);
+	}
+
+	printf("\nBest quantum: %d (%s %.2f)\n", best_quantum, objective_names[objective], best_objective);
+
+	free(candidates);
+	free(tune_run_time);
+	return best_quantum;
+}
@@ -0,0 +1,16 @@
+/** @file tune.h
+ */
+
+#ifndef TUNE_H_
+#define TUNE_H_
+
+#include "simulation.h"
+
+/**
+  What the quantum tuner minimizes
+*/
+typedef enum {TUNE_RESPONSE = 0, TUNE_P99_WAITING, TUNE_SWITCHES} tune_objective_t;
+
+int tune_quantum(const simulation_t *sim, tune_objective_t objective, int max_quantum);
+
+#endif /* TUNE_H_ */
@@ -0,0 +1,168 @@
+/** @file victimbench.c
+
+  Measures how long picking the job to preempt takes as cores are added:
+  once with the scalar loop over a job pointer per core the scheduler used to
+  run, and once with the victim kernels over packed per-core keys under each
+  instruction set the processor supports. Every core is busy, as it is
+  whenever the scheduler looks for a victim, and every method must pick the
+  same core.
+
+  Usage: victimbench [selections per core count]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libscheduler/libvictim.h"
+
+#define MAX_CORES 1024
+#define TIME 1000
+
+/* The fields of a running job the victim is chosen by. */
+typedef struct _bench_job_t
+{
+	int needed_time, used_time, arrival_time, priority;
+} bench_job_t;
+
+bench_job_t jobs[MAX_CORES];
+bench_job_t *core_array[MAX_CORES];
+int busy_since[MAX_CORES], core_speed[MAX_CORES];
+int run_remaining[MAX_CORES], run_carry[MAX_CORES], run_priority[MAX_CORES], run_arrival[MAX_CORES], run_group[MAX_CORES], keys[MAX_CORES];
+
+int core_remaining(int core, int time)
+{
+	return core_array[core]->needed_time - core_array[core]->used_time - (time - busy_since[core]) * core_speed[core] / 100;
+}
+
+/* The PSJF loop as it was: the longest remaining time, through the job pointers. */
+int psjf_pointers(int cores, int time)
+{
+	int core = 0, longest = core_remaining(0, time);
+
+	for (int i = 0; i < cores; i++)
+	{
+		int remaining = core_remaining(i, time);
+		if (remaining > longest)
+		{
+			core = i;
+			longest = remaining;
+		}
+		else if (remaining == longest && core_array[i]->arrival_time > longest)
+			core = i;
+	}
+	return core;
+}
+
+/* The PPRI loop as it was: the lowest priority, through the job pointers. */
+int ppri_pointers(int cores, int time)
+{
+	int core = 0;
+
+	for (int i = 0; i < cores; i++)
+	{
+		if (core_array[i]->priority > core_array[core]->priority)
+			core = i;
+		else if (core_array[i]->priority == core_array[core]->priority && core_array[i]->arrival_time > core_remaining(core, time))
+			core = i;
+	}
+	return core;
+}
+
+int ties[MAX_CORES];
+
+int psjf_packed(int cores, int time)
+{
+	int longest = victim_remaining(keys, run_remaining, run_carry, busy_since, core_speed, run_group, -1, time, cores);
+	int core = victim_find_last_above(keys, longest, run_arrival, cores);
+	return core != -1 ? core : victim_find(keys, longest, 0, cores);
+}
+
+int ppri_packed(int cores, int time)
+{
+	int lowest = victim_keys(keys, run_priority, run_group, -1, cores);
+	int tie_count = victim_find_all(keys, lowest, ties, cores);
+	int core = ties[0], threshold = core_remaining(core, time);
+
+	for (int i = 1; i < tie_count; i++)
+		if (run_arrival[ties[i]] > threshold)
+		{
+			core = ties[i];
+			threshold = core_remaining(core, time);
+		}
+	return core;
+}
+
+double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Returns nanoseconds per selection, and the core picked through chosen. */
+double measure(int (*select)(int, int), int cores, int selections, int *chosen)
+{
+	volatile int sink = 0;
+	double start = seconds();
+
+	for (int i = 0; i < selections; i++)
+		sink += select(cores, TIME + (i & 1));
+	*chosen = select(cores, TIME);
+
+	return (seconds() - start) * 1e9 / selections;
+}
+
+int main(int argc, char **argv)
+{
+	int selections = argc > 1 ? atoi(argv[1]) : 200000;
+	victim_isa_t best = victim_best_isa();
+	int mismatches = 0;
+
+	// Jobs scattered through memory, as the scheduler's are, with few distinct keys so that ties are common
+	srand(678);
+	for (int i = 0; i < MAX_CORES; i++)
+	{
+		int j = (i * 389) % MAX_CORES;
+		core_array[i] = &jobs[j];
+		busy_since[i] = TIME - rand() % 100;
+		core_speed[i] = 100;
+		jobs[j].needed_time = 400 + rand() % 200;
+		jobs[j].used_time = rand() % 300;
+		jobs[j].arrival_time = rand() % 700;
+		jobs[j].priority = rand() % 8;
+
+		run_remaining[i] = jobs[j].needed_time - jobs[j].used_time;
+		run_priority[i] = jobs[j].priority;
+		run_arrival[i] = jobs[j].arrival_time;
+		run_group[i] = 0;
+	}
+
+	for (int scheme = 0; scheme < 2; scheme++)
+	{
+		printf("%sCores   %s pointers", scheme ? "\n" : "", scheme ? "PPRI" : "PSJF");
+		for (victim_isa_t isa = VICTIM_SCALAR; isa <= best; isa++)
+			printf("   packed %-6s", victim_isa_name(isa));
+		printf("   (ns per selection)\n");
+
+		for (int cores = 64; cores <= MAX_CORES; cores *= 2)
+		{
+			int expected, chosen;
+
+			printf("%5d   %13.1f", cores, measure(scheme ? ppri_pointers : psjf_pointers, cores, selections, &expected));
+			for (victim_isa_t isa = VICTIM_SCALAR; isa <= best; isa++)
+			{
+				victim_use(isa);
+				printf("   %13.1f", measure(scheme ? ppri_packed : psjf_packed, cores, selections, &chosen));
+				if (chosen != expected)
+					mismatches++;
+			}
+			printf("\n");
+		}
+	}
+
+	if (mismatches)
+		printf("\n%d selection(s) picked a different core than the pointer loop.\n", mismatches);
+
+	return mismatches ? 1 : 0;
+}
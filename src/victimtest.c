@@ -0,0 +1,82 @@
+/** @file victimtest.c
+
+  Checks that every instruction set the processor supports gives the victim
+  kernels the same results as the scalar ones, on random cores with many
+  ties, idle cores and groups, for every core count up to MAX_CORES.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libscheduler/libvictim.h"
+
+#define MAX_CORES 70
+#define ROUNDS 200
+
+int remaining[MAX_CORES], carry[MAX_CORES], since[MAX_CORES], speed[MAX_CORES], priority[MAX_CORES], arrival[MAX_CORES], group[MAX_CORES];
+
+/* Runs every kernel under isa on the first n cores, into results. */
+void run(victim_isa_t isa, int n, int only_group, int time, int *results)
+{
+	int keys[MAX_CORES], ties[MAX_CORES];
+
+	victim_use(isa);
+
+	results[0] = victim_remaining(keys, remaining, carry, since, speed, group, only_group, time, n);
+	results[1] = victim_find_last_above(keys, results[0], arrival, n);
+	results[2] = victim_find(keys, results[0], 0, n);
+	results[3] = victim_find(keys, results[0], n / 2, n);
+	results[4] = victim_keys(keys, priority, group, only_group, n);
+	results[5] = victim_find(keys, results[4], 0, n);
+	results[6] = victim_find(keys, results[4], results[5] + 1, n);
+	results[7] = victim_find_last_above(keys, results[4], arrival, n);
+	results[8] = victim_find_all(keys, results[4], ties, n);
+	results[9] = 0;
+	for (int i = 0; i < results[8]; i++)
+		results[9] = results[9] * 31 + ties[i];
+}
+
+int main()
+{
+	victim_isa_t best = victim_best_isa();
+	int checks = 0, mismatches = 0;
+
+	srand(678);
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (int i = 0; i < MAX_CORES; i++)
+		{
+			since[i] = rand() % 56;  // a few still switching, past time 50
+			speed[i] = (rand() % 4 == 0) ? 50 + rand() % 150 : 100;
+			carry[i] = speed[i] == 100 ? 0 : rand() % 100;
+			remaining[i] = rand() % 8 + (carry[i] + (since[i] < 50 ? 50 - since[i] : 0) * speed[i]) / 100;
+			priority[i] = rand() % 4;
+			arrival[i] = rand() % 12;
+			group[i] = (rand() % 5 == 0) ? -1 : rand() % 3;
+		}
+
+		for (int n = 0; n <= MAX_CORES; n++)
+		{
+			int only_group = rand() % 4 - 1;
+			int expected[10], actual[10];
+
+			run(VICTIM_SCALAR, n, only_group, 50, expected);
+			for (victim_isa_t isa = VICTIM_SSE4; isa <= best; isa++)
+			{
+				run(isa, n, only_group, 50, actual);
+				for (int k = 0; k < 10; k++)
+				{
+					checks++;
+					if (actual[k] != expected[k])
+					{
+						if (mismatches++ < 10)
+							printf("%s result %d on %d cores is %d, expected %d\n", victim_isa_name(isa), k, n, actual[k], expected[k]);
+					}
+				}
+			}
+		}
+	}
+
+	printf("Victim kernels up to %s: %d check(s), %d mismatch(es)\n", victim_isa_name(best), checks, mismatches);
+	return mismatches ? 1 : 0;
+}